@@ -0,0 +1,99 @@
+// cppcheck-suppress-file unusedStructMember
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Shared static file cache.
+ *
+ * The server scans the public directory and writes the most recently used files into an immutable snapshot: a
+ * sealed memfd holding an entry table sorted by URI hash, the URIs, a pre-rendered header block per file and the file
+ * bodies. Every worker maps the snapshot read-only. When the server builds a new snapshot, it hands the memfd to the
+ * workers over their domain sockets and they swap mappings.
+ *
+ * Workers count hits in a small shared stats region (one slot per known file). The server reads those counters when
+ * it rebuilds the snapshot, so recently used files stay cached and least recently used files are evicted first when
+ * the files don't fit the size limit.
+ */
+
+#define CACHE_MAX_FILES 4096
+#define CACHE_MAX_FILE_SIZE (4 * 1024 * 1024)
+#define CACHE_REFRESH_INTERVAL 5000    // ms
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t last_access_ms;
+} cache_stat_t;
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t stat_slot;
+    uint32_t uri_offset;    // NUL terminated
+    uint32_t uri_len;
+    uint32_t headers_offset;    // Content-Type and Content-Length lines, without the status line or final CRLF
+    uint32_t headers_len;
+    uint64_t body_offset;
+    uint64_t body_len;
+    uint32_t cached;    // 0 when only the stats slot is tracked, the file is served from disk
+    uint32_t reserved;
+} cache_entry_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t nentries;
+    uint64_t size;
+} cache_snapshot_header_t;
+
+// A file known to the server, whether cached or not. Its index is also its stats slot.
+typedef struct
+{
+    char  *uri;    // NULL when the slot is free
+    char  *path;
+    off_t  size;
+    time_t mtime;
+    long   mtime_nsec;
+    bool   present;    // Cleared before every scan, files that are not seen again are dropped
+    bool   cached;
+} cache_file_t;
+
+typedef struct
+{
+    // Shared by the server and every worker
+    cache_stat_t *stats;
+
+    // Snapshot mapped by this process
+    int    fd;
+    void  *base;    // Read-only
+    size_t size;
+
+    // Server only
+    const char   *public_dir;
+    size_t        max_size;
+    uint64_t      signature;    // Identifies the files and versions in the current snapshot
+    cache_file_t *files;        // CACHE_MAX_FILES slots
+    size_t        nfiles;       // Highest slot in use + 1
+} cache_t;
+
+int cache_init(cache_t *cache, const char *public_dir, size_t max_size, int *err);
+int cache_destroy(cache_t *cache, int *err);
+
+// Server
+int cache_refresh(cache_t *cache, bool *changed, int *err);
+
+// Workers
+int                  cache_attach(cache_t *cache, int fd, int *err);
+const cache_entry_t *cache_lookup(const cache_t *cache, const char *uri, size_t len);
+void                 cache_record_hit(const cache_t *cache, const cache_entry_t *entry, uint64_t now_ms);
+const char          *cache_entry_headers(const cache_t *cache, const cache_entry_t *entry);
+const char          *cache_entry_body(const cache_t *cache, const cache_entry_t *entry);
+
+#endif
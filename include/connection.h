@@ -0,0 +1,131 @@
+// cppcheck-suppress-file unusedStructMember
+
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Per-connection state owned by a worker.
+ *
+ * A connection alternates between reading a request and writing its response. While a response is being written,
+ * the connection stops reading so that a slow client can't make the worker buffer an unbounded amount of requests.
+ */
+
+typedef enum
+{
+    CONNECTION_STATE_FREE,
+    CONNECTION_STATE_READING,    // Waiting for request data
+    CONNECTION_STATE_WRITING,    // Flushing a response, reading is paused
+    CONNECTION_STATE_CLOSING     // No more requests will be read, flush what's left and close
+} CONNECTION_STATE;
+
+/*
+ * A piece of pending output, either a heap buffer or a range of a file that is sent without copying it through
+ * user space.
+ */
+typedef struct connection_chunk
+{
+    char  *data;        // NULL for file chunks
+    int    fd;          // -1 for buffer chunks
+    size_t offset;      // Position of the next byte to write, for files this is the file offset
+    size_t len;         // End position
+    size_t capacity;    // Allocated size of `data`
+
+    struct connection_chunk *next;
+} connection_chunk_t;
+
+typedef struct connection
+{
+    int              fd;
+    uint64_t         id;        // Unique for the lifetime of the pool, finds the connection again from replies that outlive it
+    CONNECTION_STATE state;
+    short            events;    // What the fd is currently polled for
+
+    // Received bytes, always NUL terminated. Handled bytes are only dropped before the next read
+    char  *inbuf;
+    size_t inbuf_len;
+    size_t inbuf_size;
+    size_t inbuf_handled;    // Bytes of requests that have already been answered
+    bool   input_more;       // The last read stopped at its budget, the socket may still have data
+
+    // Framing of the first request that hasn't been answered, relative to its start
+    size_t scanned;        // Bytes already searched for the end of the headers
+    size_t headers_len;    // 0 until the headers are complete
+    size_t body_len;       // From Content-Length
+    int    spool_fd;       // File the body is moved to when it is too large to keep in `inbuf`, -1 otherwise
+    size_t spooled;        // Body bytes in the spool file
+
+    // Response chunks that have not been written yet, in order
+    connection_chunk_t *out_head;
+    connection_chunk_t *out_tail;
+    size_t              out_pending;     // Bytes left to write across every chunk
+    size_t              out_buffered;    // Part of `out_pending` held in buffer chunks
+    size_t              out_files;       // File chunks in the queue
+    connection_chunk_t *spare;           // Flushed buffer chunk kept for the next response
+
+    bool     keep_alive;        // Cleared once a response has told the client the connection will close
+    size_t   uncommitted;       // Inserts that haven't been committed yet, nothing is written until they are
+    size_t   held_output;       // Queued bytes ahead of the response held for the inserts
+    bool     commit_failed;     // One of the held inserts wasn't committed, its response must not go out
+    size_t   nrequests;         // Requests answered on this connection
+    uint64_t last_active_ms;    // Monotonic time of the last read or write
+
+    struct connection *next_free;
+
+    // Open connections are kept ordered by last activity, least recent first
+    struct connection *idle_prev;
+    struct connection *idle_next;
+} connection_t;
+
+/*
+ * A complete request. A spooled body is not part of `data`, it is in `body_fd`, which stays owned by the connection.
+ */
+typedef struct
+{
+    char  *data;        // Request line and headers, followed by the body unless it was spooled
+    size_t len;
+    int    body_fd;     // -1 when the body is part of `data`
+    size_t body_len;
+} connection_request_t;
+
+typedef struct
+{
+    connection_t *connections;
+    connection_t *free_list;
+    size_t        max_connections;
+    size_t        nconnections;
+    uint64_t      nopened;    // Connections opened so far, part of every connection id
+
+    connection_t *idle_head;    // Least recently active connection
+    connection_t *idle_tail;    // Most recently active connection
+} connection_pool_t;
+
+int connection_pool_init(connection_pool_t *pool, size_t max_connections, int *err);
+int connection_pool_destroy(connection_pool_t *pool, int *err);
+
+connection_t *connection_open(connection_pool_t *pool, int fd, int *err);
+int           connection_close(connection_pool_t *pool, connection_t *conn, int *err);
+void          connection_touch(connection_pool_t *pool, connection_t *conn);
+connection_t *connection_pool_oldest(const connection_pool_t *pool);
+connection_t *connection_find(connection_pool_t *pool, uint64_t id);
+
+ssize_t connection_read(connection_t *conn, int *err);
+bool    connection_has_input(const connection_t *conn);
+int     connection_next_request(connection_t *conn, connection_request_t *request, size_t max_body_size, int *err);
+void    connection_finish_request(connection_t *conn, const connection_request_t *request);
+void    connection_discard_input(connection_t *conn);
+void    connection_skip_input(connection_t *conn, size_t size);
+int     connection_write(connection_t *conn, const void *data, size_t size, int *err);
+int     connection_writev(connection_t *conn, const struct iovec *iov, size_t iovcnt, int *err);
+int     connection_queue_file(connection_t *conn, int fd, size_t offset, size_t size, int *err);
+void    connection_truncate_output(connection_t *conn, size_t size);
+ssize_t connection_flush(connection_t *conn, int *err);
+bool    connection_has_output(const connection_t *conn);
+bool    connection_output_full(const connection_t *conn);
+
+#endif
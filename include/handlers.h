@@ -1,15 +1,32 @@
 #ifndef HANDLERS_H
 #define HANDLERS_H
 
+#include "cache.h"
+#include "connection.h"
+#include "http/arena.h"
 #include "ndbm/database.h"
+#include "ndbm/snapshot.h"
 #include "state.h"
+#include "store.h"
 #include <poll.h>
 #include <unistd.h>
 
-void    handle_client_connect(int sockfd, app_state_t *app, const char *libhttp_filepath);
-ssize_t handle_client_data(int connfd, DBM *db, const char *public_dir);
+// Everything a worker needs to answer requests
+typedef struct
+{
+    store_client_t        *store;       // Inserts and lookups go to the store process
+    db_cache_t            *db_cache;
+    db_snapshot_t         *snapshot;    // Checked before the cache and the store
+    const cache_t         *cache;
+    arena_t               *arena;    // Reset after every request
+    const worker_config_t *config;
+} handler_context_t;
 
-ssize_t handle_worker_connect(const worker_t *worker, int fd);
+void    handle_client_connect(int sockfd, app_state_t *app);
+ssize_t handle_client_data(connection_t *conn, const handler_context_t *ctx);
+void    handle_commit_failure(connection_t *conn);
+
+ssize_t handle_worker_message(worker_t *worker, app_state_t *app);
 ssize_t handle_worker_disconnect(worker_t *worker, app_state_t *app);
 
 #endif
@@ -0,0 +1,48 @@
+// cppcheck-suppress-file unusedStructMember
+
+#ifndef HTTP_ARENA_H
+#define HTTP_ARENA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Bump allocator for everything built while answering a single request.
+ *
+ * Allocations are never freed one by one, the whole arena is rewound with `arena_reset` once the response has been
+ * queued. Blocks are kept across resets, so once a worker has seen its largest request it stops calling malloc.
+ */
+
+#define ARENA_BLOCK_SIZE 16384
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t              size;    // Usable bytes after the block header
+    size_t              used;
+} arena_block_t;
+
+typedef struct
+{
+    arena_block_t *head;
+    arena_block_t *current;      // Block new allocations are taken from
+    size_t         block_size;
+    void          *last;         // Most recent allocation, the only one that can grow in place
+    size_t         last_size;
+
+    size_t nblocks_allocated;    // Blocks malloc'd over the arena's lifetime, to spot requests that don't fit
+} arena_t;
+
+int  arena_init(arena_t *arena, size_t block_size, int *err);
+void arena_destroy(arena_t *arena);
+void arena_reset(arena_t *arena);
+
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_calloc(arena_t *arena, size_t nmemb, size_t size);
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(arena_t *arena, const char *str);
+char *arena_strndup(arena_t *arena, const char *str, size_t len);
+char *arena_sprintf(arena_t *arena, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif
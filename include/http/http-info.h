@@ -2,8 +2,12 @@
 #ifndef HTTP_INFO_H
 #define HTTP_INFO_H
 
+#include "http/arena.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 typedef enum
 {
@@ -20,6 +24,12 @@ typedef enum
     HTTP_VERSION_11
 } HTTP_VERSION;
 
+typedef enum
+{
+    HTTP_PARSER_FAST,    // Single pass scanner, requests it can't handle go through the combinator tokenizer
+    HTTP_PARSER_STRICT    // Combinator tokenizer only, every request is checked against the full grammar
+} HTTP_PARSER;
+
 typedef enum
 {
     HTTP_STATUS_UNKNOWN = 0,
@@ -88,15 +98,52 @@ typedef enum
     HTTP_STATUS_511     = 511
 } HTTP_STATUS;
 
+#define HTTP_MAX_HEADERS 64
+#define HTTP_RESPONSE_IOVECS 8    // Most pieces `response_write` splits a response into
+
 typedef struct
 {
     char *key;
     char *value;
 } http_header_t;
 
+// A (pointer, length) view into a buffer owned by someone else, not NUL terminated
+typedef struct
+{
+    const char *data;
+    size_t      len;
+} http_slice_t;
+
+typedef struct
+{
+    http_slice_t key;
+    http_slice_t value;    // Without the surrounding whitespace
+} http_header_view_t;
+
+/*
+ * A request that points into the buffer it was parsed from instead of owning copies. It is only valid for as long as
+ * that buffer is.
+ */
+typedef struct
+{
+    // Request Line
+    HTTP_METHOD  method;
+    http_slice_t request_uri;
+    HTTP_VERSION http_version;
+
+    // Headers
+    http_header_view_t headers[HTTP_MAX_HEADERS];
+    size_t             nheaders;
+    bool               keep_alive;
+
+    // Body
+    http_slice_t body;
+} http_request_view_t;
+
 typedef struct
 {
     const char *public_dir;
+    arena_t    *arena;    // Owns every string, header and buffer of the request and its response
 
     // Request Line
     HTTP_METHOD  method;
@@ -106,6 +153,7 @@ typedef struct
     // Headers
     http_header_t *headers;
     size_t         nheaders;
+    bool           keep_alive;    // Whether the client wants the connection to persist after this request
 
     // body
     uint8_t *body;
@@ -114,17 +162,43 @@ typedef struct
 
 typedef struct
 {
+    arena_t *arena;
+
     // Status Line
     HTTP_VERSION http_version;
     HTTP_STATUS  status;
 
-    // Headers
-    http_header_t *headers;
+    // Headers, Content-Length is always written from body_size
+    http_slice_t   content_type;    // Preformatted Content-Type header line, empty when there is none
+    http_header_t *headers;         // Any other headers
     size_t         nheaders;
+    bool           keep_alive;      // Written as the Connection header
 
     // Body
     char  *body;
     size_t body_size;
+    int    body_fd;    // When set, the body is the first body_size bytes of this file and is sent by the caller
 } http_response_t;
 
+/*
+ * Everything the server calls in the HTTP library, exported as a single table so it can be swapped as a whole. Bump
+ * the ABI version whenever this table or any type it passes changes, the server refuses tables built for another one.
+ */
+#define HTTP_LIBRARY_ABI_VERSION 3
+#define HTTP_LIBRARY_SYMBOL "http_library"
+
+typedef struct
+{
+    uint32_t abi_version;
+
+    int (*request_init)(http_request_t *request, const char *public_dir, arena_t *arena, int *err);
+    int (*request_view_parse)(http_request_view_t *view, const char *data, size_t len, HTTP_PARSER parser, int *err);
+    int (*request_from_view)(http_request_t *request, const http_request_view_t *view, int *err);
+    int (*request_process)(http_request_t *request, http_response_t *response, int *err);
+    ssize_t (*response_write)(const http_response_t *response, const http_request_t *request, struct iovec *iov, size_t *iovcnt, int *err);
+    int (*request_destroy)(http_request_t *request, int *err);
+    int (*response_destroy)(http_response_t *response, int *err);
+    const char *(*get_mime_type)(const char *filepath);
+} http_library_t;
+
 #endif
@@ -3,6 +3,7 @@
 #ifndef HTTP_H
 #define HTTP_H
 
+#include "http/arena.h"
 #include "http/http-info.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -27,9 +28,11 @@
  */
 
 // Request
-int request_init(http_request_t *request, const char *public_dir, int *err);
+int request_init(http_request_t *request, const char *public_dir, arena_t *arena, int *err);
 int request_destroy(http_request_t *request, int *err);
 int request_parse(http_request_t *request, const char *data, int *err);
+int request_view_parse(http_request_view_t *view, const char *data, size_t len, HTTP_PARSER parser, int *err);
+int request_from_view(http_request_t *request, const http_request_view_t *view, int *err);
 int request_process(http_request_t *request, http_response_t *response, int *err);
 // int              request_get_request_line(http_request_t *request, int *err);
 
@@ -39,21 +42,18 @@ int handle_head(http_request_t *request, http_response_t *response, int *err);
 int handle_post(http_request_t *request, http_response_t *response, int *err);
 
 // Response
-int     response_init(http_response_t *response, HTTP_STATUS status, int *err);
+int     response_init(http_response_t *response, HTTP_STATUS status, arena_t *arena, int *err);
 int     response_destroy(http_response_t *response, int *err);
-ssize_t response_write(const http_response_t *response, const http_request_t *request, char **buf, int *err);
-
-// Response - Write components
-int response_write_status_line(const http_response_t *response, char **buf, size_t *buf_size, int *err);
-int response_write_headers(const http_response_t *response, char **buf, size_t *buf_size, int *err);
-int response_write_crlf(const http_response_t *response, char **buf, size_t *buf_size, int *err);
-int response_write_body(const http_response_t *response, char **buf, size_t *buf_size, int *err);
+ssize_t response_write(const http_response_t *response, const http_request_t *request, struct iovec *iov, size_t *iovcnt, int *err);
 
 // Headers
-int            add_header(http_header_t **headers, size_t *nheaders, const char *key, const char *value, int *err);
-http_header_t *create_header(const char *key, const char *value, int *err);
+int            add_header(arena_t *arena, http_header_t **headers, size_t *nheaders, const char *key, const char *value, int *err);
+http_header_t *create_header(arena_t *arena, const char *key, const char *value, int *err);
 int            destroy_header(http_header_t *headers, size_t *nheaders, const char *key, int *err);
 int            destroy_headers(http_header_t *headers, size_t *nheaders, int *err);
+const char    *get_header_value(const http_header_t *headers, size_t nheaders, const char *key);
+
+const http_slice_t *request_view_header(const http_request_view_t *view, const char *key);
 
 // Validators
 bool validate_http_method(const char *method);
@@ -63,13 +63,22 @@ bool validate_http_version(const char *version);
 // Utils
 
 HTTP_METHOD  get_http_method_code(const char *method, int *err);
+HTTP_METHOD  get_http_method_code_n(const char *method, size_t len);
 HTTP_VERSION get_http_version_code(const char *version, int *err);
+HTTP_VERSION get_http_version_code_n(const char *version, size_t len);
 const char  *get_http_status_msg(HTTP_STATUS status, int *err);
 const char  *get_http_version_name(HTTP_VERSION version, int *err);
 const char  *get_mime_type(const char *filepath);
 
+// Utils - Slices
+bool slice_equals(http_slice_t slice, const char *str);
+bool slice_equals_nocase(http_slice_t slice, const char *str);
+
 // Utils - IO
 // char   *make_string(const char *fmt, ...) __attribute__((format(printf, 1, 0)));
 ssize_t read_fd(int fd, uint8_t **buf, size_t size, int *err);
 
+// Looked up by name when the server loads the library
+extern const http_library_t http_library;
+
 #endif
@@ -0,0 +1,33 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include "http/tokenizer.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Single pass request scanner.
+ *
+ * Produces the same tokens as `tokenize_http_request` for ordinary requests, without allocating or backtracking. It
+ * only accepts the common shape of a request: `METHOD SP URI SP HTTP/x.y CRLF`, then `name: value CRLF` lines and a
+ * blank line. Anything else is rejected so the caller can hand it to the combinator tokenizer, which knows the full
+ * grammar.
+ */
+
+// Character classes, every byte maps to a mask of these
+#define SCAN_TOKEN 0x01    // Method and header name characters
+#define SCAN_URI 0x02      // Visible characters
+#define SCAN_VALUE 0x04    // Header value characters, visible characters plus SP, HT and obs-text
+
+typedef enum
+{
+    SCAN_IMPL_UNKNOWN,
+    SCAN_IMPL_SCALAR,    // One table lookup per byte
+    SCAN_IMPL_SSE2,      // 16 bytes at a time for URIs and header values
+    SCAN_IMPL_AVX2       // 32 bytes at a time for every class
+} SCAN_IMPL;
+
+ssize_t   scan_http_request(http_request_tokens_t *tokens, const char *request, size_t len);
+SCAN_IMPL scan_implementation(void);
+
+#endif
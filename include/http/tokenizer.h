@@ -1,6 +1,8 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include "http/http-info.h"
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -53,22 +55,54 @@ typedef struct
 typedef struct
 {
     const char *literal;
+    size_t      len;
 } literal_parser_ctx_t;
 
+/*
+ * Grammar nodes that never change are declared static, so they are built at compile time and shared by every call
+ * instead of being allocated and freed on each one. A static node is referenced from another node with the macro for
+ * its kind, e.g. `SEQUENCE(name)`, and run with `NODE_START(SEQUENCE(name), string)`.
+ */
+#define STATIC_SEQUENCE(name, ...)                                                                                                                                                                                                                                 \
+    static parser_wrapper_t name##_parsers[] = {__VA_ARGS__};                                                                                                                                                                                                      \
+    static parser_ctx_t     name##_ctx       = {name##_parsers, sizeof(name##_parsers) / sizeof(parser_wrapper_t)}
+#define STATIC_CHOICE(name, ...)                                                                                                                                                                                                                                   \
+    static parser_wrapper_t name##_parsers[] = {__VA_ARGS__};                                                                                                                                                                                                      \
+    static parser_ctx_t     name##_ctx       = {name##_parsers, sizeof(name##_parsers) / sizeof(parser_wrapper_t)}
+#define STATIC_MANY(name, parser, min, max)                                                                                                                                                                                                                        \
+    static parser_wrapper_t  name##_parsers[] = {parser};                                                                                                                                                                                                          \
+    static many_parser_ctx_t name##_ctx       = {name##_parsers, 1, min, max}
+#define STATIC_LIST(name, parser, min, max)                                                                                                                                                                                                                        \
+    static parser_wrapper_t  name##_parsers[] = {parser};                                                                                                                                                                                                          \
+    static many_parser_ctx_t name##_ctx       = {name##_parsers, 1, min, max}
+#define STATIC_OPTIONAL(name, parser)                                                                                                                                                                                                                              \
+    static parser_wrapper_t  name##_parsers[] = {parser};                                                                                                                                                                                                          \
+    static many_parser_ctx_t name##_ctx       = {name##_parsers, 1, 0, 1}
+#define STATIC_LITERAL(name, string) static literal_parser_ctx_t name##_ctx = {string, sizeof(string) - 1}
+
+#define SEQUENCE(name) {parser_sequence, &name##_ctx}
+#define CHOICE(name) {parser_choice, &name##_ctx}
+#define MANY(name) {parser_many, &name##_ctx}
+#define LIST(name) {parser_many, &name##_ctx}
+#define OPTIONAL(name) {parser_many, &name##_ctx}
+#define LITERAL(name) {parser_literal, &name##_ctx}
+#define NODE_START(node, s) parser_run(&(parser_wrapper_t)node, (s))
+
+// Every token points into the tokenized request
 typedef struct
 {
-    char *method;
-    char *uri;
-    char *version;
-    char *headers;
-    char *body;
+    http_slice_t method;
+    http_slice_t uri;
+    http_slice_t version;
+    http_slice_t headers;    // Every header line, without the blank line that ends them
+    http_slice_t body;
 } http_request_tokens_t;
 
 // Tokenizers
 ssize_t tokenize_request_line(http_request_tokens_t *tokens, const char *request);
 ssize_t tokenize_headers(http_request_tokens_t *tokens, const char *request);
 ssize_t tokenize_body(http_request_tokens_t *tokens, const char *request);
-ssize_t tokenize_http_request(http_request_tokens_t *tokens, const char *request);
+ssize_t tokenize_http_request(http_request_tokens_t *tokens, const char *request, size_t len, bool memoize);
 
 // Combinators
 ssize_t parser_sequence(const char *string, void *ctx);
@@ -76,6 +110,7 @@ ssize_t parser_choice(const char *string, void *ctx);
 ssize_t parser_many(const char *string, void *ctx);
 ssize_t parser_list(const char *string, void *ctx);
 ssize_t parser_literal(const char *string, void *ctx);
+ssize_t parser_run(const parser_wrapper_t *wrapper, const char *string);
 
 combinator_t *sequence(size_t nparsers, parser_wrapper_t *parsers);
 combinator_t *choice(size_t nparsers, parser_wrapper_t *parsers);
@@ -5,13 +5,21 @@
 
 #define LIBHTTP_PATH "./libhttp.so"
 
-int reload_library(const char *filepath);
+/*
+ * A loaded copy of the HTTP library. The loader holds a reference to the current library and every request holds one
+ * to the library it started on, so a reload never closes a library that is still in use.
+ */
+typedef struct
+{
+    void                 *handle;
+    const http_library_t *api;
+    size_t                refs;
+} library_t;
 
-int request_init(http_request_t *, const char *, int *);
-int request_parse(http_request_t *, const char *, int *);
-int request_process(http_request_t *, http_response_t *, int *);
-int response_write(const http_response_t *, const http_request_t *, char **, int *);
-int request_destroy(http_request_t *, int *);
-int response_destroy(http_response_t *, int *);
+int        reload_library(const char *filepath);
+library_t *library_acquire(void);
+void       library_release(library_t *library);
+
+const char *get_mime_type(const char *);
 
 #endif
@@ -3,28 +3,91 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
-#include <ndbm.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 
-#ifdef __APPLE__
-typedef size_t datum_size;
-#else
-typedef int datum_size;
-#endif
+#define DB_RECORDS "db_records"
+#define DB_ENGINE_DEFAULT "ndbm"
+
+/*
+ * Storage engines.
+ *
+ * Records are keyed by NUL terminated strings. Every engine implements the same table of operations and the one a
+ * database uses is picked by name when it is opened, nothing outside of the engines knows how records are laid out.
+ *
+ * Values returned by `get` and handed to `iterate` callbacks point into the engine's own buffers, they are only valid
+ * until the next call on the database. Puts may be buffered by the engine until the next flush.
+ */
+
+// Returns 0 to keep iterating, anything else stops the iteration and is returned by db_iterate
+typedef int (*db_iterate_fn)(const char *key, const uint8_t *value, size_t len, void *arg);
 
 typedef struct
 {
-    const void *dptr;
-    datum_size  dsize;
-} const_datum;
+    const char        *name;
+    const char *const *files;    // Suffixes of the files the engine keeps at its path, NULL terminated
 
-#define MAKE_CONST_DATUM(str) ((const_datum){(str), (datum_size)strlen(str) + 1})
-#define DB_RECORDS "db_records"
+    int (*open)(void **handle, const char *filepath, int *err);
+    int (*put)(void *handle, const char *key, const uint8_t *value, size_t len, int *err);
+    uint8_t *(*get)(void *handle, const char *key, size_t *len, int *err);
+    int (*iterate)(void *handle, db_iterate_fn fn, void *arg, int *err);
+    int (*flush)(void *handle, bool durable, int *err);    // Writes out buffered puts, and syncs them to disk when durable
+    void (*close)(void *handle);
+} db_engine_t;
+
+typedef struct
+{
+    const db_engine_t *engine;
+    void              *handle;
+} db_t;
+
+extern const db_engine_t db_ndbm_engine;    // NDBM files, records are written in place into hashed pages
+extern const db_engine_t db_log_engine;     // Append-only log with an in-memory index, records are only ever appended
+
+/*
+ * Per-worker cache of recently read records.
+ *
+ * The store bumps a generation counter shared with the workers once per committed batch, before any insert of the
+ * batch is acknowledged. A worker drops its cached records as soon as it sees the counter move, so a client always
+ * reads back what it just wrote, whichever worker stored it.
+ */
+
+#define DB_CACHE_SLOTS 256
+#define DB_CACHE_MAX_VALUE 16384    // Larger records are always read from the database
+
+typedef struct
+{
+    bool     used;
+    uint32_t hash;
+    size_t   key_len;
+    size_t   value_len;
+    size_t   capacity;
+    uint8_t *data;    // The key, NUL terminated, followed by the value
+} db_cache_slot_t;
+
+typedef struct
+{
+    uint64_t       *generation;    // Shared by every process
+    uint64_t        seen;          // Generation the slots were filled at
+    db_cache_slot_t slots[DB_CACHE_SLOTS];
+} db_cache_t;
+
+const db_engine_t *db_find_engine(const char *name);
+
+int      db_insert(db_t *db, const char *key, const uint8_t *buf, size_t size, int *err);
+uint8_t *db_fetch(db_t *db, const char *key, size_t *len, int *err);
+int      db_iterate(db_t *db, db_iterate_fn fn, void *arg, int *err);
+int      db_flush(db_t *db, bool durable, int *err);
 
-int      db_insert(DBM *db, const char *key, const uint8_t *buf, size_t size, int *err);
-uint8_t *db_fetch(DBM *db, const char *key, size_t *len, int *err);
+int  db_init(db_t *db, const char *engine, const char *filepath, int *err);
+void db_destroy(db_t *db);
 
-int  db_init(DBM **db, const char *filepath, int *err);
-void db_destroy(DBM **db);
+int            db_cache_init(db_cache_t *cache, int *err);
+void           db_cache_destroy(db_cache_t *cache);
+const uint8_t *db_cache_lookup(db_cache_t *cache, const char *key, size_t *len);
+void           db_cache_store(db_cache_t *cache, const char *key, const uint8_t *value, size_t len);
+void           db_cache_invalidate(db_cache_t *cache);
+uint64_t       db_cache_generation(const db_cache_t *cache);
 
 #endif
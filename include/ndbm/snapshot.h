@@ -0,0 +1,64 @@
+// cppcheck-suppress-file unusedStructMember
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "ndbm/database.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Read-only snapshot of the record store.
+ *
+ * The store periodically writes every record into `<filepath>.snap`: a header, a heap of NUL terminated keys each
+ * followed by its value, and an entry table sorted by key. The file is written under a temporary name and renamed into
+ * place, so it is swapped atomically. Every worker maps the newest snapshot and binary-searches it without taking a
+ * lock or making a system call, the store is only asked for records the snapshot can't answer.
+ *
+ * A snapshot records the commit generation it was taken at. It is only trusted while no insert has been committed
+ * since, so a client always reads back what it just wrote. A shared counter is bumped on every publish, workers remap
+ * the file the next time they look something up.
+ */
+
+#define DB_SNAPSHOT_MAGIC 0x50414E53U    // "SNAP"
+#define DB_SNAPSHOT_VERSION 1
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;      // Commits made when the snapshot was taken
+    uint64_t nrecords;
+    uint64_t index_offset;    // Entry table, after the heap
+    uint64_t size;            // Whole file
+} db_snapshot_header_t;
+
+typedef struct
+{
+    uint64_t key_offset;    // NUL terminated
+    uint64_t key_len;
+    uint64_t value_offset;
+    uint64_t value_len;
+} db_snapshot_entry_t;
+
+typedef struct
+{
+    uint64_t *sequence;    // Shared by every process, bumped by the store whenever it publishes a snapshot
+    char     *path;
+    char     *tmp_path;
+
+    // Snapshot mapped by this process
+    uint64_t                    seen;    // Sequence the mapping was made at
+    uint8_t                    *base;
+    size_t                      size;
+    const db_snapshot_header_t *header;
+    const db_snapshot_entry_t  *entries;    // Sorted by key, inside the mapping
+} db_snapshot_t;
+
+int  db_snapshot_init(db_snapshot_t *snapshot, const char *filepath, int *err);
+void db_snapshot_destroy(db_snapshot_t *snapshot);
+int  db_snapshot_publish(db_snapshot_t *snapshot, db_t *db, uint64_t generation, int *err);
+int  db_snapshot_lookup(db_snapshot_t *snapshot, uint64_t generation, const char *key, const uint8_t **value, size_t *len);
+
+#endif
@@ -4,6 +4,7 @@
 #define NETWORKING_H
 
 #include <netinet/in.h>
+#include <stdbool.h>
 
 typedef struct
 {
@@ -13,7 +14,7 @@ typedef struct
 } client_t;
 
 int tcp_socket(struct sockaddr_storage *sockaddr, int *err);
-int tcp_server(char *address, in_port_t port);
+int tcp_server(char *address, in_port_t port, bool reuseport);
 int tcp_accept(int sockfd, client_t *client, int *err);
 
 int dmn_server(const char *socket_path, int *err);
@@ -0,0 +1,48 @@
+// cppcheck-suppress-file unusedStructMember
+
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * Readiness notification backend.
+ *
+ * On Linux this is backed by epoll, where every fd carries a user data pointer that is handed back with its events.
+ * Other platforms fall back to a poll(2) array with a parallel array of user data pointers.
+ *
+ * Events are always reported using the poll(2) flags (POLLIN, POLLOUT, POLLHUP, POLLERR).
+ */
+
+typedef struct
+{
+    int   fd;
+    short revents;
+    void *data;
+} poller_event_t;
+
+typedef struct
+{
+    size_t max_fds;
+    size_t nfds;
+    bool   edge_triggered;    // Only honoured by the epoll backend
+
+#ifdef __linux__
+    int epfd;
+#else
+    struct pollfd *pollfds;
+    void         **data;
+#endif
+} poller_t;
+
+int poller_init(poller_t *poller, size_t max_fds, bool edge_triggered, int *err);
+int poller_destroy(poller_t *poller, int *err);
+
+int poller_add(poller_t *poller, int fd, short events, void *data, int *err);
+int poller_modify(poller_t *poller, int fd, short events, void *data, int *err);
+int poller_remove(poller_t *poller, int fd, int *err);
+int poller_wait(poller_t *poller, poller_event_t *events, size_t max_events, int timeout, int *err);
+
+#endif
@@ -5,42 +5,74 @@
 
 #define NUM_WORKERS 3
 
+#include "cache.h"
 #include "ndbm/database.h"
+#include "ndbm/snapshot.h"
+#include "poller.h"
+#include "store.h"
 #include "worker.h"
 #include <poll.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 typedef struct
 {
-    DBM *db;
+    db_cache_t db_cache;     // Only the generation counter is shared, the store bumps it and the workers cache the records
+    pid_t      store_pid;    // Single process holding the database, 0 until `app_start_store`
+
+    db_snapshot_t snapshot;    // Published by the store, read by the workers
 
     size_t max_clients;
 
-    size_t npollfds;
     size_t nworkers;
+    size_t nworker_slots;    // Highest worker slot in use + 1, slots never move so pollers can point at them
     size_t desired_workers;
 
-    struct pollfd *pollfds;
-    worker_t      *workers;
+    int       sockfd;    // Server socket, polled with NULL user data
+    poller_t  poller;
+    worker_t *workers;
+
+    cache_t  cache;
+    uint64_t cache_refreshed_ms;    // Monotonic time of the last cache refresh
+
+    const char *libhttp_path;
+    int         libwatch_fd;    // Watch on the HTTP library's directory, polled with a pointer to itself
 } app_state_t;
 
-int app_init(app_state_t *state, size_t max_clients, int *err);
+int app_init(app_state_t *state, size_t max_clients, bool edge_triggered, int *err);
 int app_destroy(app_state_t *state, int *err);
 
+// Record store
+int app_start_store(app_state_t *state, const store_config_t *config, int *err);
+int app_stop_store(app_state_t *state, int *err);
+
 worker_t *app_create_worker(app_state_t *state, int *err);
 worker_t *app_add_worker(app_state_t *state, const worker_t *worker, int *err);
 worker_t *app_find_available_worker(const app_state_t *state, int *err);
+worker_t *app_find_idle_worker(const app_state_t *state, int *err);
 int       app_remove_worker(app_state_t *state, pid_t pid, int *err);
 
 // Worker Scaling
 int app_set_desired_workers(app_state_t *state, size_t desired, int *err);
 int app_health_check_workers(app_state_t *state, int *err);
-int app_scale_workers(app_state_t *state, const char *public_dir, int *err);
+int app_scale_workers(app_state_t *state, const worker_config_t *config, int *err);
 
 worker_t *app_find_worker_by_fd(const app_state_t *state, int fd);
-worker_t *app_find_worker_by_client_fd(const app_state_t *state, int fd);
 
-struct pollfd *app_poll(app_state_t *state, int fd, int *err);
-int            app_unpoll(app_state_t *state, int fd, int *err);
+int app_poll(app_state_t *state, int fd, void *data, int *err);
+int app_unpoll(app_state_t *state, int fd, int *err);
+int app_wait(app_state_t *state, poller_event_t *events, size_t max_events, int timeout, int *err);
+int app_listen(app_state_t *state, int sockfd, int *err);
+int app_pause_accepting(app_state_t *state, int *err);
+int app_resume_accepting(app_state_t *state, int *err);
+
+// Static file cache
+int app_init_cache(app_state_t *state, const char *public_dir, size_t max_size, int *err);
+int app_refresh_cache(app_state_t *state, bool force, int *err);
+
+// HTTP library
+int  app_watch_library(app_state_t *state, const char *filepath, int *err);
+bool app_library_changed(app_state_t *state);
+int  app_reload_library(app_state_t *state, int *err);
 
 #endif
@@ -0,0 +1,99 @@
+// cppcheck-suppress-file unusedStructMember
+
+#ifndef STORE_H
+#define STORE_H
+
+#include "ndbm/database.h"
+#include "ndbm/snapshot.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/*
+ * Record store process.
+ *
+ * A single process owns the database handle, workers send it their inserts and lookups over a domain socket instead
+ * of writing to the database files themselves. Inserts are collected into a batch that is committed at once: every
+ * record of the batch is stored, the files are synced if the durability mode asks for it, and only then is each
+ * insert acknowledged. A batch is committed once the store has read everything its workers have sent, or once the
+ * flush interval has passed when there is one, so inserts that arrive together share a single commit.
+ *
+ * Lookups are answered straight away from what has been committed. Workers answer most of them on their own, from the
+ * read-only snapshot the store republishes every snapshot interval while inserts keep being committed.
+ */
+
+#define STORE_BATCH_MAX_RECORDS 1024
+#define STORE_BATCH_MAX_SIZE (4 * 1024 * 1024)    // Bytes of keys and values held before a batch is committed early
+#define STORE_MAX_KEY_SIZE 4096
+#define STORE_TIMEOUT_MS 1000    // Longest a worker waits on the store socket before it gives up on a request
+
+typedef enum
+{
+    STORE_DURABILITY_NONE,    // Committed records are written back by the OS whenever it sees fit
+    STORE_DURABILITY_SYNC     // Every commit reaches the disk before it is acknowledged
+} STORE_DURABILITY;
+
+typedef enum
+{
+    STORE_OP_INSERT = 1,
+    STORE_OP_FETCH  = 2
+} STORE_OP;
+
+// Every message starts with this header. Requests are followed by the key and the value, replies by the value.
+typedef struct
+{
+    uint32_t op;
+    int32_t  status;    // Replies only, 0 or an errno value
+    uint64_t token;     // Chosen by the worker, handed back with the reply
+    uint64_t key_len;
+    uint64_t value_len;
+} store_message_t;
+
+typedef struct
+{
+    const char      *db_engine;    // Name of the storage engine
+    const char      *db_path;
+    const char      *socket_path;
+    size_t           max_clients;
+    unsigned int     flush_interval_ms;       // How long a batch waits for more inserts, 0 commits once nothing is left to read
+    unsigned int     snapshot_interval_ms;    // Least time between two snapshots
+    STORE_DURABILITY durability;
+} store_config_t;
+
+// A reply to an insert
+typedef struct
+{
+    uint64_t token;
+    int      status;    // 0 once the record has been committed, the errno value it failed with otherwise
+} store_ack_t;
+
+// A worker's end of the store socket
+typedef struct
+{
+    int      fd;
+    uint64_t nfetches;    // Lookups sent so far, each one's reply carries its number
+
+    // Replies that have been received and not handled yet
+    uint8_t *inbuf;
+    size_t   inbuf_len;
+    size_t   inbuf_size;
+    size_t   inbuf_handled;
+
+    // Replies to inserts, appended by every call that reads replies
+    store_ack_t *acks;
+    size_t       nacks;
+    size_t       acks_size;
+} store_client_t;
+
+// Store process
+_Noreturn void store_entrypoint(int listenfd, db_cache_t *db_cache, db_snapshot_t *snapshot, const store_config_t *config);
+
+// Workers
+int      store_connect(store_client_t *client, const char *socket_path, int *err);
+void     store_disconnect(store_client_t *client);
+int      store_insert(store_client_t *client, const char *key, const uint8_t *value, size_t len, uint64_t token, int *err);
+uint8_t *store_fetch(store_client_t *client, const char *key, size_t *len, int *err);
+int      store_receive(store_client_t *client, int *err);
+
+#endif
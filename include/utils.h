@@ -5,6 +5,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#define MS_PER_SECOND 1000
+#define NS_PER_MS 1000000
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
 #define unused(x) ((void)(x))
 #define arrlen(x) ((sizeof(x)) / (sizeof((x)[0])))
 #define seterr(x)                                                                                                                                                                                                                                                  \
@@ -30,4 +35,8 @@ char *str_toupper(char *str, int *err);
 char *make_string(const char *fmt, ...) __attribute__((format(printf, 1, 0)));
 int   explode(char ***tokens, const char *string, const char *delimiter);
 
+uint64_t monotonic_ms(void);
+uint32_t hash_bytes(const void *data, size_t len);
+bool     would_block(int err);
+
 #endif
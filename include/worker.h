@@ -3,25 +3,55 @@
 #ifndef WORKER_H
 #define WORKER_H
 
+#include "cache.h"
 #include "loader.h"
 #include "ndbm/database.h"
+#include "ndbm/snapshot.h"
 #include "networking.h"
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
+#define MAX_WORKER_CONNECTIONS 512
+
+// Tags sent along with every file descriptor the server hands to a worker
+#define WORKER_MESSAGE_CLIENT 'c'    // A client connection
+#define WORKER_MESSAGE_CACHE 'm'     // A new static file cache snapshot
+
 typedef struct
 {
-    int      fd;    // FD to socket used to communicate with worker
-    pid_t    pid;
-    client_t client;
+    int    fd;    // FD to socket used to communicate with worker
+    pid_t  pid;
+    size_t nconnections;    // Connections handed to the worker that it hasn't closed yet
 } worker_t;
 
+typedef struct
+{
+    const char *public_dir;
+    const char *libhttp_path;
+    bool        edge_triggered;
+    bool        strict_parser;    // Check every request against the full HTTP grammar instead of scanning it
+
+    // Keep-alive limits
+    unsigned int idle_timeout;    // Seconds an idle connection is kept open
+    size_t       max_requests;    // Requests answered on a connection before it is closed
+
+    size_t      max_body_size;    // Largest request body accepted, in bytes
+    const char *db_prefix;        // GET requests under this path read back POSTed records
+    const char *store_path;       // Socket of the store process
+
+    // With `reuseport`, every worker listens on address:port itself instead of receiving clients from the server
+    bool      reuseport;
+    char     *address;
+    in_port_t port;
+} worker_config_t;
+
 int spawn_worker(worker_t *worker, int *err);
 int signal_worker(const worker_t *worker, int signal, int *err);
 int reset_worker(worker_t *worker, int *err);
 int assign_client_to_worker(worker_t *worker, const client_t *client, int *err);
 
-void worker_entrypoint(DBM *db, const char *public_dir);
+void worker_entrypoint(db_cache_t *db_cache, db_snapshot_t *snapshot, cache_t *cache, const worker_config_t *config);
 
 #endif
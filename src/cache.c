@@ -0,0 +1,773 @@
+#include "cache.h"
+#include "loader.h"
+#include "logger.h"
+#include "utils.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC 0x48434143    // "CACH"
+#define CACHE_MAX_DEPTH 8
+
+static int      scan_dir(cache_t *cache, const char *dir_path, const char *uri_prefix, int depth);
+static void     track_file(cache_t *cache, const char *uri, const char *path, const struct stat *file_stat);
+static void     forget_file(cache_t *cache, size_t slot);
+static void     select_files(cache_t *cache);
+static uint64_t snapshot_signature(const cache_t *cache);
+static int      build_snapshot(cache_t *cache, int *err);
+static int      create_snapshot_fd(size_t size, int *err);
+static int      compare_entries(const void *a, const void *b);
+static int      compare_recency(const void *a, const void *b);
+
+// qsort has no user data, the file list being ranked is kept here while sorting
+static const cache_file_t *ranked_files  = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static const cache_stat_t *ranked_stats  = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static const uint8_t      *sorted_base   = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+int cache_init(cache_t *cache, const char *public_dir, size_t max_size, int *err)
+{
+    void *stats;
+
+    seterr(0);
+    if(cache == NULL || public_dir == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(cache, 0, sizeof(cache_t));
+    cache->fd         = -1;
+    cache->public_dir = public_dir;
+    cache->max_size   = max_size;
+
+    // Anonymous shared memory is inherited by every worker forked after this point
+    errno = 0;
+    stats = mmap(NULL, CACHE_MAX_FILES * sizeof(cache_stat_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(stats == MAP_FAILED)
+    {
+        seterr(errno);
+        return -2;
+    }
+    cache->stats = (cache_stat_t *)stats;
+
+    errno        = 0;
+    cache->files = (cache_file_t *)calloc(CACHE_MAX_FILES, sizeof(cache_file_t));
+    if(cache->files == NULL)
+    {
+        seterr(errno);
+        munmap(stats, CACHE_MAX_FILES * sizeof(cache_stat_t));
+        cache->stats = NULL;
+        return -3;
+    }
+
+    return 0;
+}
+
+int cache_destroy(cache_t *cache, int *err)
+{
+    seterr(0);
+    if(cache == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(cache->base)
+    {
+        munmap(cache->base, cache->size);
+    }
+
+    if(cache->fd > -1)
+    {
+        close(cache->fd);
+    }
+
+    if(cache->stats)
+    {
+        munmap(cache->stats, CACHE_MAX_FILES * sizeof(cache_stat_t));
+    }
+
+    for(size_t slot = 0; cache->files && slot < cache->nfiles; slot++)
+    {
+        free(cache->files[slot].uri);
+        free(cache->files[slot].path);
+    }
+    free(cache->files);
+
+    memset(cache, 0, sizeof(cache_t));
+    cache->fd = -1;
+
+    return 0;
+}
+
+/*
+ * Rescans the public directory and builds a new snapshot if the cached files or their contents have changed.
+ *
+ * The new snapshot is mapped by the server, `changed` tells the caller to hand it to the workers.
+ */
+int cache_refresh(cache_t *cache, bool *changed, int *err)
+{
+    char    *root;
+    size_t   root_len;
+    uint64_t signature;
+
+    *changed = false;
+
+    seterr(0);
+    if(cache == NULL || cache->files == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    // Strip the trailing slashes, URIs are built as "<root>/<name>"
+    root_len = strlen(cache->public_dir);
+    while(root_len > 1 && cache->public_dir[root_len - 1] == '/')
+    {
+        root_len--;
+    }
+
+    root = strndup(cache->public_dir, root_len);
+    if(root == NULL)
+    {
+        seterr(ENOMEM);
+        return -2;
+    }
+
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        cache->files[slot].present = false;
+    }
+
+    scan_dir(cache, root, "", 0);
+    free(root);
+
+    // Files that have disappeared give up their stats slot
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        if(cache->files[slot].uri && !cache->files[slot].present)
+        {
+            forget_file(cache, slot);
+        }
+    }
+
+    select_files(cache);
+
+    signature = snapshot_signature(cache);
+    if(cache->fd > -1 && signature == cache->signature)
+    {
+        return 0;
+    }
+
+    if(build_snapshot(cache, err) < 0)
+    {
+        return -3;
+    }
+
+    cache->signature = signature;
+    *changed         = true;
+
+    return 0;
+}
+
+/*
+ * Maps a snapshot read-only and releases the previous one. The cache takes ownership of the fd.
+ *
+ * Responses that are still being sent from the previous snapshot hold their own duplicate of its fd.
+ */
+int cache_attach(cache_t *cache, int fd, int *err)
+{
+    struct stat                    snapshot_stat;
+    void                          *base;
+    const cache_snapshot_header_t *header;
+
+    seterr(0);
+    if(cache == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    errno = 0;
+    if(fstat(fd, &snapshot_stat) < 0)
+    {
+        seterr(errno);
+        close(fd);
+        return -2;
+    }
+
+    if((size_t)snapshot_stat.st_size < sizeof(cache_snapshot_header_t))
+    {
+        seterr(EINVAL);
+        close(fd);
+        return -3;
+    }
+
+    errno = 0;
+    base  = mmap(NULL, (size_t)snapshot_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED)
+    {
+        seterr(errno);
+        close(fd);
+        return -4;
+    }
+
+    header = (const cache_snapshot_header_t *)base;
+    if(header->magic != CACHE_MAGIC || header->size != (uint64_t)snapshot_stat.st_size)
+    {
+        seterr(EINVAL);
+        munmap(base, (size_t)snapshot_stat.st_size);
+        close(fd);
+        return -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+    if(cache->base)
+    {
+        munmap(cache->base, cache->size);
+    }
+
+    if(cache->fd > -1)
+    {
+        close(cache->fd);
+    }
+
+    cache->fd   = fd;
+    cache->base = base;
+    cache->size = (size_t)snapshot_stat.st_size;
+
+    return 0;
+}
+
+/*
+ * Finds the entry for a URI of `len` bytes, the URI doesn't need to be NUL terminated. The entries are sorted by hash,
+ * so this is a binary search followed by a string compare.
+ */
+const cache_entry_t *cache_lookup(const cache_t *cache, const char *uri, size_t len)
+{
+    const cache_snapshot_header_t *header;
+    const cache_entry_t           *entries;
+    uint32_t                       hash;
+    size_t                         low;
+    size_t                         high;
+
+    if(cache == NULL || cache->base == NULL || uri == NULL)
+    {
+        return NULL;
+    }
+
+    header  = (const cache_snapshot_header_t *)cache->base;
+    entries = (const cache_entry_t *)(header + 1);
+    hash    = hash_bytes(uri, len);
+
+    // Find the first entry with the hash
+    low  = 0;
+    high = header->nentries;
+    while(low < high)
+    {
+        size_t mid = low + ((high - low) / 2);
+
+        if(entries[mid].hash < hash)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    for(size_t idx = low; idx < header->nentries && entries[idx].hash == hash; idx++)
+    {
+        if(entries[idx].uri_len == len && memcmp((const char *)cache->base + entries[idx].uri_offset, uri, len) == 0)
+        {
+            return &entries[idx];
+        }
+    }
+
+    return NULL;
+}
+
+void cache_record_hit(const cache_t *cache, const cache_entry_t *entry, uint64_t now_ms)
+{
+    cache_stat_t *stat;
+
+    if(cache->stats == NULL || entry->stat_slot >= CACHE_MAX_FILES)
+    {
+        return;
+    }
+
+    // Workers only ever bump counters, the server reads them when ranking, so relaxed ordering is enough
+    stat = &cache->stats[entry->stat_slot];
+    __atomic_fetch_add(&stat->hits, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&stat->last_access_ms, now_ms, __ATOMIC_RELAXED);
+}
+
+const char *cache_entry_headers(const cache_t *cache, const cache_entry_t *entry)
+{
+    return (const char *)cache->base + entry->headers_offset;
+}
+
+const char *cache_entry_body(const cache_t *cache, const cache_entry_t *entry)
+{
+    return (const char *)cache->base + entry->body_offset;
+}
+
+static int scan_dir(cache_t *cache, const char *dir_path, const char *uri_prefix, int depth)
+{
+    DIR                 *dir;
+    const struct dirent *dirent;
+
+    errno = 0;
+    dir   = opendir(dir_path);
+    if(dir == NULL)
+    {
+        log_error("cache::opendir: \"%s\" %s\n", dir_path, strerror(errno));
+        return -1;
+    }
+
+    while((dirent = readdir(dir)) != NULL)
+    {
+        struct stat file_stat;
+        char       *path;
+        char       *uri;
+
+        // Skips ".", ".." and hidden files
+        if(dirent->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        path = make_string("%s/%s", dir_path, dirent->d_name);
+        uri  = make_string("%s/%s", uri_prefix, dirent->d_name);
+        if(path == NULL || uri == NULL)
+        {
+            free(path);
+            free(uri);
+            continue;
+        }
+
+        if(stat(path, &file_stat) == 0)
+        {
+            if(S_ISDIR(file_stat.st_mode) && depth < CACHE_MAX_DEPTH)
+            {
+                scan_dir(cache, path, uri, depth + 1);
+            }
+            else if(S_ISREG(file_stat.st_mode))
+            {
+                track_file(cache, uri, path, &file_stat);
+            }
+        }
+
+        free(path);
+        free(uri);
+    }
+
+    closedir(dir);
+
+    return 0;
+}
+
+static void track_file(cache_t *cache, const char *uri, const char *path, const struct stat *file_stat)
+{
+    cache_file_t *file = NULL;
+
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        if(cache->files[slot].uri && strcmp(cache->files[slot].uri, uri) == 0)
+        {
+            file = &cache->files[slot];
+            break;
+        }
+    }
+
+    // A new file takes the first free slot
+    if(file == NULL)
+    {
+        size_t slot = 0;
+
+        while(slot < cache->nfiles && cache->files[slot].uri != NULL)
+        {
+            slot++;
+        }
+
+        if(slot == CACHE_MAX_FILES)
+        {
+            return;    // Too many files, the rest are always served from disk
+        }
+
+        file       = &cache->files[slot];
+        file->uri  = strdup(uri);
+        file->path = strdup(path);
+        if(file->uri == NULL || file->path == NULL)
+        {
+            forget_file(cache, slot);
+            return;
+        }
+
+        memset(&cache->stats[slot], 0, sizeof(cache_stat_t));
+        if(slot == cache->nfiles)
+        {
+            cache->nfiles++;
+        }
+    }
+
+    file->size       = file_stat->st_size;
+    file->mtime      = file_stat->st_mtim.tv_sec;
+    file->mtime_nsec = file_stat->st_mtim.tv_nsec;
+    file->present    = true;
+}
+
+static void forget_file(cache_t *cache, size_t slot)
+{
+    cache_file_t *file = &cache->files[slot];
+
+    free(file->uri);
+    free(file->path);
+    memset(file, 0, sizeof(cache_file_t));
+    memset(&cache->stats[slot], 0, sizeof(cache_stat_t));
+
+    while(cache->nfiles > 0 && cache->files[cache->nfiles - 1].uri == NULL)
+    {
+        cache->nfiles--;
+    }
+}
+
+/*
+ * Decides which files go into the snapshot: the most recently used files first, until the size limit is reached.
+ */
+static void select_files(cache_t *cache)
+{
+    size_t *ranking;
+    size_t  nranked = 0;
+    size_t  total   = 0;
+
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        cache->files[slot].cached = false;
+    }
+
+    ranking = (size_t *)calloc(cache->nfiles + 1, sizeof(size_t));
+    if(ranking == NULL)
+    {
+        return;
+    }
+
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        const cache_file_t *file = &cache->files[slot];
+
+        if(file->uri && file->present && file->size <= CACHE_MAX_FILE_SIZE)
+        {
+            ranking[nranked++] = slot;
+        }
+    }
+
+    ranked_files = cache->files;
+    ranked_stats = cache->stats;
+    qsort(ranking, nranked, sizeof(size_t), compare_recency);
+
+    // Least recently used files are the ones left out
+    for(size_t idx = 0; idx < nranked; idx++)
+    {
+        cache_file_t *file = &cache->files[ranking[idx]];
+
+        if(total + (size_t)file->size <= cache->max_size)
+        {
+            file->cached = true;
+            total += (size_t)file->size;
+        }
+    }
+
+    free(ranking);
+}
+
+static uint64_t snapshot_signature(const cache_t *cache)
+{
+    uint64_t signature = FNV_OFFSET_BASIS;
+
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        const cache_file_t *file = &cache->files[slot];
+        const uint64_t      fields[] = {slot, file->uri != NULL, file->cached, (uint64_t)file->size, (uint64_t)file->mtime, (uint64_t)file->mtime_nsec};
+
+        for(size_t idx = 0; idx < arrlen(fields); idx++)
+        {
+            signature = (signature ^ fields[idx]) * FNV_PRIME;
+        }
+    }
+
+    return signature;
+}
+
+/*
+ * Writes every known file into a new snapshot and maps it in place of the current one.
+ *
+ * Layout: [header][entries sorted by hash][URIs and header blocks][bodies]
+ */
+static int build_snapshot(cache_t *cache, int *err)
+{
+    size_t   nentries = 0;
+    size_t   size;
+    size_t   strings_offset;
+    size_t   bodies_offset;
+    int      fd;
+    void    *base;
+    uint8_t *bytes;    // The snapshot being written, for offsets into it
+    char   **header_blocks;
+
+    cache_snapshot_header_t *header;
+    cache_entry_t           *entries;
+
+    errno         = 0;
+    header_blocks = (char **)calloc(cache->nfiles + 1, sizeof(char *));
+    if(header_blocks == NULL)
+    {
+        seterr(errno);
+        return -1;
+    }
+
+    // Size the snapshot, the header blocks are rendered once here and copied in below
+    size = 0;
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        const cache_file_t *file = &cache->files[slot];
+
+        if(file->uri == NULL)
+        {
+            continue;
+        }
+
+        nentries++;
+        size += strlen(file->uri) + 1;
+
+        if(file->cached)
+        {
+            header_blocks[slot] = make_string("Content-Type: %s\r\nContent-Length: %jd\r\n", get_mime_type(file->path), (intmax_t)file->size);
+            if(header_blocks[slot] == NULL)
+            {
+                continue;
+            }
+
+            size += strlen(header_blocks[slot]) + 1 + (size_t)file->size;
+        }
+    }
+
+    strings_offset = sizeof(cache_snapshot_header_t) + (nentries * sizeof(cache_entry_t));
+    bodies_offset  = strings_offset;
+    size += strings_offset;
+
+    fd = create_snapshot_fd(size, err);
+    if(fd < 0)
+    {
+        fd = -2;
+        goto cleanup;
+    }
+
+    errno = 0;
+    base  = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED)
+    {
+        seterr(errno);
+        close(fd);
+        fd = -3;
+        goto cleanup;
+    }
+    bytes = (uint8_t *)base;
+
+    // Strings go first, bodies after every string
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        if(cache->files[slot].uri)
+        {
+            bodies_offset += strlen(cache->files[slot].uri) + 1 + (header_blocks[slot] ? strlen(header_blocks[slot]) + 1 : 0);
+        }
+    }
+
+    header           = (cache_snapshot_header_t *)base;
+    header->magic    = CACHE_MAGIC;
+    header->nentries = (uint32_t)nentries;
+    header->size     = size;
+    entries          = (cache_entry_t *)(header + 1);
+
+    nentries = 0;
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        const cache_file_t *file  = &cache->files[slot];
+        cache_entry_t      *entry = &entries[nentries];
+        size_t              uri_len;
+
+        if(file->uri == NULL)
+        {
+            continue;
+        }
+        nentries++;
+
+        uri_len = strlen(file->uri);
+        memset(entry, 0, sizeof(cache_entry_t));
+        entry->hash       = hash_bytes(file->uri, uri_len);
+        entry->stat_slot  = (uint32_t)slot;
+        entry->uri_offset = (uint32_t)strings_offset;
+        entry->uri_len    = (uint32_t)uri_len;
+        memcpy(bytes + strings_offset, file->uri, uri_len + 1);
+        strings_offset += uri_len + 1;
+
+        if(header_blocks[slot] == NULL)
+        {
+            continue;    // Only tracked, served from disk
+        }
+
+        entry->headers_offset = (uint32_t)strings_offset;
+        entry->headers_len    = (uint32_t)strlen(header_blocks[slot]);
+        memcpy(bytes + strings_offset, header_blocks[slot], entry->headers_len + 1);
+        strings_offset += entry->headers_len + 1;
+
+        // Copy the body, if the file can't be read it's left out and served from disk instead
+        entry->body_offset = bodies_offset;
+        entry->body_len    = (uint64_t)file->size;
+        bodies_offset += (size_t)file->size;
+
+        entry->cached = 1;
+        {
+            int    file_fd;
+            size_t nread = 0;
+
+            file_fd = open(file->path, O_RDONLY | O_CLOEXEC);
+            while(file_fd > -1 && nread < entry->body_len)
+            {
+                ssize_t tread = pread(file_fd, bytes + entry->body_offset + nread, entry->body_len - nread, (off_t)nread);
+                if(tread <= 0)
+                {
+                    break;
+                }
+                nread += (size_t)tread;
+            }
+
+            if(file_fd > -1)
+            {
+                close(file_fd);
+            }
+
+            if(nread != entry->body_len)
+            {
+                entry->cached = 0;
+            }
+        }
+    }
+
+    sorted_base = bytes;
+    qsort(entries, nentries, sizeof(cache_entry_t), compare_entries);
+
+    munmap(base, size);
+
+#ifdef __linux__
+    // The snapshot can't be modified once it has been handed out, workers can trust what they map
+    errno = 0;
+    if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+    {
+        log_warn("cache::fcntl: Failed to seal the snapshot (%s)\n", strerror(errno));
+    }
+#endif
+
+    if(cache_attach(cache, fd, err) < 0)
+    {
+        fd = -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+cleanup:
+    for(size_t slot = 0; slot < cache->nfiles; slot++)
+    {
+        free(header_blocks[slot]);
+    }
+    free(header_blocks);
+
+    return fd < 0 ? fd : 0;
+}
+
+static int create_snapshot_fd(size_t size, int *err)
+{
+    int fd;
+
+#ifdef __linux__
+    errno = 0;
+    fd    = memfd_create("http-cache", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0)
+    {
+        seterr(errno);
+        return -1;
+    }
+#else
+    char path[] = "/tmp/http-cache-XXXXXX";
+
+    // Without memfd, an unlinked temporary file gives the same anonymous, fd-passable memory
+    errno = 0;
+    fd    = mkstemp(path);
+    if(fd < 0)
+    {
+        seterr(errno);
+        return -1;
+    }
+    unlink(path);
+#endif
+
+    errno = 0;
+    if(ftruncate(fd, (off_t)size) < 0)
+    {
+        seterr(errno);
+        close(fd);
+        return -2;
+    }
+
+    return fd;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const cache_entry_t *entry_a = (const cache_entry_t *)a;
+    const cache_entry_t *entry_b = (const cache_entry_t *)b;
+
+    if(entry_a->hash != entry_b->hash)
+    {
+        return entry_a->hash < entry_b->hash ? -1 : 1;
+    }
+
+    return strcmp((const char *)(sorted_base + entry_a->uri_offset), (const char *)(sorted_base + entry_b->uri_offset));
+}
+
+/*
+ * Most recently used first, then most hit, then smallest so that never used files fill the space that's left.
+ */
+static int compare_recency(const void *a, const void *b)
+{
+    const size_t        slot_a = *(const size_t *)a;
+    const size_t        slot_b = *(const size_t *)b;
+    const cache_stat_t *stat_a = &ranked_stats[slot_a];
+    const cache_stat_t *stat_b = &ranked_stats[slot_b];
+    const uint64_t      last_a = __atomic_load_n(&stat_a->last_access_ms, __ATOMIC_RELAXED);
+    const uint64_t      last_b = __atomic_load_n(&stat_b->last_access_ms, __ATOMIC_RELAXED);
+    const uint64_t      hits_a = __atomic_load_n(&stat_a->hits, __ATOMIC_RELAXED);
+    const uint64_t      hits_b = __atomic_load_n(&stat_b->hits, __ATOMIC_RELAXED);
+
+    if(last_a != last_b)
+    {
+        return last_a > last_b ? -1 : 1;
+    }
+
+    if(hits_a != hits_b)
+    {
+        return hits_a > hits_b ? -1 : 1;
+    }
+
+    if(ranked_files[slot_a].size != ranked_files[slot_b].size)
+    {
+        return ranked_files[slot_a].size < ranked_files[slot_b].size ? -1 : 1;
+    }
+
+    return 0;
+}
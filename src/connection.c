@@ -0,0 +1,1089 @@
+#include "connection.h"
+#include "utils.h"
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+    #include <sys/sendfile.h>
+#else
+    #define FILE_CHUNK_SIZE 16384    // Bounce buffer for file bodies without sendfile(2)
+#endif
+
+#define CONNECTION_READ_SIZE 4096
+#define CONNECTION_READ_BUDGET (16 * CONNECTION_READ_SIZE)    // Bytes read per call, the rest waits for the next one
+#define MAX_HEADERS_SIZE 16384
+#define INLINE_BODY_SIZE 65536    // Larger bodies are spooled to a file as they arrive instead of growing the input buffer
+#define OUTPUT_CHUNK_SIZE 16384    // Smallest buffer chunk, most responses fit in one
+#define OUTPUT_SPARE_SIZE (4 * OUTPUT_CHUNK_SIZE)    // Larger buffers are freed once flushed instead of being kept
+#define OUTPUT_MAX_BUFFERED (8 * OUTPUT_CHUNK_SIZE)    // Queued bytes held in memory before a connection stops taking responses
+#define OUTPUT_MAX_FILES 16                            // Queued file chunks before a connection stops taking responses, each holds an fd
+#define OUTPUT_DIRECT_SIZE 4096                        // Smaller writes are copied and coalesced, a syscall costs more than the copy
+
+// MSG_MORE is only a hint and the worker ignores SIGPIPE, platforms without them lose nothing
+#ifndef MSG_MORE
+    #define MSG_MORE 0
+#endif
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
+#endif
+
+static void                connection_reset(connection_t *conn);
+static void                reset_framing(connection_t *conn);
+static int                 parse_content_length(const char *headers, size_t len, size_t *content_length);
+static int                 spool_body(connection_t *conn, char *body, size_t available, int *err);
+static int                 create_spool_fd(int *err);
+static connection_chunk_t *chunk_push(connection_t *conn, char *data, int fd, size_t offset, size_t size, int *err);
+static connection_chunk_t *buffer_chunk(connection_t *conn, size_t size, int *err);
+static void                chunk_pop(connection_t *conn);
+static ssize_t             send_file_chunk(int sockfd, const connection_chunk_t *chunk);
+static size_t              write_direct(int sockfd, const struct iovec *iov, size_t iovcnt);
+static void                idle_list_unlink(connection_pool_t *pool, connection_t *conn);
+static void                idle_list_append(connection_pool_t *pool, connection_t *conn);
+
+int connection_pool_init(connection_pool_t *pool, size_t max_connections, int *err)
+{
+    seterr(0);
+    if(pool == NULL || max_connections < 1)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    errno             = 0;
+    pool->connections = (connection_t *)calloc(max_connections, sizeof(connection_t));
+    if(pool->connections == NULL)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    pool->max_connections = max_connections;
+    pool->nconnections    = 0;
+    pool->nopened         = 0;
+    pool->idle_head       = NULL;
+    pool->idle_tail       = NULL;
+
+    // Chain every slot into the free list, so opening and closing connections never has to scan the pool
+    pool->free_list = NULL;
+    for(size_t idx = max_connections; idx > 0; idx--)
+    {
+        connection_t *conn = &pool->connections[idx - 1];
+
+        connection_reset(conn);
+        conn->next_free = pool->free_list;
+        pool->free_list = conn;
+    }
+
+    return 0;
+}
+
+int connection_pool_destroy(connection_pool_t *pool, int *err)
+{
+    seterr(0);
+    if(pool == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    for(size_t idx = 0; idx < pool->max_connections; idx++)
+    {
+        connection_t *conn = &pool->connections[idx];
+
+        if(conn->state != CONNECTION_STATE_FREE)
+        {
+            connection_close(pool, conn, NULL);
+        }
+    }
+
+    free(pool->connections);
+    pool->connections  = NULL;
+    pool->free_list    = NULL;
+    pool->nconnections = 0;
+
+    return 0;
+}
+
+/*
+ * Takes a free slot for the fd and makes the fd non-blocking.
+ */
+connection_t *connection_open(connection_pool_t *pool, int fd, int *err)
+{
+    connection_t *conn;
+
+    seterr(0);
+    if(pool == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return NULL;
+    }
+
+    if(pool->free_list == NULL)
+    {
+        seterr(ENOSPC);
+        return NULL;
+    }
+
+    errno = 0;
+    if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        seterr(errno);
+        return NULL;
+    }
+
+    conn            = pool->free_list;
+    pool->free_list = conn->next_free;
+    pool->nconnections++;
+
+    conn->fd             = fd;
+    conn->id             = (++pool->nopened << 32) | (uint64_t)(conn - pool->connections);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    conn->state          = CONNECTION_STATE_READING;
+    conn->next_free      = NULL;
+    conn->last_active_ms = monotonic_ms();
+    idle_list_append(pool, conn);
+
+    return conn;
+}
+
+/*
+ * Closes the fd, frees the buffers and puts the slot back on the free list.
+ */
+int connection_close(connection_pool_t *pool, connection_t *conn, int *err)
+{
+    seterr(0);
+    if(pool == NULL || conn == NULL || conn->state == CONNECTION_STATE_FREE)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    idle_list_unlink(pool, conn);
+    close(conn->fd);
+    free(conn->inbuf);
+    reset_framing(conn);
+    while(conn->out_head)
+    {
+        chunk_pop(conn);
+    }
+    if(conn->spare)
+    {
+        free(conn->spare->data);
+        free(conn->spare);
+    }
+    connection_reset(conn);
+
+    conn->next_free = pool->free_list;
+    pool->free_list = conn;
+    pool->nconnections--;
+
+    return 0;
+}
+
+/*
+ * Marks the connection as active, moving it to the back of the idle list. Keeping the list ordered means the idle
+ * timeout only ever has to look at the front of the list.
+ */
+void connection_touch(connection_pool_t *pool, connection_t *conn)
+{
+    conn->last_active_ms = monotonic_ms();
+
+    if(pool->idle_tail != conn)
+    {
+        idle_list_unlink(pool, conn);
+        idle_list_append(pool, conn);
+    }
+}
+
+connection_t *connection_pool_oldest(const connection_pool_t *pool)
+{
+    return pool->idle_head;
+}
+
+/*
+ * Finds an open connection by id. The slot index is kept in the low half of the id, the rest tells a reused slot
+ * apart from the connection that was closed.
+ */
+connection_t *connection_find(connection_pool_t *pool, uint64_t id)
+{
+    size_t        slot = (size_t)(id & UINT32_MAX);
+    connection_t *conn;
+
+    if(slot >= pool->max_connections)
+    {
+        return NULL;
+    }
+
+    conn = &pool->connections[slot];
+    return conn->state != CONNECTION_STATE_FREE && conn->id == id ? conn : NULL;
+}
+
+/*
+ * Reads what is available on the connection into its input buffer, at most CONNECTION_READ_BUDGET bytes per call.
+ *
+ * The bytes of requests that have already been answered are dropped first, so the buffer only grows when a single
+ * request needs the room. `input_more` is set when the budget ran out before the socket was drained.
+ *
+ * Returns the number of bytes read by this call. Once the client shuts down, the connection is moved to the closing
+ * state, but the bytes read before that are still returned so that the requests already sent can be answered.
+ */
+ssize_t connection_read(connection_t *conn, int *err)
+{
+    ssize_t nread = 0;
+
+    seterr(0);
+    if(conn == NULL || conn->state == CONNECTION_STATE_FREE)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(conn->inbuf_handled > 0)
+    {
+        memmove(conn->inbuf, conn->inbuf + conn->inbuf_handled, conn->inbuf_len - conn->inbuf_handled);
+        conn->inbuf_len -= conn->inbuf_handled;
+        conn->inbuf_handled = 0;
+    }
+
+    conn->input_more = false;
+    while(true)
+    {
+        ssize_t tread;
+
+        if(nread >= CONNECTION_READ_BUDGET)
+        {
+            conn->input_more = true;
+            break;
+        }
+
+        // Make sure there is room for another read and the NUL terminator
+        if(conn->inbuf_size - conn->inbuf_len < CONNECTION_READ_SIZE + 1)
+        {
+            char  *tbuf;
+            size_t size = conn->inbuf_size == 0 ? CONNECTION_READ_SIZE + 1 : conn->inbuf_size * 2;
+
+            errno = 0;
+            tbuf  = (char *)realloc(conn->inbuf, size);
+            if(tbuf == NULL)
+            {
+                seterr(errno);
+                return -2;
+            }
+
+            conn->inbuf      = tbuf;
+            conn->inbuf_size = size;
+        }
+
+        errno = 0;
+        tread = read(conn->fd, conn->inbuf + conn->inbuf_len, CONNECTION_READ_SIZE);
+        if(tread < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            if(would_block(errno))
+            {
+                break;
+            }
+
+            seterr(errno);
+            return -3;
+        }
+
+        if(tread == 0)
+        {
+            conn->state = CONNECTION_STATE_CLOSING;
+            break;
+        }
+
+        conn->inbuf_len += (size_t)tread;
+        nread += tread;
+    }
+
+    conn->inbuf[conn->inbuf_len] = '\0';
+
+    return nread;
+}
+
+bool connection_has_input(const connection_t *conn)
+{
+    return conn->inbuf_len > conn->inbuf_handled;
+}
+
+/*
+ * Frames the first request that hasn't been answered yet.
+ *
+ * The end of the headers is searched for incrementally, so a request that trickles in is never scanned twice. Once
+ * the headers are complete, a body larger than INLINE_BODY_SIZE is moved out of the input buffer into a spool file
+ * as it arrives, smaller bodies stay behind the headers.
+ *
+ * A body larger than `max_body_size` is refused from the headers alone, before any of it is read.
+ *
+ * Returns 1 once the request is complete, 0 if more input is needed, -2 if its headers are too large, -3 if its
+ * Content-Length is invalid, -4 if its body can't be spooled or -5 if its body is too large.
+ */
+int connection_next_request(connection_t *conn, connection_request_t *request, size_t max_body_size, int *err)
+{
+    char  *start;
+    size_t available;
+
+    seterr(0);
+    if(conn == NULL || request == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    start     = conn->inbuf + conn->inbuf_handled;
+    available = conn->inbuf_len - conn->inbuf_handled;
+
+    if(conn->headers_len == 0)
+    {
+        // The terminator can straddle what was scanned before and what has arrived since
+        size_t      from = conn->scanned > 3 ? conn->scanned - 3 : 0;
+        const char *end  = available > from ? (const char *)memmem(start + from, available - from, "\r\n\r\n", 4) : NULL;
+
+        if(end == NULL)
+        {
+            conn->scanned = available;
+            if(available > MAX_HEADERS_SIZE)
+            {
+                seterr(EMSGSIZE);
+                return -2;
+            }
+            return 0;
+        }
+
+        conn->headers_len = (size_t)(end - start) + 4;
+        if(conn->headers_len > MAX_HEADERS_SIZE)
+        {
+            seterr(EMSGSIZE);
+            return -2;
+        }
+
+        if(parse_content_length(start, conn->headers_len, &conn->body_len) < 0)
+        {
+            seterr(EINVAL);
+            return -3;
+        }
+
+        if(conn->body_len > max_body_size)
+        {
+            seterr(EFBIG);
+            return -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        }
+
+        if(conn->body_len > INLINE_BODY_SIZE)
+        {
+            conn->spool_fd = create_spool_fd(err);
+            if(conn->spool_fd < 0)
+            {
+                return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            }
+        }
+    }
+
+    if(conn->spool_fd > -1)
+    {
+        if(spool_body(conn, start + conn->headers_len, available - conn->headers_len, err) < 0)
+        {
+            return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        }
+
+        if(conn->spooled < conn->body_len)
+        {
+            return 0;
+        }
+
+        request->data     = start;
+        request->len      = conn->headers_len;
+        request->body_fd  = conn->spool_fd;
+        request->body_len = conn->body_len;
+        return 1;
+    }
+
+    if(available < conn->headers_len + conn->body_len)
+    {
+        return 0;
+    }
+
+    request->data     = start;
+    request->len      = conn->headers_len + conn->body_len;
+    request->body_fd  = -1;
+    request->body_len = conn->body_len;
+    return 1;
+}
+
+/*
+ * Drops a request returned by `connection_next_request` once it has been answered, along with its spooled body.
+ */
+void connection_finish_request(connection_t *conn, const connection_request_t *request)
+{
+    conn->inbuf_handled += request->len;
+    reset_framing(conn);
+}
+
+/*
+ * Drops everything that was received and not answered, for connections that won't answer another request.
+ */
+void connection_discard_input(connection_t *conn)
+{
+    conn->inbuf_handled = conn->inbuf_len;
+    reset_framing(conn);
+}
+
+/*
+ * Drops `size` bytes of handled input, for connections that carry their own framing instead of HTTP requests.
+ */
+void connection_skip_input(connection_t *conn, size_t size)
+{
+    conn->inbuf_handled += size;
+}
+
+/*
+ * Copies data to the output queue.
+ *
+ * Consecutive writes share one buffer, so pipelined responses still go out with a single write. Once the queue has
+ * been flushed, its buffer is kept for the next response instead of being freed.
+ */
+int connection_write(connection_t *conn, const void *data, size_t size, int *err)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *)(uintptr_t)data;
+    iov.iov_len  = size;
+
+    return connection_writev(conn, &iov, 1, err);
+}
+
+/*
+ * Queues a list of pieces for output, the buffer only grows once for all of them.
+ *
+ * When nothing is queued or held ahead of them, large writes go straight to the socket from the caller's buffers with writev(2)
+ * and only the part the socket doesn't take is copied. Either way the caller's buffers can be reused once this returns.
+ */
+int connection_writev(connection_t *conn, const struct iovec *iov, size_t iovcnt, int *err)
+{
+    connection_chunk_t *tail;
+    size_t              size = 0;
+    size_t              skip = 0;    // Leading bytes that have already been written
+
+    seterr(0);
+    if(conn == NULL || (iov == NULL && iovcnt > 0))
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    for(size_t idx = 0; idx < iovcnt; idx++)
+    {
+        if(iov[idx].iov_base == NULL && iov[idx].iov_len > 0)
+        {
+            seterr(EINVAL);
+            return -1;
+        }
+        size += iov[idx].iov_len;
+    }
+
+    // A held response waits for its insert to be committed, it can't go out yet
+    if(conn->out_head == NULL && conn->uncommitted == 0 && size >= OUTPUT_DIRECT_SIZE)
+    {
+        skip = write_direct(conn->fd, iov, iovcnt);
+        size -= skip;
+        if(size == 0)
+        {
+            return 0;
+        }
+    }
+
+    tail = conn->out_tail;
+    if(tail == NULL || tail->fd > -1)
+    {
+        tail = buffer_chunk(conn, size, err);
+        if(tail == NULL)
+        {
+            return -2;
+        }
+    }
+
+    // Grow the buffer geometrically when the response doesn't fit
+    if(tail->capacity - tail->len < size)
+    {
+        char  *tbuf;
+        size_t capacity = tail->capacity * 2 > tail->len + size ? tail->capacity * 2 : tail->len + size;
+
+        errno = 0;
+        tbuf  = (char *)realloc(tail->data, capacity);
+        if(tbuf == NULL)
+        {
+            seterr(errno);
+            return -3;
+        }
+
+        tail->data     = tbuf;
+        tail->capacity = capacity;
+    }
+
+    for(size_t idx = 0; idx < iovcnt; idx++)
+    {
+        size_t len = iov[idx].iov_len;
+
+        if(skip >= len)
+        {
+            skip -= len;
+            continue;
+        }
+
+        memcpy(tail->data + tail->len, (const char *)iov[idx].iov_base + skip, len - skip);
+        tail->len += len - skip;
+        skip = 0;
+    }
+    conn->out_pending += size;
+    conn->out_buffered += size;
+
+    return 0;
+}
+
+/*
+ * Appends `size` bytes of a file, starting at `offset`, to the output queue. The connection takes ownership of the fd.
+ */
+int connection_queue_file(connection_t *conn, int fd, size_t offset, size_t size, int *err)
+{
+    seterr(0);
+    if(conn == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(chunk_push(conn, NULL, fd, offset, size, err) == NULL)
+    {
+        close(fd);
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * Drops everything queued past the first `size` bytes, the chunk they end in is cut short. Nothing of the queue may
+ * have been written since `size` was taken.
+ */
+void connection_truncate_output(connection_t *conn, size_t size)
+{
+    connection_chunk_t *chunk = conn->out_head;
+    connection_chunk_t *last  = NULL;
+
+    while(chunk != NULL && size > 0)
+    {
+        size_t len = chunk->len - chunk->offset;
+
+        if(size < len)
+        {
+            conn->out_pending -= len - size;
+            if(chunk->fd < 0)
+            {
+                conn->out_buffered -= len - size;
+            }
+            chunk->len = chunk->offset + size;
+            len        = size;
+        }
+
+        size -= len;
+        last  = chunk;
+        chunk = chunk->next;
+    }
+
+    if(last)
+    {
+        last->next = NULL;
+    }
+    else
+    {
+        conn->out_head = NULL;
+    }
+    conn->out_tail = last;
+
+    while(chunk != NULL)
+    {
+        connection_chunk_t *next = chunk->next;
+
+        conn->out_pending -= chunk->len - chunk->offset;
+        if(chunk->fd > -1)
+        {
+            close(chunk->fd);
+            conn->out_files--;
+        }
+        else
+        {
+            conn->out_buffered -= chunk->len - chunk->offset;
+            free(chunk->data);
+        }
+
+        free(chunk);
+        chunk = next;
+    }
+}
+
+/*
+ * Writes as much of the output queue as the socket accepts.
+ *
+ * Returns the number of bytes still waiting to be written.
+ */
+ssize_t connection_flush(connection_t *conn, int *err)
+{
+    seterr(0);
+    if(conn == NULL || conn->state == CONNECTION_STATE_FREE)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    while(conn->out_head)
+    {
+        connection_chunk_t *chunk = conn->out_head;
+        ssize_t             nwritten;
+
+        if(chunk->offset == chunk->len)
+        {
+            chunk_pop(conn);
+            continue;
+        }
+
+        errno = 0;
+        if(chunk->fd > -1)
+        {
+            nwritten = send_file_chunk(conn->fd, chunk);
+        }
+        else
+        {
+            // Hold back a partial packet when more output follows, so headers and a file body share packets
+            nwritten = send(conn->fd, chunk->data + chunk->offset, chunk->len - chunk->offset, MSG_NOSIGNAL | (chunk->next ? MSG_MORE : 0));
+        }
+
+        if(nwritten < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            if(would_block(errno))
+            {
+                break;
+            }
+
+            seterr(errno);
+            return -2;
+        }
+
+        chunk->offset += (size_t)nwritten;
+        conn->out_pending -= (size_t)nwritten;
+        if(chunk->fd < 0)
+        {
+            conn->out_buffered -= (size_t)nwritten;
+        }
+    }
+
+    return (ssize_t)conn->out_pending;
+}
+
+bool connection_has_output(const connection_t *conn)
+{
+    return conn->out_head != NULL;
+}
+
+/*
+ * Whether the output queue holds as much as a connection is allowed to, no more responses should be added until some
+ * of it has been written. A single response is always taken whole, so the queue can end up past the limits.
+ */
+bool connection_output_full(const connection_t *conn)
+{
+    return conn->out_buffered >= OUTPUT_MAX_BUFFERED || conn->out_files >= OUTPUT_MAX_FILES;
+}
+
+static connection_chunk_t *chunk_push(connection_t *conn, char *data, int fd, size_t offset, size_t size, int *err)
+{
+    connection_chunk_t *chunk;
+
+    errno = 0;
+    chunk = (connection_chunk_t *)malloc(sizeof(connection_chunk_t));
+    if(chunk == NULL)
+    {
+        seterr(errno);
+        return NULL;
+    }
+
+    chunk->data     = data;
+    chunk->fd       = fd;
+    chunk->offset   = offset;
+    chunk->len      = offset + size;
+    chunk->capacity = data ? size : 0;
+    chunk->next     = NULL;
+
+    if(conn->out_tail)
+    {
+        conn->out_tail->next = chunk;
+    }
+    else
+    {
+        conn->out_head = chunk;
+    }
+
+    conn->out_tail = chunk;
+    conn->out_pending += size;
+    if(fd > -1)
+    {
+        conn->out_files++;
+    }
+
+    return chunk;
+}
+
+static void chunk_pop(connection_t *conn)
+{
+    connection_chunk_t *chunk = conn->out_head;
+
+    conn->out_head = chunk->next;
+    if(conn->out_head == NULL)
+    {
+        conn->out_tail = NULL;
+    }
+
+    conn->out_pending -= chunk->len - chunk->offset;
+
+    if(chunk->fd > -1)
+    {
+        close(chunk->fd);
+        conn->out_files--;
+    }
+    else
+    {
+        conn->out_buffered -= chunk->len - chunk->offset;
+    }
+
+    // Keep one buffer around for the next response
+    if(chunk->fd < 0 && conn->spare == NULL && chunk->capacity <= OUTPUT_SPARE_SIZE)
+    {
+        conn->spare = chunk;
+        return;
+    }
+
+    free(chunk->data);
+    free(chunk);
+}
+
+/*
+ * Appends an empty buffer chunk with room for at least `size` bytes, reusing the spare buffer when there is one.
+ */
+static connection_chunk_t *buffer_chunk(connection_t *conn, size_t size, int *err)
+{
+    connection_chunk_t *chunk = conn->spare;
+    char               *data;
+
+    if(chunk)
+    {
+        conn->spare   = NULL;
+        chunk->offset = 0;
+        chunk->len    = 0;
+        chunk->next   = NULL;
+
+        if(conn->out_tail)
+        {
+            conn->out_tail->next = chunk;
+        }
+        else
+        {
+            conn->out_head = chunk;
+        }
+        conn->out_tail = chunk;
+
+        return chunk;
+    }
+
+    size = size > OUTPUT_CHUNK_SIZE ? size : OUTPUT_CHUNK_SIZE;
+
+    errno = 0;
+    data  = (char *)malloc(size);
+    if(data == NULL)
+    {
+        seterr(errno);
+        return NULL;
+    }
+
+    chunk = chunk_push(conn, data, -1, 0, 0, err);
+    if(chunk == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    chunk->capacity = size;
+
+    return chunk;
+}
+
+/*
+ * Writes what the socket takes at once. Errors are left for the next flush of the queued remainder to report.
+ */
+static size_t write_direct(int sockfd, const struct iovec *iov, size_t iovcnt)
+{
+    ssize_t nwritten;
+
+    if(iovcnt > IOV_MAX)
+    {
+        return 0;
+    }
+
+    do
+    {
+        errno    = 0;
+        nwritten = writev(sockfd, iov, (int)iovcnt);
+    } while(nwritten < 0 && errno == EINTR);
+
+    return nwritten > 0 ? (size_t)nwritten : 0;
+}
+
+/*
+ * Sends the rest of a file chunk. On Linux the file is copied to the socket by the kernel, elsewhere it is read
+ * through a small bounce buffer.
+ */
+static ssize_t send_file_chunk(int sockfd, const connection_chunk_t *chunk)
+{
+    size_t  remaining = chunk->len - chunk->offset;
+    ssize_t nsent;
+
+#ifdef __linux__
+    off_t offset = (off_t)chunk->offset;
+
+    nsent = sendfile(sockfd, chunk->fd, &offset, remaining);
+#else
+    char    buf[FILE_CHUNK_SIZE];
+    ssize_t nread;
+
+    nread = pread(chunk->fd, buf, remaining < sizeof(buf) ? remaining : sizeof(buf), (off_t)chunk->offset);
+    if(nread <= 0)
+    {
+        errno = nread == 0 ? EIO : errno;
+        return -1;
+    }
+
+    nsent = send(sockfd, buf, (size_t)nread, MSG_NOSIGNAL);
+#endif
+
+    // The file has shrunk since its size was taken, the response can't be completed
+    if(nsent == 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    return nsent;
+}
+
+static void connection_reset(connection_t *conn)
+{
+    conn->fd             = -1;
+    conn->id             = 0;
+    conn->state          = CONNECTION_STATE_FREE;
+    conn->events         = 0;
+    conn->inbuf          = NULL;
+    conn->inbuf_len      = 0;
+    conn->inbuf_size     = 0;
+    conn->inbuf_handled  = 0;
+    conn->input_more     = false;
+    conn->scanned        = 0;
+    conn->headers_len    = 0;
+    conn->body_len       = 0;
+    conn->spool_fd       = -1;
+    conn->spooled        = 0;
+    conn->out_head       = NULL;
+    conn->out_tail       = NULL;
+    conn->out_pending    = 0;
+    conn->out_buffered   = 0;
+    conn->out_files      = 0;
+    conn->spare          = NULL;
+    conn->keep_alive     = true;
+    conn->uncommitted    = 0;
+    conn->held_output    = 0;
+    conn->commit_failed  = false;
+    conn->nrequests      = 0;
+    conn->last_active_ms = 0;
+    conn->next_free      = NULL;
+    conn->idle_prev      = NULL;
+    conn->idle_next      = NULL;
+}
+
+static void reset_framing(connection_t *conn)
+{
+    if(conn->spool_fd > -1)
+    {
+        close(conn->spool_fd);
+    }
+
+    conn->scanned     = 0;
+    conn->headers_len = 0;
+    conn->body_len    = 0;
+    conn->spool_fd    = -1;
+    conn->spooled     = 0;
+}
+
+/*
+ * Finds the Content-Length among the headers, 0 when there is none. Anything but digits, or two different lengths,
+ * is rejected so that nobody along the way can frame the body differently.
+ */
+static int parse_content_length(const char *headers, size_t len, size_t *content_length)
+{
+    static const char name[] = "Content-Length:";
+    const char       *end    = headers + len;
+    const char       *line;
+    bool              found = false;
+
+    *content_length = 0;
+
+    // Every header line starts right after a LF, which also skips the request line
+    line = (const char *)memchr(headers, '\n', len);
+    while(line != NULL && (size_t)(end - line) > sizeof(name))
+    {
+        const char *value  = line + 1;
+        size_t      length = 0;
+        bool        digits = false;
+
+        line = (const char *)memchr(value, '\n', (size_t)(end - value));
+        if(strncasecmp(value, name, sizeof(name) - 1) != 0)
+        {
+            continue;
+        }
+
+        for(value += sizeof(name) - 1; *value == ' ' || *value == '\t'; value++)
+        {
+        }
+
+        for(; *value >= '0' && *value <= '9'; value++)
+        {
+            if(length > (SIZE_MAX - 9) / 10)    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            {
+                return -1;
+            }
+            length = (length * 10) + (size_t)(*value - '0');    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            digits = true;
+        }
+
+        for(; *value == ' ' || *value == '\t'; value++)
+        {
+        }
+
+        if(!digits || *value != '\r' || (found && length != *content_length))
+        {
+            return -2;
+        }
+
+        *content_length = length;
+        found           = true;
+    }
+
+    return 0;
+}
+
+/*
+ * Moves the body bytes that follow the headers into the spool file. Anything past the body, the start of a pipelined
+ * request, is kept in the input buffer right behind the headers.
+ */
+static int spool_body(connection_t *conn, char *body, size_t available, int *err)
+{
+    size_t take = conn->body_len - conn->spooled < available ? conn->body_len - conn->spooled : available;
+
+    for(size_t written = 0; written < take;)
+    {
+        ssize_t nwritten;
+
+        errno    = 0;
+        nwritten = write(conn->spool_fd, body + written, take - written);
+        if(nwritten < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            seterr(errno);
+            return -1;
+        }
+        written += (size_t)nwritten;
+    }
+
+    memmove(body, body + take, available - take + 1);    // +1 for the NUL terminator
+    conn->inbuf_len -= take;
+    conn->spooled += take;
+
+    return 0;
+}
+
+/*
+ * Spooled bodies go to an unlinked temporary file, so they are backed by the disk instead of the worker's memory.
+ */
+static int create_spool_fd(int *err)
+{
+    char path[] = "/tmp/http-body-XXXXXX";
+    int  fd;
+
+    errno = 0;
+    fd    = mkstemp(path);
+    if(fd < 0)
+    {
+        seterr(errno);
+        return -1;
+    }
+    unlink(path);
+
+    return fd;
+}
+
+static void idle_list_unlink(connection_pool_t *pool, connection_t *conn)
+{
+    if(conn->idle_prev)
+    {
+        conn->idle_prev->idle_next = conn->idle_next;
+    }
+    else
+    {
+        pool->idle_head = conn->idle_next;
+    }
+
+    if(conn->idle_next)
+    {
+        conn->idle_next->idle_prev = conn->idle_prev;
+    }
+    else
+    {
+        pool->idle_tail = conn->idle_prev;
+    }
+
+    conn->idle_prev = NULL;
+    conn->idle_next = NULL;
+}
+
+static void idle_list_append(connection_pool_t *pool, connection_t *conn)
+{
+    conn->idle_prev = pool->idle_tail;
+    conn->idle_next = NULL;
+
+    if(pool->idle_tail)
+    {
+        pool->idle_tail->idle_next = conn;
+    }
+    else
+    {
+        pool->idle_head = conn;
+    }
+
+    pool->idle_tail = conn;
+}
@@ -1,4 +1,5 @@
 #include "handlers.h"
+#include "cache.h"
 #include "http/http-info.h"
 #include "io.h"
 #include "loader.h"
@@ -9,20 +10,22 @@
 #include "utils.h"
 #include "worker.h"
 #include <arpa/inet.h>
-#include <dlfcn.h>
 #include <errno.h>
 #include <netinet/in.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
-#define BUFLEN 1024
+#define RECORD_HEADERS_SIZE 128
+#define CACHE_INLINE_BODY_SIZE 16384    // Cached bodies up to this size are copied into the response, larger ones are sent from the snapshot
 
-void handle_client_connect(int sockfd, app_state_t *app, const char *libhttp_filepath)
+void handle_client_connect(int sockfd, app_state_t *app)
 {
     int err;
 
@@ -31,192 +34,565 @@ void handle_client_connect(int sockfd, app_state_t *app, const char *libhttp_fil
 
     log_debug("\n%sFD ? -> Server | Connect:%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
 
-    // Defer connection handling if we're at max clients
-    if(app->nworkers == app->max_clients)
+    // The server socket is non-blocking, keep accepting until the backlog is drained (required when edge-triggered)
+    while(true)
     {
-        return;
+        // Find the least loaded worker -- If every worker is full, backlog the client until a connection closes
+        worker = app_find_available_worker(app, NULL);
+        if(worker == NULL)
+        {
+            app_pause_accepting(app, NULL);
+            return;
+        }
+
+        // Accept the client connection
+        err = 0;
+        if(tcp_accept(sockfd, &client, &err) < 0)
+        {
+            if(err != EINTR && !would_block(err))
+            {
+                log_error("handle_client_connect::tcp_accept: %s\n", strerror(err));
+            }
+
+            return;
+        }
+
+        log_info("[fd:%d] \"%s:%d\" connect -> Worker[PID:%d]\n", client.fd, client.address, client.port, worker->pid);
+
+        // Assign client to the worker
+        err = 0;
+        if(assign_client_to_worker(worker, &client, &err) < 0)
+        {
+            if(err == EBUSY)
+            {
+                log_error("handle_client_connect::assign_client_to_worker: Worker [PID:%d/FD:%d] is at its connection limit.\n", worker->pid, worker->fd);
+            }
+            else
+            {
+                log_error("handle_client_connect::assign_client_to_worker: %s\n", strerror(err));
+            }
+
+            close(client.fd);
+            continue;
+        }
+
+        // Hand the client to the worker, the worker now owns the connection
+        err = 0;
+        if(send_fd(worker->fd, client.fd, WORKER_MESSAGE_CLIENT, &err) < 0)
+        {
+            log_error("handle_client_connect::send_fd: %s\n", strerror(err));
+            worker->nconnections--;
+        }
+
+        close(client.fd);
+    }
+}
+
+/*
+ * Queues a canned response and stops reading from the connection.
+ */
+static void queue_error(connection_t *conn, const char *response)
+{
+    conn->keep_alive = false;
+
+    if(connection_write(conn, response, strlen(response), NULL) < 0)
+    {
+        log_error("handle_client_data::connection_write: Failed to queue response [FD:%d].\n", conn->fd);
+    }
+}
+
+/*
+ * Answers a GET or HEAD request from the shared static file cache, without touching the file system.
+ *
+ * Returns 0 if the response has been queued, -1 if the request has to go through the HTTP library.
+ */
+static int serve_cached(connection_t *conn, const cache_t *cache, const http_request_view_t *view, bool keep_alive)
+{
+    const cache_entry_t *entry;
+    const char          *version;
+    const char          *connection;
+    const char          *headers;
+    const char          *body;
+    struct iovec         iov[4];    // Status line, header block, connection line and body
+    http_slice_t         uri       = view->request_uri;
+    size_t               body_size = 0;
+
+    if((view->method != HTTP_METHOD_GET && view->method != HTTP_METHOD_HEAD) || view->http_version == HTTP_VERSION_UNKNOWN)
+    {
+        return -1;
     }
 
-    if(reload_library(libhttp_filepath) < 0)
+    // Default a missing URI to the homepage, like the HTTP library does
+    if(uri.len == 0 || (uri.len == 1 && uri.data[0] == '/'))
     {
-        log_error("handle_client_connect::reload_library: %s\n", dlerror());
+        uri = (http_slice_t){"/index.html", strlen("/index.html")};
     }
 
-    // Find an available worker -- If none, backlog the client until space is freed
-    worker = app_find_available_worker(app, NULL);
-    if(worker == NULL)
+    entry = cache_lookup(cache, uri.data, uri.len);
+    if(entry == NULL)
     {
-        return;
+        return -1;
+    }
+
+    // Files left out of the snapshot are still counted, so they can make it into the next one
+    cache_record_hit(cache, entry, monotonic_ms());
+    if(!entry->cached)
+    {
+        return -1;
+    }
+
+    if(view->method == HTTP_METHOD_GET && entry->body_len <= CACHE_INLINE_BODY_SIZE)
+    {
+        body_size = (size_t)entry->body_len;
+    }
+
+    version    = view->http_version == HTTP_VERSION_11 ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.0 200 OK\r\n";
+    connection = keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    headers    = cache_entry_headers(cache, entry);
+    body       = cache_entry_body(cache, entry);
+
+    log_info("[FD:%d] %.*s (cached)\n", conn->fd, (int)uri.len, uri.data);
+
+    // The header block was rendered when the snapshot was built, only the status and connection lines are added
+    conn->keep_alive = keep_alive;
+    iov[0].iov_base = (void *)(uintptr_t)version;
+    iov[0].iov_len  = strlen(version);
+    iov[1].iov_base = (void *)(uintptr_t)headers;
+    iov[1].iov_len  = entry->headers_len;
+    iov[2].iov_base = (void *)(uintptr_t)connection;
+    iov[2].iov_len  = strlen(connection);
+    iov[3].iov_base = (void *)(uintptr_t)body;
+    iov[3].iov_len  = body_size;
+
+    if(connection_writev(conn, iov, arrlen(iov), NULL) < 0)
+    {
+        log_error("handle_client_data::connection_write: Failed to queue response [FD:%d].\n", conn->fd);
+        conn->keep_alive = false;
+        return 0;
     }
 
-    // Accept the client connection
-    err = 0;
-    if(tcp_accept(sockfd, &client, &err) < 0)
+    // Large bodies are sent straight from the snapshot, the duplicate fd keeps it alive if a new one replaces it
+    if(view->method == HTTP_METHOD_GET && body_size < entry->body_len)
     {
-        if(err != EINTR)
+        int body_fd = dup(cache->fd);
+
+        if(body_fd < 0 || connection_queue_file(conn, body_fd, (size_t)entry->body_offset, (size_t)entry->body_len, NULL) < 0)
         {
-            log_error("handle_client_connect::tcp_accept: %s\n", strerror(errno));
+            log_error("handle_client_data::connection_queue_file: Failed to queue response body [FD:%d].\n", conn->fd);
+            conn->keep_alive = false;
         }
+    }
 
-        return;
+    return 0;
+}
+
+/*
+ * Answers a GET or HEAD request under the database prefix with the record POSTed to the rest of its URI, from the
+ * worker's record cache when it is there. The value is copied once, from the cache or the store's reply straight into
+ * the output queue.
+ *
+ * Returns 0 if the response has been queued, -1 if the request isn't for a record.
+ */
+static int serve_record(connection_t *conn, const handler_context_t *ctx, const http_request_view_t *view, bool keep_alive)
+{
+    const char    *prefix     = ctx->config->db_prefix;
+    size_t         prefix_len = strlen(prefix);
+    http_slice_t   uri        = view->request_uri;
+    char          *key;
+    const uint8_t *value     = NULL;
+    size_t         value_len = 0;
+    char           headers[RECORD_HEADERS_SIZE];
+    int            headers_len;
+    struct iovec   iov[2];    // Headers and value
+    int            found;
+    int            err;
+
+    if((view->method != HTTP_METHOD_GET && view->method != HTTP_METHOD_HEAD) || view->http_version == HTTP_VERSION_UNKNOWN)
+    {
+        return -1;
+    }
+
+    // "/db" and "/db/" are the same prefix, the key keeps its leading slash so it matches the URI it was POSTed to
+    if(prefix[prefix_len - 1] == '/')
+    {
+        prefix_len--;
+    }
+
+    if(uri.len <= prefix_len + 1 || strncmp(uri.data, prefix, prefix_len) != 0 || uri.data[prefix_len] != '/')
+    {
+        return -1;
+    }
+
+    key = arena_strndup(ctx->arena, uri.data + prefix_len, uri.len - prefix_len);
+    if(key == NULL)
+    {
+        queue_error(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return 0;
     }
 
-    log_info("[fd:%d] \"%s:%d\" connect\n", client.fd, client.address, client.port);
+    // The snapshot answers on its own while nothing has been committed since it was taken, including that there is no
+    // such record. No record can have a key longer than the store takes.
+    found = uri.len - prefix_len > STORE_MAX_KEY_SIZE ? 0 : db_snapshot_lookup(ctx->snapshot, db_cache_generation(ctx->db_cache), key, &value, &value_len);
+    if(found < 0)
+    {
+        value = db_cache_lookup(ctx->db_cache, key, &value_len);
+    }
 
-    // Assign client to the worker
-    err = 0;
-    if(assign_client_to_worker(worker, &client, &err) < 0)
+    if(found < 0 && value == NULL)
     {
-        if(err == EBUSY)
+        err   = 0;
+        value = store_fetch(ctx->store, key, &value_len, &err);
+        if(value == NULL && err != ENOENT)
         {
-            log_error("handle_client_connect::assign_client_to_worker: Worker [PID:%d/FD:%d] already has an active client.\n", worker->pid, worker->fd);
-            close(client.fd);
+            log_error("handle_client_data::store_fetch: %s\n", strerror(err));
+            queue_error(conn, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return 0;
         }
-        else
+
+        if(value)
         {
-            log_error("handle_client_connect::assign_client_to_worker: %s\n", strerror(err));
+            db_cache_store(ctx->db_cache, key, value, value_len);
         }
+    }
 
-        return;
+    log_info("[FD:%d] %s (record%s)\n", conn->fd, key, value ? "" : " missing");
+
+    if(value)
+    {
+        headers_len = snprintf(headers, sizeof(headers), "%s 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n", view->http_version == HTTP_VERSION_11 ? "HTTP/1.1" : "HTTP/1.0", value_len, keep_alive ? "keep-alive" : "close");
+    }
+    else
+    {
+        headers_len = snprintf(headers, sizeof(headers), "%s 404 Not Found\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n", view->http_version == HTTP_VERSION_11 ? "HTTP/1.1" : "HTTP/1.0", keep_alive ? "keep-alive" : "close");
     }
 
-    // Scale up workers
-    app_set_desired_workers(app, app->desired_workers + 1, NULL);
+    conn->keep_alive = keep_alive;
+    iov[0].iov_base  = headers;
+    iov[0].iov_len   = (size_t)headers_len;
+    iov[1].iov_base  = (void *)(uintptr_t)value;
+    iov[1].iov_len   = value && view->method == HTTP_METHOD_GET ? value_len : 0;
+
+    if(connection_writev(conn, iov, arrlen(iov), NULL) < 0)
+    {
+        log_error("handle_client_data::connection_write: Failed to queue response [FD:%d].\n", conn->fd);
+        conn->keep_alive = false;
+    }
+
+    return 0;
 }
 
-ssize_t handle_client_data(int connfd, DBM *db, const char *public_dir)
+/*
+ * Answers a single request of `len` bytes and queues the response behind any earlier ones.
+ *
+ * The request is parsed into a view of the input buffer first, cache hits are answered from the view alone. It is only
+ * copied into an owned request when it has to go through the HTTP library.
+ */
+static void answer_request(connection_t *conn, const char *data, size_t len, const http_slice_t *body, const handler_context_t *ctx, const http_library_t *http)
 {
-    char   *buf;
-    ssize_t nread;
+    struct iovec response_iov[HTTP_RESPONSE_IOVECS];
+    size_t       response_iovcnt = arrlen(response_iov);
+    ssize_t      response_size;
+    bool         keep_alive;
+    http_slice_t request_body;
+    int          err;
 
-    // uint8_t *response;
-    char   *response_buf;
-    ssize_t response_size = 0;
+    http_request_view_t view;
+    http_request_t      request;
+    http_response_t     response;
 
-    http_request_t  request;
-    http_response_t response;
+    // Report the incoming data
+    log_debug("\n%sFD %d -> Server | Request:%s\n", ANSI_COLOR_YELLOW, conn->fd, ANSI_COLOR_RESET);
+    log_debug("%.*s\n", (int)len, data);    // print the data sent to us
 
-    nread = read_string(connfd, &buf, BUFLEN, NULL);
-    if(nread < 0)
+    // Do response stuff
+    http->request_init(&request, ctx->config->public_dir, ctx->arena, NULL);
+    memset(&response, 0, sizeof(http_response_t));
+    response.body_fd = -1;
+    if(http->request_view_parse(&view, data, len, ctx->config->strict_parser ? HTTP_PARSER_STRICT : HTTP_PARSER_FAST, NULL) < 0)
     {
-        strhcpy(&response_buf, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
-        response_size = (ssize_t)strlen(response_buf);
-        goto write;
+        goto internal_server_error;
     }
 
-    if(nread == 0)
+    // The body is stored straight from the input buffer or the spool file, the library never needs a copy of it
+    request_body = body ? *body : view.body;
+    view.body    = (http_slice_t){NULL, 0};
+
+    // Keep the connection open if the client asked for it and it hasn't used up its requests
+    conn->nrequests++;
+    keep_alive = view.keep_alive && conn->state == CONNECTION_STATE_READING && conn->nrequests < ctx->config->max_requests;
+
+    if(serve_record(conn, ctx, &view, keep_alive) == 0 || (ctx->cache && serve_cached(conn, ctx->cache, &view, keep_alive) == 0))
     {
-        free(buf);
-        return 0;    // Client Disconnected
+        http->request_destroy(&request, NULL);
+        return;
     }
 
-    // Report the incoming data
-    log_debug("\n%sFD %d -> Server | Request:%s\n", ANSI_COLOR_YELLOW, connfd, ANSI_COLOR_RESET);
-    log_debug("%s\n", buf);    // print the data sent to us
-
-    // Do response stuff
-    request_init(&request, public_dir, NULL);
-    if(request_parse(&request, buf, NULL) < 0)
+    // Records are keyed by their URI, the store doesn't take keys that long
+    if(view.method == HTTP_METHOD_POST && request_body.len > 0 && view.request_uri.len > STORE_MAX_KEY_SIZE)
     {
-        goto internal_server_error;
+        http->request_destroy(&request, NULL);
+        queue_error(conn, "HTTP/1.1 414 URI Too Long\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return;
     }
 
-    if(request_process(&request, &response, NULL) < 0)
+    if(http->request_from_view(&request, &view, NULL) < 0 || http->request_process(&request, &response, NULL) < 0)
     {
         goto internal_server_error;
     }
 
-    log_info("[FD:%d] %s\n", connfd, request.request_uri);
+    // Set after processing, the handlers start the response over
+    response.keep_alive = keep_alive;
+
+    log_info("[FD:%d] %s\n", conn->fd, request.request_uri);
 
-    if(request.method == HTTP_METHOD_POST && request.body_size > 0 && db_insert(db, request.request_uri, request.body, request.body_size, NULL) < 0)
+    // The response is held back until the store has committed the record
+    if(request.method == HTTP_METHOD_POST && request_body.len > 0)
     {
-        log_error("handle_client_data::db_insert: Failed to insert record at route (%s)\n", request.request_uri);
+        err = 0;
+        if(store_insert(ctx->store, request.request_uri, (const uint8_t *)request_body.data, request_body.len, conn->id, &err) < 0)
+        {
+            log_error("handle_client_data::store_insert: Failed to insert record at route (%s): %s\n", request.request_uri, strerror(err));
+            http->request_destroy(&request, NULL);
+            http->response_destroy(&response, NULL);
+            queue_error(conn, "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return;
+        }
+
+        // The responses queued so far answer earlier requests, they go out whatever happens to the record
+        conn->held_output = conn->out_pending;
+        conn->uncommitted++;
     }
 
     response.http_version = request.http_version;
-    response_size         = response_write(&response, &request, &response_buf, NULL);
+    response_size         = http->response_write(&response, &request, response_iov, &response_iovcnt, NULL);
     if(response_size < 0)
     {
     internal_server_error:
-        strhcpy(&response_buf, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
-        response_size = (ssize_t)strlen(response_buf);
+        http->request_destroy(&request, NULL);
+        http->response_destroy(&response, NULL);
+        queue_error(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        return;
     }
 
-write:
     // Report the outgoing data
-    log_debug("\n%sServer -> FD %d | Response:%s\n", ANSI_COLOR_YELLOW, connfd, ANSI_COLOR_RESET);    // Should only print if the client hasn't disconnected
-    log_debug("%s\n", response_buf);
+    log_debug("\n%sServer -> FD %d | Response:%s\n", ANSI_COLOR_YELLOW, conn->fd, ANSI_COLOR_RESET);
+    for(size_t idx = 0; idx < response_iovcnt; idx++)
+    {
+        log_debug("%.*s", (int)response_iov[idx].iov_len, (const char *)response_iov[idx].iov_base);
+    }
+    log_debug("\n");
+
+    conn->keep_alive = response.keep_alive;
 
-    // Write the response
-    write(connfd, response_buf, (size_t)response_size);
+    // The pieces point into the arena and the library, copy them to the connection before either goes away
+    if(connection_writev(conn, response_iov, response_iovcnt, NULL) < 0)
+    {
+        log_error("handle_client_data::connection_write: Failed to queue response [FD:%d].\n", conn->fd);
+        conn->keep_alive = false;
+    }
 
-    // Assumes that responses are heap allocated
-    // free(response);
-    request_destroy(&request, NULL);
-    response_destroy(&response, NULL);
-    free(buf);
-    free(response_buf);
+    // File bodies are not part of the response buffer, they are sent from the file right after the headers
+    if(response.body_fd > -1)
+    {
+        if(connection_queue_file(conn, response.body_fd, 0, response.body_size, NULL) < 0)
+        {
+            log_error("handle_client_data::connection_queue_file: Failed to queue response body [FD:%d].\n", conn->fd);
+            conn->keep_alive = false;    // The client would wait for a body that never comes
+        }
+        response.body_fd = -1;
+    }
 
-    return nread;
+    http->request_destroy(&request, NULL);
+    http->response_destroy(&response, NULL);
 }
 
-ssize_t handle_worker_connect(const worker_t *worker, int fd)
+/*
+ * Pins the current HTTP library while a request is answered, so that the whole request runs on one version of it even
+ * if it is reloaded in the meantime. A spooled body is mapped from its file for as long as the request needs it.
+ */
+static void handle_request(connection_t *conn, const connection_request_t *request, const handler_context_t *ctx)
 {
-    int err;
-    int dmnfd;
+    library_t   *library;
+    http_slice_t body = {NULL, 0};
+    void        *mapping = NULL;
+
+    if(request->body_fd > -1)
+    {
+        mapping = mmap(NULL, request->body_len, PROT_READ, MAP_PRIVATE, request->body_fd, 0);
+        if(mapping == MAP_FAILED)
+        {
+            log_error("handle_client_data::mmap: %s\n", strerror(errno));
+            queue_error(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            return;
+        }
 
-    dmnfd = accept(fd, NULL, NULL);
+        body.data = (const char *)mapping;
+        body.len  = request->body_len;
+    }
 
-    err = 0;
-    if(send_fd(dmnfd, worker->client.fd, &err) < 0)
+    library = library_acquire();
+    if(library == NULL)
     {
-        log_error("main::send_fd: %s\n", strerror(err));
-        close(dmnfd);
-        return -2;
+        queue_error(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    }
+    else
+    {
+        answer_request(conn, request->data, request->len, mapping ? &body : NULL, ctx, library->api);
+        library_release(library);
     }
 
-    close(dmnfd);
-    return 0;
+    if(mapping)
+    {
+        munmap(mapping, request->body_len);
+    }
 }
 
-ssize_t handle_worker_disconnect(worker_t *worker, app_state_t *app)
+/*
+ * Answers every complete request received on the connection, in order, and queues the responses for writing.
+ *
+ * Pipelined requests are all answered from the same read, so their responses go out with a single write. A partial
+ * request is left with the connection until the rest of it arrives, and so is every request behind a full output
+ * queue, until the client has read enough of it, or behind an insert, until the store has committed it.
+ *
+ * Returns the number of requests answered.
+ */
+ssize_t handle_client_data(connection_t *conn, const handler_context_t *ctx)
 {
-    char *socket_path;
+    ssize_t nrequests = 0;
+    size_t  nblocks   = ctx->arena->nblocks_allocated;
 
-    if(worker->client.fd <= 0)
+    while(conn->keep_alive && conn->uncommitted == 0 && connection_has_input(conn) && !connection_output_full(conn))
     {
-        log_warn("!!! WARNING: WORKER [PID:%d/FD:%d] DISCONNECTING WITH INVALID CLIENT\n", worker->pid, worker->fd);
+        connection_request_t request;
+        int                  err;
+        int                  framed;
+        char                 next;
+
+        err    = 0;
+        framed = connection_next_request(conn, &request, ctx->config->max_body_size, &err);
+        if(framed == 0)
+        {
+            break;    // Wait for the rest of the request
+        }
+
+        if(framed < 0)
+        {
+            if(framed == -2)
+            {
+                queue_error(conn, "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            }
+            else if(framed == -3)
+            {
+                queue_error(conn, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            }
+            else if(framed == -5)    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            {
+                queue_error(conn, "HTTP/1.1 413 Content Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            }
+            else
+            {
+                log_error("handle_client_data::connection_next_request: %s\n", strerror(err));
+                queue_error(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            }
+            break;
+        }
+
+        // Terminate the request in place for the parser, the next request starts right after it
+        next                      = request.data[request.len];
+        request.data[request.len] = '\0';
+        handle_request(conn, &request, ctx);
+        request.data[request.len] = next;
+
+        // Everything the request allocated is released at once, the arena's blocks are reused by the next one
+        arena_reset(ctx->arena);
+
+        connection_finish_request(conn, &request);
+        nrequests++;
     }
 
-    // Create path to socket file for unlinking later
-    errno       = 0;
-    socket_path = make_string("./%d.sock", worker->pid);
-    if(socket_path == NULL)
+    // Anything sent after the last response that keeps the connection open is never answered
+    if(!conn->keep_alive)
     {
-        return -1;
+        conn->state = CONNECTION_STATE_CLOSING;
+        connection_discard_input(conn);
     }
 
-    // Notify the user that the client has disconnected
-    log_debug("\n%sFD %d -> Server | Disconnect:%s\n", ANSI_COLOR_YELLOW, worker->client.fd, ANSI_COLOR_RESET);
-    log_info("[fd:%d] \"%s:%d\" disconnect\n", worker->client.fd, worker->client.address, worker->client.port);
-    log_debug("Worker[PID:%d] has exited.\n", worker->pid);
+    // Once the arena has grown to fit the worker's requests, answering them doesn't allocate anymore
+    if(ctx->arena->nblocks_allocated != nblocks)
+    {
+        log_debug("[FD:%d] Request arena grew by %zu blocks.\n", conn->fd, ctx->arena->nblocks_allocated - nblocks);
+    }
 
-    // Cleanup the worker
-    if(app_remove_worker(app, worker->pid, NULL) < 0)
+    return nrequests;
+}
+
+/*
+ * Replaces the response held for an insert the store failed to commit, the client is told and the connection closes.
+ * The responses queued ahead of it are kept.
+ */
+void handle_commit_failure(connection_t *conn)
+{
+    connection_truncate_output(conn, conn->held_output);
+    conn->commit_failed = false;
+    conn->state         = CONNECTION_STATE_CLOSING;
+    connection_discard_input(conn);
+
+    queue_error(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+}
+
+ssize_t handle_worker_message(worker_t *worker, app_state_t *app)
+{
+    char    buf[1];
+    ssize_t nread;
+
+    // The domain socket is non-blocking, drain every notification (required when edge-triggered)
+    while(true)
     {
-        log_error("handle_worker_disconnect::app_remove_worker: Failed to remove worker [PID:%d].\n", worker->pid);
+        errno = 0;
+        nread = read(worker->fd, buf, sizeof(buf));
+        if(nread < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if(nread < 0 && would_block(errno))
+        {
+            return 0;
+        }
+
+        if(nread <= 0)
+        {
+            return handle_worker_disconnect(worker, app);    // The worker has exited
+        }
+
+        // Every byte is one connection the worker has closed
+        log_debug("\n%sWorker[PID:%d] -> Server | Disconnect:%s\n", ANSI_COLOR_YELLOW, worker->pid, ANSI_COLOR_RESET);
+        if(worker->nconnections > 0)
+        {
+            worker->nconnections--;
+        }
+
+        app_resume_accepting(app, NULL);
     }
+}
 
-    // Remove .sock file
-    errno = 0;
-    if(unlink(socket_path) < 0)
+ssize_t handle_worker_disconnect(worker_t *worker, app_state_t *app)
+{
+    if(worker->nconnections > 0)
     {
-        log_error("handle_worker_disconnect::unlink: %s\n", strerror(errno));
+        log_warn("!!! WARNING: WORKER [PID:%d/FD:%d] EXITED WITH %zu ACTIVE CLIENTS\n", worker->pid, worker->fd, worker->nconnections);
+    }
+
+    log_debug("Worker[PID:%d] has exited.\n", worker->pid);
+
+    // Cleanup the worker, it will be respawned when the workers are scaled
+    if(app_remove_worker(app, worker->pid, NULL) < 0)
+    {
+        log_error("handle_worker_disconnect::app_remove_worker: Failed to remove worker [PID:%d].\n", worker->pid);
+        return -1;
     }
 
-    // Down scale workers
-    app_set_desired_workers(app, app->desired_workers - 1, NULL);
+    app_resume_accepting(app, NULL);
 
-    free(socket_path);
     return 0;
 }
@@ -0,0 +1,270 @@
+#include "http/arena.h"
+#include "http/http.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Allocations start right after the block header, rounded so that they stay aligned
+#define ARENA_HEADER_SIZE ((sizeof(arena_block_t) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static arena_block_t *block_create(arena_t *arena, size_t size);
+static uint8_t       *block_data(arena_block_t *block);
+
+int arena_init(arena_t *arena, size_t block_size, int *err)
+{
+    seterr(0);
+    if(arena == NULL || block_size == 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(arena, 0, sizeof(arena_t));
+    arena->block_size = ARENA_ROUND(block_size);
+
+    errno       = 0;
+    arena->head = block_create(arena, arena->block_size);
+    if(arena->head == NULL)
+    {
+        seterr(errno);
+        return -2;
+    }
+    arena->current = arena->head;
+
+    return 0;
+}
+
+void arena_destroy(arena_t *arena)
+{
+    arena_block_t *block;
+
+    if(arena == NULL)
+    {
+        return;
+    }
+
+    block = arena->head;
+    while(block)
+    {
+        arena_block_t *next = block->next;
+
+        free(block);
+        block = next;
+    }
+
+    memset(arena, 0, sizeof(arena_t));
+}
+
+/*
+ * Releases every allocation at once. Regular blocks are kept for the next request, blocks that were sized for a
+ * single oversized allocation are freed so one large request doesn't pin its memory forever.
+ */
+void arena_reset(arena_t *arena)
+{
+    arena_block_t **link;
+
+    if(arena == NULL || arena->head == NULL)
+    {
+        return;
+    }
+
+    link = &arena->head;
+    while(*link)
+    {
+        arena_block_t *block = *link;
+
+        if(block->size > arena->block_size && block != arena->head)
+        {
+            *link = block->next;
+            free(block);
+            continue;
+        }
+
+        block->used = 0;
+        link        = &block->next;
+    }
+
+    arena->current   = arena->head;
+    arena->last      = NULL;
+    arena->last_size = 0;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    arena_block_t *block;
+    arena_block_t *next;
+    void          *ptr;
+
+    if(arena == NULL || arena->current == NULL)
+    {
+        return NULL;
+    }
+
+    size  = ARENA_ROUND(size == 0 ? 1 : size);
+    block = arena->current;
+
+    // Move on to the next kept block, or add one after the current block if none of them has room
+    while(block->size - block->used < size)
+    {
+        if(block->next && block->next->used == 0 && block->next->size >= size)
+        {
+            block = block->next;
+            continue;
+        }
+
+        next = block_create(arena, size > arena->block_size ? size : arena->block_size);
+        if(next == NULL)
+        {
+            return NULL;
+        }
+
+        next->next  = block->next;
+        block->next = next;
+        block       = next;
+    }
+
+    ptr = block_data(block) + block->used;
+    block->used += size;
+
+    arena->current   = block;
+    arena->last      = ptr;
+    arena->last_size = size;
+
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t nmemb, size_t size)
+{
+    void *ptr;
+
+    if(size != 0 && nmemb > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+
+    ptr = arena_alloc(arena, nmemb * size);
+    if(ptr)
+    {
+        memset(ptr, 0, nmemb * size);
+    }
+
+    return ptr;
+}
+
+/*
+ * Grows an allocation. The most recent allocation grows in place while its block has room, anything else is copied
+ * and the old space is only reclaimed by the next reset.
+ */
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    void *tptr;
+
+    if(ptr == NULL)
+    {
+        return arena_alloc(arena, new_size);
+    }
+
+    if(new_size <= old_size)
+    {
+        return ptr;
+    }
+
+    if(ptr == arena->last)
+    {
+        arena_block_t *block  = arena->current;
+        size_t         needed = ARENA_ROUND(new_size);
+
+        if(block->used - arena->last_size + needed <= block->size)
+        {
+            block->used += needed - arena->last_size;
+            arena->last_size = needed;
+            return ptr;
+        }
+    }
+
+    tptr = arena_alloc(arena, new_size);
+    if(tptr)
+    {
+        memcpy(tptr, ptr, old_size);
+    }
+
+    return tptr;
+}
+
+char *arena_strdup(arena_t *arena, const char *str)
+{
+    return str ? arena_strndup(arena, str, strlen(str)) : NULL;
+}
+
+char *arena_strndup(arena_t *arena, const char *str, size_t len)
+{
+    char *copy;
+
+    if(str == NULL)
+    {
+        return NULL;
+    }
+
+    len  = strnlen(str, len);
+    copy = (char *)arena_alloc(arena, len + 1);
+    if(copy)
+    {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+
+    return copy;
+}
+
+char *arena_sprintf(arena_t *arena, const char *fmt, ...)
+{
+    int     n;
+    char   *str;
+    va_list ap;
+
+    va_start(ap, fmt);
+    n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+
+    if(n < 0)
+    {
+        return NULL;
+    }
+
+    str = (char *)arena_alloc(arena, (size_t)n + 1);
+    if(str == NULL)
+    {
+        return NULL;
+    }
+
+    va_start(ap, fmt);
+    n = vsnprintf(str, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+
+    return n < 0 ? NULL : str;
+}
+
+static arena_block_t *block_create(arena_t *arena, size_t size)
+{
+    arena_block_t *block;
+
+    block = (arena_block_t *)malloc(ARENA_HEADER_SIZE + size);
+    if(block == NULL)
+    {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    arena->nblocks_allocated++;
+
+    return block;
+}
+
+static uint8_t *block_data(arena_block_t *block)
+{
+    return (uint8_t *)block + ARENA_HEADER_SIZE;
+}
@@ -1,21 +1,33 @@
 #include "http/http.h"
+#include "http/arena.h"
+#include "http/scanner.h"
 #include "http/tokenizer.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <memory.h>
-#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-#define BUFLEN 1024
+/*
+ * A status code's reason phrase and the rest of its status line after the version, e.g. " 200 OK\r\n".
+ */
+typedef struct
+{
+    const char  *msg;
+    http_slice_t line;
+} http_status_line_t;
 
+// A file extension and its preformatted Content-Type header line
 typedef struct
 {
-    HTTP_STATUS key;
-    const char *value;
-} http_status_string_map_t;
+    const char  *ext;
+    const char  *type;
+    http_slice_t header;
+} http_mime_type_t;
 
 typedef struct
 {
@@ -29,73 +41,100 @@ typedef struct
     const char  *value;
 } http_version_string_map_t;
 
-static char *make_string(const char *fmt, ...);
+#define HEADERS_INITIAL_CAPACITY 8
+#define MAX_SIZE_DIGITS 20    // Digits of SIZE_MAX on 64-bit platforms
+
+// Both tables are built at compile time, every piece of a response that doesn't depend on the request is preformatted
+#define STATUS_LINE(code, msg) [HTTP_STATUS_##code] = {(msg), {" " #code " " msg "\r\n", sizeof(" " #code " " msg "\r\n") - 1}}
+#define MIME_TYPE(ext, type) {(ext), (type), {"Content-Type: " type "\r\n", sizeof("Content-Type: " type "\r\n") - 1}}
+#define CONSTANT_SLICE(str) {(str), sizeof(str) - 1}
+
+static int                     push_header(arena_t *arena, http_header_t **headers, size_t *nheaders, char *key, char *value, int *err);
+static const http_mime_type_t *find_mime_type(const char *filepath);
+static size_t                  format_size(char *buf, size_t value);
+static char                   *append(char *dst, const void *src, size_t len);
+static size_t                  push_iovec(struct iovec *iov, size_t *count, const void *data, size_t len);
+
+// Indexed directly by status code, codes without a reason phrase are left empty
+static const http_status_line_t status_lines[HTTP_STATUS_511 + 1] = {
+    STATUS_LINE(100, "Continue"),
+    STATUS_LINE(101, "Switching Protocols"),
+    STATUS_LINE(102, "Processing"),
+    STATUS_LINE(103, "Early Hints"),
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(201, "Created"),
+    STATUS_LINE(202, "Accepted"),
+    STATUS_LINE(203, "Non-Authoritative Information"),
+    STATUS_LINE(204, "No Content"),
+    STATUS_LINE(205, "Reset Content"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(207, "Multi-Status"),
+    STATUS_LINE(208, "Already Reported"),
+    STATUS_LINE(226, "IM Used"),
+    STATUS_LINE(300, "Multiple Choices"),
+    STATUS_LINE(301, "Moved Permanently"),
+    STATUS_LINE(302, "Found"),
+    STATUS_LINE(303, "See Other"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(305, "Use Proxy"),
+    STATUS_LINE(306, "unused"),
+    STATUS_LINE(307, "Temporary Redirect"),
+    STATUS_LINE(308, "Permanent Redirect"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(401, "Unauthorized"),
+    STATUS_LINE(402, "Payment Required"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(406, "Not Acceptable"),
+    STATUS_LINE(407, "Proxy Authentication Required"),
+    STATUS_LINE(408, "Request Timeout"),
+    STATUS_LINE(409, "Conflict"),
+    STATUS_LINE(410, "Gone"),
+    STATUS_LINE(411, "Length Required"),
+    STATUS_LINE(412, "Precondition Failed"),
+    STATUS_LINE(413, "Content Too Large"),
+    STATUS_LINE(414, "URI Too Long"),
+    STATUS_LINE(415, "Unsupported Media Type"),
+    STATUS_LINE(416, "Range Not Satisfiable"),
+    STATUS_LINE(417, "Expectation Failed"),
+    STATUS_LINE(418, "I'm a teapot"),
+    STATUS_LINE(421, "Misdirected Request"),
+    STATUS_LINE(422, "Unprocessable Content"),
+    STATUS_LINE(423, "Locked"),
+    STATUS_LINE(424, "Failed Dependency"),
+    STATUS_LINE(425, "Too Early"),
+    STATUS_LINE(426, "Upgrade Required"),
+    STATUS_LINE(428, "Precondition Required"),
+    STATUS_LINE(429, "Too Many Requests"),
+    STATUS_LINE(431, "Request Header Fields Too Large"),
+    STATUS_LINE(451, "Unavailable For Legal Reasons"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(502, "Bad Gateway"),
+    STATUS_LINE(503, "Service Unavailable"),
+    STATUS_LINE(504, "Gateway Timeout"),
+    STATUS_LINE(505, "HTTP Version Not Supported"),
+    STATUS_LINE(506, "Variant Also Negotiates"),
+    STATUS_LINE(507, "Insufficient Storage"),
+    STATUS_LINE(508, "Loop Detected"),
+    STATUS_LINE(510, "Not Extended"),
+    STATUS_LINE(511, "Network Authentication Required")
+};
 
-// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-static http_status_string_map_t status_msgs[] = {
-    {HTTP_STATUS_100, "Continue"                       },
-    {HTTP_STATUS_101, "Switching Protocols"            },
-    {HTTP_STATUS_102, "Processing"                     },
-    {HTTP_STATUS_103, "Early Hints"                    },
-    {HTTP_STATUS_200, "OK"                             },
-    {HTTP_STATUS_201, "Created"                        },
-    {HTTP_STATUS_202, "Accepted"                       },
-    {HTTP_STATUS_203, "Non-Authoritative Information"  },
-    {HTTP_STATUS_204, "No Content"                     },
-    {HTTP_STATUS_205, "Reset Content"                  },
-    {HTTP_STATUS_206, "Partial Content"                },
-    {HTTP_STATUS_207, "Multi-Status"                   },
-    {HTTP_STATUS_208, "Already Reported"               },
-    {HTTP_STATUS_226, "IM Used"                        },
-    {HTTP_STATUS_300, "Multiple Choices"               },
-    {HTTP_STATUS_301, "Moved Permanently"              },
-    {HTTP_STATUS_302, "Found"                          },
-    {HTTP_STATUS_303, "See Other"                      },
-    {HTTP_STATUS_304, "Not Modified"                   },
-    {HTTP_STATUS_305, "Use Proxy"                      },
-    {HTTP_STATUS_306, "unused"                         },
-    {HTTP_STATUS_307, "Temporary Redirect"             },
-    {HTTP_STATUS_308, "Permanent Redirect"             },
-    {HTTP_STATUS_400, "Bad Request"                    },
-    {HTTP_STATUS_401, "Unauthorized"                   },
-    {HTTP_STATUS_402, "Payment Required"               },
-    {HTTP_STATUS_403, "Forbidden"                      },
-    {HTTP_STATUS_404, "Not Found"                      },
-    {HTTP_STATUS_405, "Method Not Allowed"             },
-    {HTTP_STATUS_406, "Not Acceptable"                 },
-    {HTTP_STATUS_407, "Proxy Authentication Required"  },
-    {HTTP_STATUS_408, "Request Timeout"                },
-    {HTTP_STATUS_409, "Conflict"                       },
-    {HTTP_STATUS_410, "Gone"                           },
-    {HTTP_STATUS_411, "Length Required"                },
-    {HTTP_STATUS_412, "Precondition Failed"            },
-    {HTTP_STATUS_413, "Content Too Large"              },
-    {HTTP_STATUS_414, "URI Too Long"                   },
-    {HTTP_STATUS_415, "Unsupported Media Type"         },
-    {HTTP_STATUS_416, "Range Not Satisfiable"          },
-    {HTTP_STATUS_417, "Expectation Failed"             },
-    {HTTP_STATUS_418, "I'm a teapot"                   },
-    {HTTP_STATUS_421, "Misdirected Request"            },
-    {HTTP_STATUS_422, "Unprocessable Content"          },
-    {HTTP_STATUS_423, "Locked"                         },
-    {HTTP_STATUS_424, "Failed Dependency"              },
-    {HTTP_STATUS_425, "Too Early"                      },
-    {HTTP_STATUS_426, "Upgrade Required"               },
-    {HTTP_STATUS_428, "Precondition Required"          },
-    {HTTP_STATUS_429, "Too Many Requests"              },
-    {HTTP_STATUS_431, "Request Header Fields Too Large"},
-    {HTTP_STATUS_451, "Unavailable For Legal Reasons"  },
-    {HTTP_STATUS_500, "Internal Server Error"          },
-    {HTTP_STATUS_501, "Not Implemented"                },
-    {HTTP_STATUS_502, "Bad Gateway"                    },
-    {HTTP_STATUS_503, "Service Unavailable"            },
-    {HTTP_STATUS_504, "Gateway Timeout"                },
-    {HTTP_STATUS_505, "HTTP Version Not Supported"     },
-    {HTTP_STATUS_506, "Variant Also Negotiates"        },
-    {HTTP_STATUS_507, "Insufficient Storage"           },
-    {HTTP_STATUS_508, "Loop Detected"                  },
-    {HTTP_STATUS_510, "Not Extended"                   },
-    {HTTP_STATUS_511, "Network Authentication Required"}
+// The first entry is used for files with an unknown extension
+static const http_mime_type_t mime_types[] = {
+    MIME_TYPE(NULL,   "application/octet-stream"     ),
+    MIME_TYPE("txt",  "text/plain"                   ),
+    MIME_TYPE("html", "text/html"                    ),
+    MIME_TYPE("js",   "application/javascript"       ),
+    MIME_TYPE("json", "application/json"             ),
+    MIME_TYPE("css",  "text/css"                     ),
+    MIME_TYPE("png",  "image/png"                    ),
+    MIME_TYPE("jpeg", "image/jpeg"                   ),
+    MIME_TYPE("jpg",  "image/jpeg"                   ),
+    MIME_TYPE("gif",  "image/gif"                    ),
+    MIME_TYPE("swf",  "application/x-shockwave-flash")
 };
 
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
@@ -112,10 +151,14 @@ static http_version_string_map_t version_names[] = {
 };
 
 // Request
-int request_init(http_request_t *request, const char *public_dir, int *err)
+/*
+ * Everything the request and its response allocate comes from `arena`, the caller resets it once the response has
+ * been sent or copied out.
+ */
+int request_init(http_request_t *request, const char *public_dir, arena_t *arena, int *err)
 {
     seterr(0);
-    if(request == NULL || public_dir == NULL)
+    if(request == NULL || public_dir == NULL || arena == NULL)
     {
         seterr(EINVAL);
         return -1;
@@ -123,14 +166,7 @@ int request_init(http_request_t *request, const char *public_dir, int *err)
 
     memset(request, 0, sizeof(http_request_t));
     request->public_dir = public_dir;
-
-    errno            = 0;
-    request->headers = (http_header_t *)calloc(1, sizeof(http_header_t));
-    if(request->headers == NULL)
-    {
-        seterr(errno);
-        return -2;
-    }
+    request->arena      = arena;
 
     return 0;
 }
@@ -144,85 +180,202 @@ int request_destroy(http_request_t *request, int *err)
         return -1;
     }
 
-    destroy_headers(request->headers, &request->nheaders, err);
-
-    free(request->body);
-    free(request->request_uri);
+    // The strings and headers belong to the arena
     memset(request, 0, sizeof(http_request_t));
 
     return 0;
 }
 
 int request_parse(http_request_t *request, const char *data, int *err)
+{
+    http_request_view_t view;
+
+    seterr(0);
+    if(request == NULL || data == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(request_view_parse(&view, data, strlen(data), HTTP_PARSER_STRICT, err) < 0)
+    {
+        return -2;
+    }
+
+    return request_from_view(request, &view, err) < 0 ? -3 : 0;
+}
+
+/*
+ * Parses a NUL terminated request of `len` bytes without allocating, every field of the view points into `data`.
+ */
+int request_view_parse(http_request_view_t *view, const char *data, size_t len, HTTP_PARSER parser, int *err)
 {
     http_request_tokens_t tokens;
+    const http_slice_t   *connection;
+    const char           *line;
+    const char           *headers_end;
+
+    seterr(0);
+    if(view == NULL || data == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    // The scanner only rejects requests it doesn't handle, they can still be valid under the full grammar. The grammar
+    // is memoized so that a hostile request can't make it backtrack over the same bytes again and again.
+    if((parser == HTTP_PARSER_STRICT || scan_http_request(&tokens, data, len) < 0) && tokenize_http_request(&tokens, data, len, true) < 0)
+    {
+        seterr(EINVAL);
+        return -2;
+    }
+
+    view->method       = get_http_method_code_n(tokens.method.data, tokens.method.len);
+    view->http_version = get_http_version_code_n(tokens.version.data, tokens.version.len);
+    view->request_uri  = tokens.uri;
+    view->body         = tokens.body;
+    view->nheaders     = 0;
+
+    // Split the header block into lines of "key: value", skipping the whitespace around the value
+    line        = tokens.headers.data;
+    headers_end = tokens.headers.data + tokens.headers.len;
+    while(line != NULL && line < headers_end)
+    {
+        const char         *line_end = (const char *)memchr(line, '\n', (size_t)(headers_end - line));
+        const char         *colon;
+        const char         *value;
+        const char         *value_end;
+        http_header_view_t *header;
+
+        value_end = line_end ? line_end : headers_end;
+        if(value_end > line && value_end[-1] == '\r')
+        {
+            value_end--;
+        }
 
-    char *header_str   = NULL;
-    char *header_token = NULL;
-    char *save_header_token;
-    char *save_header_key_token;
+        colon = (const char *)memchr(line, ':', (size_t)(value_end - line));
+        if(colon == NULL)
+        {
+            seterr(EINVAL);
+            return -3;
+        }
+
+        if(view->nheaders == HTTP_MAX_HEADERS)
+        {
+            seterr(E2BIG);
+            return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        }
+
+        value = colon + 1;
+        while(value < value_end && (*value == ' ' || *value == '\t'))
+        {
+            value++;
+        }
+
+        while(value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+        {
+            value_end--;
+        }
+
+        header        = &view->headers[view->nheaders++];
+        header->key   = (http_slice_t){line, (size_t)(colon - line)};
+        header->value = (http_slice_t){value, (size_t)(value_end - value)};
+
+        line = line_end ? line_end + 1 : NULL;
+    }
+
+    // HTTP/1.1 connections persist unless the client opts out, HTTP/1.0 connections only persist if the client opts in
+    connection       = request_view_header(view, "Connection");
+    view->keep_alive = view->http_version == HTTP_VERSION_11;
+    if(connection && slice_equals_nocase(*connection, "close"))
+    {
+        view->keep_alive = false;
+    }
+    else if(connection && slice_equals_nocase(*connection, "keep-alive"))
+    {
+        view->keep_alive = true;
+    }
 
-    // Tokenize
+    return 0;
+}
+
+/*
+ * Case-insensitive lookup of a header in a view, NULL if the header is missing.
+ */
+const http_slice_t *request_view_header(const http_request_view_t *view, const char *key)
+{
+    if(view == NULL || key == NULL)
+    {
+        return NULL;
+    }
+
+    for(size_t offset = 0; offset < view->nheaders; offset++)
+    {
+        if(slice_equals_nocase(view->headers[offset].key, key))
+        {
+            return &view->headers[offset].value;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Fills a request from a view. The URI, headers and body are copied into the request's arena, so the request outlives
+ * the buffer the view points into.
+ */
+int request_from_view(http_request_t *request, const http_request_view_t *view, int *err)
+{
     seterr(0);
-    if(tokenize_http_request(&tokens, data) < 0)
+    if(request == NULL || request->arena == NULL || view == NULL)
     {
+        seterr(EINVAL);
         return -1;
     }
 
-    // Set request line properties
-    request->method       = get_http_method_code(tokens.method, NULL);
-    request->http_version = get_http_version_code(tokens.version, NULL);
+    request->method       = view->method;
+    request->http_version = view->http_version;
+    request->keep_alive   = view->keep_alive;
 
-    // - If the URI is missing, this will cause a segfault.
-    //   We should default it to the homepage.
-    if(tokens.uri)
+    // Default a missing URI to the homepage
+    if(view->request_uri.len == 0 || slice_equals(view->request_uri, "/"))
     {
-        request->request_uri = strdup(strcmp(tokens.uri, "/") == 0 ? "/index.html" : tokens.uri);
+        request->request_uri = arena_strdup(request->arena, "/index.html");
     }
     else
     {
-        request->request_uri = strdup("/index.html");
+        request->request_uri = arena_strndup(request->arena, view->request_uri.data, view->request_uri.len);
     }
 
-    // Set header properties
-    errno      = 0;
-    header_str = strdup(tokens.headers);
-    if(header_str == NULL)
+    if(request->request_uri == NULL)
     {
-        seterr(errno);
-        return -3;
+        seterr(ENOMEM);
+        return -2;
     }
 
-    header_token = strtok_r(header_str, "\r\n", &save_header_token);
-    while(header_token != NULL)
+    for(size_t offset = 0; offset < view->nheaders; offset++)
     {
-        char       *header_key   = NULL;
-        const char *header_value = NULL;
-
-        // Split the header by `: ` and capture the key and value
-        header_key   = strtok_r(header_token, ": ", &save_header_key_token);
-        header_value = header_key + strlen(header_key) + 2;    // Assuming the header only has a ": " after the key
+        const http_header_view_t *header = &view->headers[offset];
+        char                     *key    = arena_strndup(request->arena, header->key.data, header->key.len);
+        char                     *value  = arena_strndup(request->arena, header->value.data, header->value.len);
 
-        // Add the header
-        if(add_header(&request->headers, &request->nheaders, header_key, header_value, err) < 0)
+        if(push_header(request->arena, &request->headers, &request->nheaders, key, value, err) < 0)
         {
-            free(header_str);
-            return -4;
+            return -3;
         }
-
-        header_token = strtok_r(NULL, "\r\n", &save_header_token);
     }
 
-    // Copy body
-    request->body      = (uint8_t *)strdup(tokens.body);
-    request->body_size = strlen(tokens.body);
+    // The body may hold NUL bytes, it is copied by length and terminated for callers that treat it as a string
+    request->body_size = view->body.len;
+    request->body      = (uint8_t *)arena_alloc(request->arena, view->body.len + 1);
+    if(request->body == NULL)
+    {
+        seterr(ENOMEM);
+        return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+    memcpy(request->body, view->body.data, view->body.len);
+    request->body[view->body.len] = '\0';
 
-    free(header_str);
-    free(tokens.method);
-    free(tokens.uri);
-    free(tokens.version);
-    free(tokens.body);
-    free(tokens.headers);
     return 0;
 }
 
@@ -253,24 +406,27 @@ int handle_get(http_request_t *request, http_response_t *response, int *err)
 {
     bool uri_valid = false;
 
-    int     fd        = -1;
-    char   *body      = NULL;
-    ssize_t body_size = -1;
+    int         fd        = -1;
+    ssize_t     body_size = -1;
+    struct stat file_stat;
 
-    char *filepath             = NULL;
-    char *content_length_value = NULL;
-    char *content_type_value   = NULL;
+    const char *filepath = NULL;
 
     uri_valid = validate_http_uri(request->request_uri);
 
     if(!uri_valid)
     {    // User has probably tried to backtrack
-        response_init(response, HTTP_STATUS_403, NULL);
+        response_init(response, HTTP_STATUS_403, request->arena, NULL);
         goto exit;
     }
 
     // Create full filepath
-    filepath = make_string("%s%s", request->public_dir, request->request_uri);
+    filepath = arena_sprintf(request->arena, "%s%s", request->public_dir, request->request_uri);
+    if(filepath == NULL)
+    {
+        response_init(response, HTTP_STATUS_500, request->arena, NULL);
+        goto exit;
+    }
 
     // Open the file
     errno = 0;
@@ -278,62 +434,38 @@ int handle_get(http_request_t *request, http_response_t *response, int *err)
     if(fd < 0)
     {
         seterr(errno);
-        response_init(response, HTTP_STATUS_404, NULL);
+        response_init(response, HTTP_STATUS_404, request->arena, NULL);
         goto exit;
     }
 
-    // Read the file
-    seterr(0);
-    body_size = read_fd(fd, (uint8_t **)&body, BUFLEN, err);
-    if(body_size < 0)
+    // Only the size is needed, the body is sent straight from the file
+    errno = 0;
+    if(fstat(fd, &file_stat) < 0 || !S_ISREG(file_stat.st_mode))
     {
-        response_init(response, HTTP_STATUS_404, NULL);
+        seterr(errno);
+        response_init(response, HTTP_STATUS_404, request->arena, NULL);
         goto exit;
     }
+    body_size = (ssize_t)file_stat.st_size;
 
-    // Write file contents to response->body
-    if(response_init(response, HTTP_STATUS_200, err) < 0)
+    if(response_init(response, HTTP_STATUS_200, request->arena, err) < 0)
     {
-        free(body);
         goto exit;
     }
 
-    response->body      = body;
+    // The response owns the fd from here on
+    response->body_fd   = fd;
     response->body_size = (size_t)body_size;
+    fd                  = -1;
 
-    // Remake Content-Type header
-    content_type_value = strdup(get_mime_type(filepath));    // NOLINT(clang-analyzer-unix.Malloc)
-
-    if(destroy_header(response->headers, &response->nheaders, "Content-Type", err) < 0)
-    {
-        response->status = HTTP_STATUS_500;
-        goto exit;
-    }
-
-    if(add_header(&response->headers, &response->nheaders, "Content-Type", content_type_value, err) < 0)    // NOLINT(clang-analyzer-unix.Malloc)
-    {
-        response->status = HTTP_STATUS_500;    // NOLINT(clang-analyzer-unix.Malloc)
-        goto exit;
-    }
+    // Content-Length is written from body_size along with the rest of the headers
+    response->content_type = find_mime_type(filepath)->header;
 
 exit:
-    // Remake Content-Length header
-    content_length_value = make_string("%d", response->body ? body_size : 0);    // NOLINT(clang-analyzer-unix.Malloc)
-
-    if(destroy_header(response->headers, &response->nheaders, "Content-Length", err) < 0)    // NOLINT(clang-analyzer-unix.Malloc)
-    {
-        response->status = HTTP_STATUS_500;
-    }
-
-    if(add_header(&response->headers, &response->nheaders, "Content-Length", content_length_value, err) < 0)
+    if(fd > -1)
     {
-        response->status = HTTP_STATUS_500;
+        close(fd);
     }
-
-    free(content_length_value);
-    free(content_type_value);
-    free(filepath);
-    close(fd);
     return 0;
 }
 
@@ -343,8 +475,12 @@ int handle_head(http_request_t *request, http_response_t *response, int *err)
 {
     handle_get(request, response, err);
 
-    free(response->body);
-    response->body = NULL;
+    // Keep Content-Length, but there is no body to send
+    if(response->body_fd > -1)
+    {
+        close(response->body_fd);
+        response->body_fd = -1;
+    }
 
     return 0;
 }
@@ -357,325 +493,199 @@ int handle_post(http_request_t *request, http_response_t *response, int *err)
 }
 
 // Response
-int response_init(http_response_t *response, HTTP_STATUS status, int *err)
+int response_init(http_response_t *response, HTTP_STATUS status, arena_t *arena, int *err)
 {
     seterr(0);
-    if(response == NULL)
+    if(response == NULL || arena == NULL)
     {
         seterr(EINVAL);
         return -1;
     }
 
     memset(response, 0, sizeof(http_response_t));
-    response->status = status;
-
-    errno             = 0;
-    response->headers = (http_header_t *)calloc(1, sizeof(http_header_t));
-    if(response->headers == NULL)
-    {
-        seterr(errno);
-        return -2;
-    }
+    response->status  = status;
+    response->body_fd = -1;
+    response->arena   = arena;
 
     return 0;
 }
 
 int response_destroy(http_response_t *response, int *err)
 {
-    if(destroy_headers(response->headers, &response->nheaders, err) < 0)
-    {
-        return -1;
-    }
-
-    free(response->body);
-    memset(response, 0, sizeof(http_response_t));
-
-    return 0;
-}
-
-ssize_t response_write(const http_response_t *response, const http_request_t *request, char **buf, int *err)
-{
-    size_t buf_size = 0;
-
-    if(response_write_status_line(response, buf, &buf_size, err) < 0)
+    seterr(0);
+    if(response == NULL)
     {
+        seterr(EINVAL);
         return -1;
     }
 
-    if(response_write_headers(response, buf, &buf_size, err) < 0)
+    if(response->body_fd > -1)
     {
-        return -2;
+        close(response->body_fd);
+        response->body_fd = -1;
     }
 
-    if(response_write_crlf(response, buf, &buf_size, err) < 0)
-    {
-        return -3;
-    }
-
-    if(request->method != HTTP_METHOD_HEAD && !(response->status >= HTTP_STATUS_400 && response->status < HTTP_STATUS_511))    // Do not write body on HEAD requests or 400-599 status'
-    {
-        if(response_write_body(response, buf, &buf_size, err) < 0)
-        {
-            return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-        }
-    }
+    // The headers and body belong to the arena
+    memset(response, 0, sizeof(http_response_t));
+    response->body_fd = -1;
 
-    return (ssize_t)buf_size;
+    return 0;
 }
 
-// Response - Write components
-int response_write_status_line(const http_response_t *response, char **buf, size_t *buf_size, int *err)
+/*
+ * Describes the response as a list of up to HTTP_RESPONSE_IOVECS pieces instead of copying it into one buffer.
+ *
+ * The status line, Content-Type and Connection lines point into the preformatted tables above and the body is
+ * referenced where it is, only Content-Length and any extra headers are formatted into the arena. The pieces are valid
+ * until the arena is reset and for as long as this copy of the library stays loaded.
+ *
+ * Returns the total size of the pieces, `iovcnt` is set to the number of pieces used.
+ */
+ssize_t response_write(const http_response_t *response, const http_request_t *request, struct iovec *iov, size_t *iovcnt, int *err)
 {
-    char *tbuf;
-    int   len;
-    int   written;
-
-    const char *version;
-    HTTP_STATUS status;
-    const char *status_msg;
+    static const http_slice_t content_length = CONSTANT_SLICE("Content-Length: ");
+    static const http_slice_t keep_alive_end = CONSTANT_SLICE("Connection: keep-alive\r\n\r\n");
+    static const http_slice_t close_end      = CONSTANT_SLICE("Connection: close\r\n\r\n");
+
+    const char  *version;
+    http_slice_t connection;
+    char        *length;
+    size_t       length_len;
+    char        *headers     = NULL;
+    size_t       headers_len = 0;
+    size_t       body_size   = 0;
+    size_t       count       = 0;
+    size_t       size        = 0;
 
     seterr(0);
-    if(response == NULL || buf == NULL)
+    if(response == NULL || response->arena == NULL || request == NULL || iov == NULL || iovcnt == NULL || *iovcnt < HTTP_RESPONSE_IOVECS)
     {
         seterr(EINVAL);
         return -1;
     }
 
     version = get_http_version_name(response->http_version, err);
-    if(version == NULL)
-    {
-        return -2;
-    }
-
-    status = response->status;
-    if(status == HTTP_STATUS_UNKNOWN)
-    {
-        return -2;
-    }
-
-    status_msg = get_http_status_msg(response->status, err);
-    if(status_msg == NULL)
+    if(version == NULL || response->status <= HTTP_STATUS_UNKNOWN || response->status > HTTP_STATUS_511 || status_lines[response->status].msg == NULL)
     {
+        seterr(EINVAL);
         return -2;
     }
+    connection = response->keep_alive ? keep_alive_end : close_end;
 
-    // Get total string length
-    len = snprintf(NULL, 0, "%s %u %s\r\n", version, status, status_msg);    // cppcheck-suppress invalidPrintfArgType_uint
-    if(len < 0)
-    {
-        seterr(EIO);
-        return -3;
-    }
-
-    tbuf = calloc((size_t)len + 1, sizeof(char));
-    if(tbuf == NULL)
+    // Content-Length is the only part of every response that has to be formatted
+    length = (char *)arena_alloc(response->arena, MAX_SIZE_DIGITS + 2);
+    if(length == NULL)
     {
         seterr(ENOMEM);
         return -3;
     }
-    *buf = tbuf;
-
-    // Write to buf
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-truncation"
-    written = snprintf(tbuf, (size_t)len + 1, "%s %u %s\r\n", version, status, status_msg);    // cppcheck-suppress invalidPrintfArgType_uint
-#pragma GCC diagnostic pop
-    if(written != len)
-    {
-        free(tbuf);
-        seterr(EIO);
-        return -3;
-    }
-
-    *buf_size = (size_t)written;
+    length_len = format_size(length, response->body_size);
+    memcpy(length + length_len, "\r\n", 2);
+    length_len += 2;
 
-    return 0;
-}
-
-int response_write_headers(const http_response_t *response, char **buf, size_t *buf_size, int *err)
-{
-    char *tbuf;
-
-    seterr(0);
-    if(response == NULL || buf == NULL || *buf == NULL)
+    // Extra headers are rare, they are written into a single block
+    for(size_t idx = 0; idx < response->nheaders; idx++)
     {
-        seterr(EINVAL);
-        return -1;
+        headers_len += strlen(response->headers[idx].key) + 2 + strlen(response->headers[idx].value) + 2;    // [key] [: ](2) [value] [\r\n](2)
     }
 
-    for(size_t offset = 0; offset < response->nheaders; offset++)
+    if(headers_len > 0)
     {
-        const http_header_t *header    = response->headers + offset;
-        const size_t         key_len   = strlen(header->key);
-        const size_t         value_len = strlen(header->value);
-        const size_t         total_len = key_len + 2 + value_len + 2;    // [key] [: ](2) [value] [\\r\n](2); The 2 is for the colon and space and other 2 for \\r\n
+        char *out;
 
-        // Expand buf mem space
-        errno = 0;
-        tbuf  = (char *)realloc(*buf, *buf_size + total_len + 1);
-        if(tbuf == NULL)
+        headers = (char *)arena_alloc(response->arena, headers_len);
+        if(headers == NULL)
         {
-            seterr(errno);
-            return -2;
+            seterr(ENOMEM);
+            return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
         }
-        *buf = tbuf;
-
-        // Write header in buffer
-        memcpy(*buf + *buf_size, header->key, key_len);
-        memcpy(*buf + *buf_size + key_len, ": ", 2);
-        memcpy(*buf + *buf_size + key_len + 2, header->value, value_len);
-        memcpy(*buf + *buf_size + key_len + 2 + value_len, "\r\n", 2);
-        (*buf)[*buf_size + total_len] = '\0';
-        *buf_size += total_len;
-    }
-
-    return 0;
-}
-
-int response_write_crlf(const http_response_t *response, char **buf, size_t *buf_size, int *err)
-{
-    char *tbuf;
-
-    seterr(0);
-    if(response == NULL || buf == NULL || *buf == NULL)
-    {
-        seterr(EINVAL);
-        return -1;
-    }
-
-    // Expand buf mem space
-    errno = 0;
-    tbuf  = realloc(*buf, *buf_size + 2 + 1);
-    if(tbuf == NULL)
-    {
-        seterr(errno);
-        return -2;
-    }
-    *buf = tbuf;
-
-    // Write \r\n into buf
-    memcpy(*buf + *buf_size, "\r\n", 2);
-    (*buf)[*buf_size + 2] = '\0';
-    *buf_size += 2;
 
-    return 0;
-}
-
-int response_write_body(const http_response_t *response, char **buf, size_t *buf_size, int *err)
-{
-    char *tbuf;
+        out = headers;
+        for(size_t idx = 0; idx < response->nheaders; idx++)
+        {
+            const http_header_t *header = response->headers + idx;
 
-    seterr(0);
-    if(response == NULL || buf == NULL || *buf == NULL)
-    {
-        seterr(EINVAL);
-        return -1;
+            out = append(out, header->key, strlen(header->key));
+            out = append(out, ": ", 2);
+            out = append(out, header->value, strlen(header->value));
+            out = append(out, "\r\n", 2);
+        }
     }
 
-    // Expand buf mem space
-    errno = 0;
-    tbuf  = realloc(*buf, *buf_size + response->body_size + 1);
-    if(tbuf == NULL)
+    // Do not write body on HEAD requests or 400-599 status', a file body is sent by the caller straight from body_fd
+    if(request->method != HTTP_METHOD_HEAD && !(response->status >= HTTP_STATUS_400 && response->status < HTTP_STATUS_511) && response->body_fd < 0)
     {
-        seterr(errno);
-        return -2;
+        body_size = response->body_size;
     }
-    *buf = tbuf;
 
-    // Write body into buf
-    memcpy(*buf + *buf_size, response->body, response->body_size);
-    (*buf)[*buf_size + response->body_size] = '\0';
-    *buf_size += response->body_size;
+    size += push_iovec(iov, &count, version, strlen(version));
+    size += push_iovec(iov, &count, status_lines[response->status].line.data, status_lines[response->status].line.len);
+    size += push_iovec(iov, &count, response->content_type.data, response->content_type.len);
+    size += push_iovec(iov, &count, content_length.data, content_length.len);
+    size += push_iovec(iov, &count, length, length_len);
+    size += push_iovec(iov, &count, headers, headers_len);
+    size += push_iovec(iov, &count, connection.data, connection.len);
+    size += push_iovec(iov, &count, response->body, body_size);
 
-    return 0;
+    *iovcnt = count;
+    return (ssize_t)size;
 }
 
 // Headers
-int add_header(http_header_t **headers, size_t *nheaders, const char *key, const char *value, int *err)
-{
-    http_header_t *theaders;
 
+/*
+ * Appends a copy of the header.
+ */
+int add_header(arena_t *arena, http_header_t **headers, size_t *nheaders, const char *key, const char *value, int *err)
+{
     seterr(0);
-    if(headers == NULL || *headers == NULL || nheaders == NULL || key == NULL || value == NULL)
+    if(arena == NULL || headers == NULL || nheaders == NULL || key == NULL || value == NULL)
     {
         seterr(EINVAL);
         return -1;
     }
 
-    // Expand the headers array
-    errno    = 0;
-    theaders = realloc(*headers, (*nheaders + 1) * sizeof(http_header_t));
-    if(theaders == NULL)
-    {
-        seterr(errno);
-        return -3;
-    }
-    *headers = theaders;
-
-    // Add header to end of list
-    // memcpy(&(*headers)[*nheaders], header, sizeof(http_header_t));
-    theaders[*nheaders].key   = strdup(key);
-    theaders[*nheaders].value = strdup(value);
-    *nheaders += 1;
-
-    return 0;
+    return push_header(arena, headers, nheaders, arena_strdup(arena, key), arena_strdup(arena, value), err) < 0 ? -2 : 0;
 }
 
-http_header_t *create_header(const char *key, const char *value, int *err)
+http_header_t *create_header(arena_t *arena, const char *key, const char *value, int *err)
 {
     http_header_t *header;
 
-    size_t key_len;
-    size_t value_len;
-
     seterr(0);
-    if(key == NULL || value == NULL)
+    if(arena == NULL || key == NULL || value == NULL)
     {
         seterr(EINVAL);
         return NULL;
     }
 
-    key_len   = strlen(key);
-    value_len = strlen(value);
-
-    errno  = 0;
-    header = (http_header_t *)calloc(1, sizeof(http_header_t));
+    header = (http_header_t *)arena_alloc(arena, sizeof(http_header_t));
     if(header == NULL)
     {
-        seterr(errno);
-        return NULL;
-    }
-
-    errno       = 0;
-    header->key = (char *)calloc(key_len + 1, sizeof(char));
-    if(header->key == NULL)
-    {
-        seterr(errno);
-        free(header);
+        seterr(ENOMEM);
         return NULL;
     }
-    memcpy(header->key, key, key_len);
 
-    errno         = 0;
-    header->value = (char *)calloc(value_len + 1, sizeof(char));
-    if(header->value == NULL)
+    header->key   = arena_strdup(arena, key);
+    header->value = arena_strdup(arena, value);
+    if(header->key == NULL || header->value == NULL)
     {
-        seterr(errno);
-        free(header->key);
-        free(header);
+        seterr(ENOMEM);
         return NULL;
     }
-    memcpy(header->value, value, value_len);
 
     return header;
 }
 
+/*
+ * Removes every header named `key`, keeping the order of the others. The strings stay in the arena.
+ */
 int destroy_header(http_header_t *headers, size_t *nheaders, const char *key, int *err)
 {
-    bool should_shift = false;
+    size_t kept = 0;
 
     seterr(0);
-    if(headers == NULL || nheaders == NULL || key == NULL)
+    if(nheaders == NULL || key == NULL || (headers == NULL && *nheaders > 0))
     {
         seterr(EINVAL);
         return -1;
@@ -683,59 +693,84 @@ int destroy_header(http_header_t *headers, size_t *nheaders, const char *key, in
 
     for(size_t offset = 0; offset < *nheaders; offset++)
     {
-        const bool     is_last_element = offset == (*nheaders - 1);
-        http_header_t *header          = headers + offset;
-
-        if(header == NULL || header->key == NULL || header->value == NULL)
+        if(headers[offset].key && strcmp(headers[offset].key, key) == 0)
         {
             continue;
         }
 
-        // Remove the header if found
-        if(strcmp(header->key, key) == 0)
-        {
-            free(header->key);
-            free(header->value);
-            (*nheaders)--;
-            should_shift = true;
-        }
+        headers[kept++] = headers[offset];
+    }
+    *nheaders = kept;
 
-        // Shift the remaining elements down after removing the intended header
-        if(should_shift && !is_last_element)
+    return 0;
+}
+
+/*
+ * Case-insensitive lookup of a header's value, NULL if the header is missing.
+ */
+const char *get_header_value(const http_header_t *headers, size_t nheaders, const char *key)
+{
+    if(headers == NULL || key == NULL)
+    {
+        return NULL;
+    }
+
+    for(size_t offset = 0; offset < nheaders; offset++)
+    {
+        if(headers[offset].key && strcasecmp(headers[offset].key, key) == 0)
         {
-            memmove(&headers[offset], &headers[offset + 1], sizeof(http_header_t));
-            memset(&headers[offset + 1], 0, sizeof(http_header_t));
+            return headers[offset].value;
         }
     }
 
-    return 0;
+    return NULL;
 }
 
 int destroy_headers(http_header_t *headers, size_t *nheaders, int *err)
 {
     seterr(0);
-    if(headers == NULL || nheaders == NULL)
+    if(nheaders == NULL)
     {
         seterr(EINVAL);
         return -1;
     }
 
-    // This is a niche case where I've allocated one http_header_t slot but nheader is set to "0" because there are
-    // technically no headers in that memory space but I've still got to free the empty allocation.
-    if(*nheaders == 0)
+    // The array and its strings belong to the arena
+    unused(headers);
+    *nheaders = 0;
+
+    return 0;
+}
+
+/*
+ * Appends a header whose strings already live in the arena. The array grows by doubling, its capacity is the next
+ * power of two.
+ */
+static int push_header(arena_t *arena, http_header_t **headers, size_t *nheaders, char *key, char *value, int *err)
+{
+    if(key == NULL || value == NULL)
     {
-        *nheaders += 1;
+        seterr(ENOMEM);
+        return -1;
     }
 
-    for(size_t offset = 0; offset < *nheaders; offset++)
+    if(*nheaders == 0 || (*nheaders >= HEADERS_INITIAL_CAPACITY && (*nheaders & (*nheaders - 1)) == 0))
     {
-        http_header_t *header = headers + offset;
-        free(header->key);
-        free(header->value);
+        const size_t   capacity = *nheaders == 0 ? HEADERS_INITIAL_CAPACITY : *nheaders * 2;
+        http_header_t *theaders;
+
+        theaders = (http_header_t *)arena_realloc(arena, *headers, *nheaders * sizeof(http_header_t), capacity * sizeof(http_header_t));
+        if(theaders == NULL)
+        {
+            seterr(ENOMEM);
+            return -2;
+        }
+        *headers = theaders;
     }
 
-    free(headers);
-    *nheaders = 0;
+    (*headers)[*nheaders].key   = key;
+    (*headers)[*nheaders].value = value;
+    *nheaders += 1;
 
     return 0;
 }
@@ -761,32 +796,35 @@ bool validate_http_method(const char *method)
 
 bool validate_http_uri(const char *uri)
 {
-    bool result = true;
-
-    char       *mod_uri;
-    const char *token_;
-    char       *save_token;
-    int         net_traversals = 0;
+    int net_traversals = 0;
 
     if(uri == NULL)
     {
         return false;
     }
 
-    // Copy the string so strok can modify it
-    mod_uri = strdup(uri);
-
-    // Loop through strtok and count the net of non-backtrack (..) segments
-    token_ = strtok_r(mod_uri, "/", &save_token);
-    while(token_ != NULL)
+    // Walk the segments in place and count the net of non-backtrack (..) segments
+    while(*uri)
     {
-        net_traversals += strcmp(token_, "..") != 0 ? 1 : -1;
-        result = net_traversals >= 0;
-        token_ = strtok_r(NULL, "/", &save_token);
+        size_t segment_len;
+
+        uri += strspn(uri, "/");
+        segment_len = strcspn(uri, "/");
+        if(segment_len == 0)
+        {
+            break;
+        }
+
+        net_traversals += (segment_len == 2 && uri[0] == '.' && uri[1] == '.') ? -1 : 1;
+        if(net_traversals < 0)
+        {
+            return false;
+        }
+
+        uri += segment_len;
     }
 
-    free(mod_uri);
-    return result;
+    return true;
 }
 
 bool validate_http_version(const char *version)
@@ -818,9 +856,16 @@ HTTP_METHOD get_http_method_code(const char *method, int *err)
         return HTTP_METHOD_UNKNOWN;
     }
 
-    for(size_t idx = 0; idx < arrlen(status_msgs); idx++)
+    return get_http_method_code_n(method, strlen(method));
+}
+
+HTTP_METHOD get_http_method_code_n(const char *method, size_t len)
+{
+    const http_slice_t slice = {method, len};
+
+    for(size_t idx = 0; method && idx < arrlen(method_names); idx++)
     {
-        if(strcmp(method_names[idx].value, method) == 0)
+        if(slice_equals(slice, method_names[idx].value))
         {
             return method_names[idx].key;
         }
@@ -838,9 +883,16 @@ HTTP_VERSION get_http_version_code(const char *version, int *err)
         return HTTP_VERSION_UNKNOWN;
     }
 
-    for(size_t idx = 0; idx < arrlen(status_msgs); idx++)
+    return get_http_version_code_n(version, strlen(version));
+}
+
+HTTP_VERSION get_http_version_code_n(const char *version, size_t len)
+{
+    const http_slice_t slice = {version, len};
+
+    for(size_t idx = 0; version && idx < arrlen(version_names); idx++)
     {
-        if(strcmp(version_names[idx].value, version) == 0)
+        if(slice_equals(slice, version_names[idx].value))
         {
             return version_names[idx].key;
         }
@@ -852,16 +904,12 @@ HTTP_VERSION get_http_version_code(const char *version, int *err)
 const char *get_http_status_msg(HTTP_STATUS status, int *err)
 {
     seterr(0);
-
-    for(size_t idx = 0; idx < arrlen(status_msgs); idx++)
+    if(status <= HTTP_STATUS_UNKNOWN || status > HTTP_STATUS_511)
     {
-        if(status_msgs[idx].key == status)
-        {
-            return status_msgs[idx].value;
-        }
+        return NULL;
     }
 
-    return NULL;
+    return status_lines[status].msg;
 }
 
 const char *get_http_version_name(HTTP_VERSION version, int *err)
@@ -880,103 +928,91 @@ const char *get_http_version_name(HTTP_VERSION version, int *err)
 }
 
 const char *get_mime_type(const char *filepath)
+{
+    return find_mime_type(filepath)->type;
+}
+
+static const http_mime_type_t *find_mime_type(const char *filepath)
 {
     const char *ext = strrchr(filepath, '.');
     if(ext == NULL)
     {
-        return "application/octet-stream";
+        return &mime_types[0];
     }
 
     ext++;
 
-    if(strcasecmp(ext, "txt") == 0)
+    for(size_t idx = 1; idx < arrlen(mime_types); idx++)
     {
-        return "text/plain";
-    }
-
-    if(strcasecmp(ext, "html") == 0)
-    {
-        return "text/html";
+        if(strcasecmp(ext, mime_types[idx].ext) == 0)
+        {
+            return &mime_types[idx];
+        }
     }
 
-    if(strcasecmp(ext, "js") == 0)
-    {
-        return "application/javascript";
-    }
+    return &mime_types[0];
+}
 
-    if(strcasecmp(ext, "json") == 0)
-    {
-        return "application/json";
-    }
+/*
+ * Writes `value` in decimal without a NUL terminator, `buf` must hold MAX_SIZE_DIGITS bytes. Returns the number of
+ * digits written.
+ */
+static size_t format_size(char *buf, size_t value)
+{
+    char   digits[MAX_SIZE_DIGITS];
+    size_t len = 0;
 
-    if(strcasecmp(ext, "css") == 0)
+    do
     {
-        return "text/css";
-    }
+        digits[MAX_SIZE_DIGITS - ++len] = (char)('0' + (value % 10));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        value /= 10;                                                      // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    } while(value > 0);
 
-    if(strcasecmp(ext, "png") == 0)
-    {
-        return "image/png";
-    }
+    memcpy(buf, digits + MAX_SIZE_DIGITS - len, len);
+    return len;
+}
 
-    if(strcasecmp(ext, "jpeg") == 0 || strcasecmp(ext, "jpg") == 0)
+// Copies `len` bytes to `dst` and returns the end of the copy, `src` may be NULL when there is nothing to copy
+static char *append(char *dst, const void *src, size_t len)
+{
+    if(len > 0)
     {
-        return "image/jpeg";
+        memcpy(dst, src, len);
     }
 
-    if(strcasecmp(ext, "gif") == 0)
-    {
-        return "image/gif";
-    }
+    return dst + len;
+}
 
-    if(strcasecmp(ext, "swf") == 0)
+// Adds a piece to the list unless it is empty, returns its size
+static size_t push_iovec(struct iovec *iov, size_t *count, const void *data, size_t len)
+{
+    if(len > 0)
     {
-        return "application/x-shockwave-flash";
+        iov[*count].iov_base = (void *)(uintptr_t)data;    // writev never writes through it
+        iov[*count].iov_len  = len;
+        (*count)++;
     }
 
-    return "application/octet-stream";
+    return len;
 }
 
-// Utils - IO
-
-static char *make_string(const char *fmt, ...)
+// Utils - Slices
+bool slice_equals(http_slice_t slice, const char *str)
 {
-    int     n    = 0;
-    size_t  size = 0;
-    char   *p    = NULL;
-    va_list ap;
-
-    /* Determine required size. */
+    const size_t len = strlen(str);
 
-    va_start(ap, fmt);
-    n = vsnprintf(p, size, fmt, ap);    // NOLINT(clang-analyzer-valist.Uninitialized)
-    va_end(ap);
-
-    if(n < 0)
-    {
-        return NULL;
-    }
-
-    size = (size_t)n + 1; /* One extra byte for '\0' */
-    p    = (char *)malloc(size);
-    if(p == NULL)
-    {
-        return NULL;
-    }
-
-    va_start(ap, fmt);
-    n = vsnprintf(p, size, fmt, ap);    // NOLINT(clang-analyzer-valist.Uninitialized)
-    va_end(ap);
+    return slice.len == len && memcmp(slice.data, str, len) == 0;
+}
 
-    if(n < 0)
-    {
-        free(p);
-        return NULL;
-    }
+bool slice_equals_nocase(http_slice_t slice, const char *str)
+{
+    const size_t len = strlen(str);
 
-    return p;
+    return slice.len == len && strncasecmp(slice.data, str, len) == 0;
 }
 
+// Utils - IO
+
 ssize_t read_fd(int fd, uint8_t **buf, size_t size, int *err)
 {
     ssize_t nread;
@@ -1022,3 +1058,15 @@ ssize_t read_fd(int fd, uint8_t **buf, size_t size, int *err)
     close(fd);
     return nread;
 }
+
+const http_library_t http_library = {
+    .abi_version        = HTTP_LIBRARY_ABI_VERSION,
+    .request_init       = request_init,
+    .request_view_parse = request_view_parse,
+    .request_from_view  = request_from_view,
+    .request_process    = request_process,
+    .response_write     = response_write,
+    .request_destroy    = request_destroy,
+    .response_destroy   = response_destroy,
+    .get_mime_type      = get_mime_type,
+};
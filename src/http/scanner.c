@@ -0,0 +1,371 @@
+#include "http/scanner.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define SCAN_X86
+#endif
+
+#define T (SCAN_TOKEN | SCAN_URI | SCAN_VALUE)
+#define S (SCAN_URI | SCAN_VALUE)
+#define V SCAN_VALUE
+
+// clang-format off
+static const uint8_t char_classes[256] = {    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, V, 0, 0, 0, 0, 0, 0,    // 0x00 HT
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    // 0x10
+    V, T, S, T, T, T, T, T, S, S, T, T, S, T, T, S,    //  !"#$%&'()*+,-./
+    T, T, T, T, T, T, T, T, T, T, S, S, S, S, S, S,    // 0123456789:;<=>?
+    S, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T,    // @ABCDEFGHIJKLMNO
+    T, T, T, T, T, T, T, T, T, T, T, S, S, S, T, T,    // PQRSTUVWXYZ[\]^_
+    T, T, T, T, T, T, T, T, T, T, T, T, T, T, T, T,    // `abcdefghijklmno
+    T, T, T, T, T, T, T, T, T, T, T, S, T, S, T, 0,    // pqrstuvwxyz{|}~ DEL
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,    // 0x80 obs-text
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+    V, V, V, V, V, V, V, V, V, V, V, V, V, V, V, V,
+};
+// clang-format on
+
+#undef T
+#undef S
+#undef V
+
+#ifdef SCAN_X86
+/*
+ * A character class split in two 16 byte tables indexed by the low and high nibble of a byte. The byte is in the class
+ * when the two entries share a bit, so a whole vector of bytes is classified with two shuffles and an AND.
+ */
+typedef struct
+{
+    uint8_t lo[16];
+    uint8_t hi[16];
+} scan_nibble_table_t;
+
+static SCAN_IMPL           scan_impl = SCAN_IMPL_UNKNOWN;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static scan_nibble_table_t nibble_tables[3];                 // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+static void   build_nibble_table(scan_nibble_table_t *table, uint8_t mask);
+static size_t scan_class_sse2(const char *request, size_t offset, size_t len, uint8_t mask);
+static size_t scan_class_avx2(const char *request, size_t offset, size_t len, const scan_nibble_table_t *table);
+#endif
+
+static size_t scan_class(const char *request, size_t offset, size_t len, uint8_t mask);
+static size_t scan_spaces(const char *request, size_t offset, size_t len);
+static bool   scan_version(const char *request, size_t *offset, size_t len);
+static bool   scan_crlf(const char *request, size_t *offset, size_t len);
+
+/*
+ * Splits a request of `len` bytes into its parts, like `tokenize_http_request`. Returns the offset of the body, or -1
+ * if the request isn't in the shape the scanner handles.
+ */
+ssize_t scan_http_request(http_request_tokens_t *tokens, const char *request, size_t len)
+{
+    size_t base;
+    size_t offset;
+
+    memset(tokens, 0, sizeof(http_request_tokens_t));
+
+    // METHOD
+    offset = scan_class(request, 0, len, SCAN_TOKEN);
+    if(offset == 0)
+    {
+        return -1;
+    }
+    tokens->method = (http_slice_t){request, offset};
+
+    // 1*SP
+    base   = offset;
+    offset = scan_spaces(request, offset, len);
+    if(offset == base)
+    {
+        return -1;
+    }
+
+    // REQUEST-URI
+    base   = offset;
+    offset = scan_class(request, offset, len, SCAN_URI);
+    if(offset == base)
+    {
+        return -1;
+    }
+    tokens->uri = (http_slice_t){request + base, offset - base};
+
+    // 1*SP
+    base   = offset;
+    offset = scan_spaces(request, offset, len);
+    if(offset == base)
+    {
+        return -1;
+    }
+
+    // HTTP-VERSION
+    base = offset;
+    if(!scan_version(request, &offset, len))
+    {
+        return -1;
+    }
+    tokens->version = (http_slice_t){request + base, offset - base};
+
+    // CRLF
+    if(!scan_crlf(request, &offset, len))
+    {
+        return -1;
+    }
+
+    // *(field-name ":" field-value CRLF), up to the blank line
+    base = offset;
+    while(!scan_crlf(request, &offset, len))
+    {
+        size_t name = offset;
+
+        offset = scan_class(request, offset, len, SCAN_TOKEN);
+        if(offset == name || offset == len || request[offset] != ':')
+        {
+            return -1;
+        }
+
+        offset = scan_class(request, offset + 1, len, SCAN_VALUE);
+        if(!scan_crlf(request, &offset, len))
+        {
+            return -1;
+        }
+    }
+    tokens->headers = (http_slice_t){request + base, offset - base - 2};
+
+    // Body
+    tokens->body = (http_slice_t){request + offset, len - offset};
+
+    return (ssize_t)offset;
+}
+
+/*
+ * Picks the widest scanner the CPU supports. Runs once, the first time a request is scanned.
+ */
+SCAN_IMPL scan_implementation(void)
+{
+#ifdef SCAN_X86
+    if(scan_impl == SCAN_IMPL_UNKNOWN)
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+        {
+            build_nibble_table(&nibble_tables[0], SCAN_TOKEN);
+            build_nibble_table(&nibble_tables[1], SCAN_URI);
+            build_nibble_table(&nibble_tables[2], SCAN_VALUE);
+            scan_impl = SCAN_IMPL_AVX2;
+        }
+        else
+        {
+            scan_impl = SCAN_IMPL_SSE2;
+        }
+    }
+
+    return scan_impl;
+#else
+    return SCAN_IMPL_SCALAR;
+#endif
+}
+
+/*
+ * Returns the offset of the first byte at or after `offset` that isn't in the class. Long runs, like cookies or user
+ * agents, are checked a vector at a time and only the tail is walked byte by byte.
+ */
+static size_t scan_class(const char *request, size_t offset, size_t len, uint8_t mask)
+{
+#ifdef SCAN_X86
+    switch(scan_implementation())
+    {
+        case SCAN_IMPL_AVX2:
+            offset = scan_class_avx2(request, offset, len, &nibble_tables[mask == SCAN_TOKEN ? 0 : mask == SCAN_URI ? 1 : 2]);
+            break;
+        case SCAN_IMPL_SSE2:
+            offset = scan_class_sse2(request, offset, len, mask);
+            break;
+        case SCAN_IMPL_UNKNOWN:
+        case SCAN_IMPL_SCALAR:
+        default:
+            break;
+    }
+#endif
+
+    while(offset < len && (char_classes[(uint8_t)request[offset]] & mask))
+    {
+        offset++;
+    }
+
+    return offset;
+}
+
+static size_t scan_spaces(const char *request, size_t offset, size_t len)
+{
+    while(offset < len && request[offset] == ' ')
+    {
+        offset++;
+    }
+
+    return offset;
+}
+
+// "HTTP/" DIGIT "." DIGIT
+static bool scan_version(const char *request, size_t *offset, size_t len)
+{
+    static const char pattern[] = "HTTP/0.0";    // '0' stands for any digit
+
+    if(len - *offset < sizeof(pattern) - 1)
+    {
+        return false;
+    }
+
+    for(size_t idx = 0; idx < sizeof(pattern) - 1; idx++)
+    {
+        const unsigned char c = (unsigned char)request[*offset + idx];
+
+        if(pattern[idx] == '0' ? !isdigit(c) : c != (unsigned char)pattern[idx])
+        {
+            return false;
+        }
+    }
+
+    *offset += sizeof(pattern) - 1;
+    return true;
+}
+
+static bool scan_crlf(const char *request, size_t *offset, size_t len)
+{
+    if(len - *offset < 2 || request[*offset] != '\r' || request[*offset + 1] != '\n')
+    {
+        return false;
+    }
+
+    *offset += 2;
+    return true;
+}
+
+#ifdef SCAN_X86
+static void build_nibble_table(scan_nibble_table_t *table, uint8_t mask)
+{
+    uint16_t rows[16];
+    size_t   nrows = 0;
+
+    memset(table, 0, sizeof(scan_nibble_table_t));
+
+    // Every distinct row of the class (the low nibbles that are in it for one high nibble) gets its own bit
+    for(size_t hi = 0; hi < 16; hi++)
+    {
+        uint16_t row = 0;
+        size_t   bit;
+
+        for(size_t lo = 0; lo < 16; lo++)
+        {
+            if(char_classes[(hi << 4) | lo] & mask)
+            {
+                row |= (uint16_t)(1U << lo);
+            }
+        }
+
+        if(row == 0)
+        {
+            continue;
+        }
+
+        bit = 0;
+        while(bit < nrows && rows[bit] != row)
+        {
+            bit++;
+        }
+
+        if(bit == nrows)
+        {
+            rows[nrows++] = row;
+        }
+
+        table->hi[hi] = (uint8_t)(1U << bit);
+        for(size_t lo = 0; lo < 16; lo++)
+        {
+            if(row & (1U << lo))
+            {
+                table->lo[lo] |= (uint8_t)(1U << bit);
+            }
+        }
+    }
+}
+
+/*
+ * SSE2 has no byte shuffle, so only the classes that are plain ranges are vectorized: URI characters are 0x21-0x7E,
+ * header values are anything but control characters other than HT. Header names are short and left to the table.
+ */
+static size_t scan_class_sse2(const char *request, size_t offset, size_t len, uint8_t mask)
+{
+    const __m128i ctl_max   = _mm_set1_epi8(0x1F);           // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    const __m128i ht        = _mm_set1_epi8(0x09);           // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    const __m128i del       = _mm_set1_epi8(0x7F);           // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    const __m128i uri_min   = _mm_set1_epi8(0x21);           // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    const __m128i uri_range = _mm_set1_epi8(0x7E - 0x21);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+    if(mask == SCAN_TOKEN)
+    {
+        return offset;
+    }
+
+    while(len - offset >= sizeof(__m128i))
+    {
+        __m128i  chunk = _mm_loadu_si128((const __m128i *)(const void *)(request + offset));
+        __m128i  miss;
+        unsigned bits;
+
+        if(mask == SCAN_URI)
+        {
+            // Unsigned chunk - 0x21 <= 0x5D, anything outside the range wraps above it
+            __m128i shifted = _mm_sub_epi8(chunk, uri_min);
+
+            miss = _mm_cmpeq_epi8(_mm_min_epu8(shifted, uri_range), shifted);
+            bits = (unsigned)_mm_movemask_epi8(miss) ^ 0xFFFFU;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        }
+        else
+        {
+            __m128i ctl = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, ht), _mm_cmpeq_epi8(_mm_min_epu8(chunk, ctl_max), chunk));
+
+            miss = _mm_or_si128(ctl, _mm_cmpeq_epi8(chunk, del));
+            bits = (unsigned)_mm_movemask_epi8(miss);
+        }
+
+        if(bits != 0)
+        {
+            return offset + (size_t)__builtin_ctz(bits);
+        }
+        offset += sizeof(__m128i);
+    }
+
+    return offset;
+}
+
+__attribute__((target("avx2"))) static size_t scan_class_avx2(const char *request, size_t offset, size_t len, const scan_nibble_table_t *table)
+{
+    const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)table->lo));
+    const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)table->hi));
+    const __m256i nibble   = _mm256_set1_epi8(0x0F);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+    while(len - offset >= sizeof(__m256i))
+    {
+        __m256i  chunk = _mm256_loadu_si256((const __m256i *)(const void *)(request + offset));
+        __m256i  lo    = _mm256_shuffle_epi8(lo_table, _mm256_and_si256(chunk, nibble));
+        __m256i  hi    = _mm256_shuffle_epi8(hi_table, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble));
+        unsigned bits  = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256()));
+
+        if(bits != 0)
+        {
+            return offset + (size_t)__builtin_ctz(bits);
+        }
+        offset += sizeof(__m256i);
+    }
+
+    return offset;
+}
+#endif
@@ -1,4 +1,5 @@
 #include "http/tokenizer.h"
+#include <stdbool.h>
 #include <string.h>
 
 #define unused(x) ((void)(x))
@@ -18,12 +19,48 @@
 #define ASCII_DEL 127
 #define ASCII_PRINTABLE_CHARACTERS_END 127
 
+#define MEMO_INITIAL_CAPACITY 4096
+#define MEMO_HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+/*
+ * Packrat memo for a single request, every (parser, offset) pair is parsed once and its result reused when another
+ * alternative reaches the same position. Entries from earlier requests are told apart by their generation, so the
+ * table is never cleared and keeps its capacity between requests.
+ */
+typedef struct
+{
+    parser_fn   parser;
+    const void *ctx;
+    size_t      offset;
+    ssize_t     result;
+    uint32_t    generation;
+} memo_entry_t;
+
+typedef struct
+{
+    const char   *base;    // Request being memoized, NULL when memoization is off
+    size_t        len;
+    memo_entry_t *entries;
+    size_t        capacity;
+    size_t        nentries;
+    uint32_t      generation;
+} memo_table_t;
+
+static memo_table_t memo = {0};    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+static void          memo_begin(const char *request, size_t len);
+static void          memo_end(void);
+static memo_entry_t *memo_slot(const parser_wrapper_t *wrapper, size_t offset);
+static bool          memo_grow(void);
+static bool          memo_lookup(const parser_wrapper_t *wrapper, const char *string, ssize_t *result);
+static void          memo_store(const parser_wrapper_t *wrapper, const char *string, ssize_t result);
+
 ssize_t tokenize_request_line(http_request_tokens_t *tokens, const char *request)
 {
     ssize_t base;
     ssize_t offset;
 
-    combinator_t *many_spaces = many(WRAP(PARSER(sp)), 1, -1);
+    STATIC_MANY(many_spaces, PARSER(sp), 1, -1);
 
     offset = 0;
 
@@ -32,42 +69,37 @@ ssize_t tokenize_request_line(http_request_tokens_t *tokens, const char *request
     offset += method(request + offset, NULL);
     if((offset - base) < 0)
     {
-        offset = base;
-        goto cleanup;
+        return base;
     }
-    tokens->method = strndup(request + base, (size_t)(offset - base));
+    tokens->method = (http_slice_t){request + base, (size_t)(offset - base)};
 
     // 1*SP
-    offset += COMBINATOR_START(many_spaces, request + offset);
+    offset += NODE_START(MANY(many_spaces), request + offset);
 
     // REQUEST-URI
     base = offset;
     offset += request_uri(request + offset, NULL);
     if((offset - base) < 0)
     {
-        offset = base;
-        goto cleanup;
+        return base;
     }
-    tokens->uri = strndup(request + base, (size_t)(offset - base));
+    tokens->uri = (http_slice_t){request + base, (size_t)(offset - base)};
 
     // 1*SP
-    offset += COMBINATOR_START(many_spaces, request + offset);
+    offset += NODE_START(MANY(many_spaces), request + offset);
 
     // HTTP-VERSION
     base = offset;
     offset += http_version(request + offset, NULL);
     if((offset - base) < 0)
     {
-        offset = base;
-        goto cleanup;
+        return base;
     }
-    tokens->version = strndup(request + base, (size_t)(offset - base));
+    tokens->version = (http_slice_t){request + base, (size_t)(offset - base)};
 
     // CRLF
     offset += crlf(request + offset, NULL);
 
-cleanup:
-    free_com(many_spaces);
     return offset;
 }
 
@@ -76,24 +108,29 @@ ssize_t tokenize_headers(http_request_tokens_t *tokens, const char *request)
     ssize_t base;
     ssize_t offset;
 
-    combinator_t *com_headers = many(WRAP(PARSER(http_header)), 0, -1);
+    STATIC_MANY(com_headers, PARSER(http_header), 0, -1);
 
     base   = 0;
-    offset = COMBINATOR_START(com_headers, request);
+    offset = NODE_START(MANY(com_headers), request);
     if(offset < 0)
     {
-        goto cleanup;
+        return offset;
     }
-    tokens->headers = strndup(request, (size_t)(offset - base));
+    tokens->headers = (http_slice_t){request, (size_t)(offset - base)};
 
-cleanup:
-    free_com(com_headers);
     return offset;
 }
 
 // size_t tokenize_body(http_request_tokens_t *tokens, const char *request);
 
-ssize_t tokenize_http_request(http_request_tokens_t *tokens, const char *request)
+/*
+ * Splits a NUL terminated request of `len` bytes into its parts, without copying them. The body is whatever follows
+ * the headers, so it may contain NUL bytes.
+ *
+ * With `memoize`, each parser runs at most once per position of the request, which keeps the parse time linear in the
+ * size of the request however much the grammar backtracks.
+ */
+ssize_t tokenize_http_request(http_request_tokens_t *tokens, const char *request, size_t len, bool memoize)
 {
     ssize_t base;
     ssize_t offset;
@@ -101,12 +138,18 @@ ssize_t tokenize_http_request(http_request_tokens_t *tokens, const char *request
     memset(tokens, 0, sizeof(http_request_tokens_t));
     offset = 0;
 
+    if(memoize)
+    {
+        memo_begin(request, len);
+    }
+
     // Request Line
     base = offset;
     offset += tokenize_request_line(tokens, request + offset);
     if(offset == base)
     {
-        return -1;
+        offset = -1;
+        goto exit;
     }
 
     // Request Line
@@ -115,14 +158,17 @@ ssize_t tokenize_http_request(http_request_tokens_t *tokens, const char *request
 
     // CRLF
     offset += crlf(request + offset, NULL);
-    if(offset == base)
+    if(offset == base || offset < 0 || (size_t)offset > len)
     {
-        return -1;
+        offset = -1;
+        goto exit;
     }
 
     // Body
-    tokens->body = strdup(request + offset);
+    tokens->body = (http_slice_t){request + offset, len - (size_t)offset};
 
+exit:
+    memo_end();
     return offset;
 }
 
@@ -149,7 +195,7 @@ ssize_t parser_sequence(const char *string, void *ctx)
             break;
         }
 
-        tprocessed = wrapper->parser(string + nprocessed, wrapper->parser_ctx);
+        tprocessed = parser_run(wrapper, string + nprocessed);
         if(tprocessed < 0)
         {
             nprocessed = tprocessed;
@@ -199,7 +245,7 @@ ssize_t parser_choice(const char *string, void *ctx)
         //     break;
         // }
         //
-        nprocessed = wrapper->parser(string, wrapper->parser_ctx);
+        nprocessed = parser_run(wrapper, string);
         if(nprocessed > 0)
         {
             goto exit;
@@ -228,11 +274,13 @@ combinator_t *choice(size_t nparsers, parser_wrapper_t *parsers)
 
 ssize_t parser_many(const char *string, void *ctx)
 {
-    many_parser_ctx_t *args = (many_parser_ctx_t *)ctx;
+    many_parser_ctx_t     *args = (many_parser_ctx_t *)ctx;
+    const parser_wrapper_t self = {parser_many, ctx};
 
     parser_wrapper_t *wrapper;
     ssize_t           nprocessed;
     size_t            count;
+    bool              resumable;
 
     nprocessed = 0;
 
@@ -243,6 +291,10 @@ ssize_t parser_many(const char *string, void *ctx)
 
     wrapper = args->parsers;
 
+    // An unbounded repetition that has met its minimum ends in the same place wherever it resumes along a run. With a
+    // memo, it joins a run that was already walked instead of walking it again, which keeps long runs linear.
+    resumable = memo.base != NULL && args->max == -1 && args->min <= 1;
+
     for(count = 0; count < (size_t)args->max || args->max == -1; count++)
     {
         ssize_t tprocessed;
@@ -252,7 +304,12 @@ ssize_t parser_many(const char *string, void *ctx)
             break;
         }
 
-        tprocessed = wrapper->parser(string + nprocessed, wrapper->parser_ctx);
+        if(resumable && count > 0 && memo_lookup(&self, string + nprocessed, &tprocessed))
+        {
+            return nprocessed + (tprocessed < 0 ? 0 : tprocessed);
+        }
+
+        tprocessed = parser_run(wrapper, string + nprocessed);
         if(tprocessed < 0)
         {
             int met_min_counts = count >= (size_t)args->min;
@@ -262,9 +319,27 @@ ssize_t parser_many(const char *string, void *ctx)
             //     return -1;
             // }
 
-            return met_min_counts ? nprocessed : -1;
+            nprocessed = met_min_counts ? nprocessed : -1;
+            break;
         }
         nprocessed += tprocessed;
+
+        if(tprocessed == 0)
+        {
+            resumable = false;
+        }
+    }
+
+    // Every item boundary of the run ends where this one did, the items themselves are memoized by now
+    if(resumable && nprocessed > 0)
+    {
+        ssize_t boundary = parser_run(wrapper, string);
+
+        while(boundary > 0 && boundary < nprocessed)
+        {
+            memo_store(&self, string + boundary, nprocessed - boundary);
+            boundary += parser_run(wrapper, string + boundary);
+        }
     }
 
 exit:
@@ -297,6 +372,9 @@ ssize_t parser_list(const char *string, void *ctx)
     ssize_t           nprocessed;
     size_t            count;
 
+    STATIC_LITERAL(comma, ",");
+    STATIC_MANY(zero_or_more_lws, PARSER(lws), 0, -1);
+
     // ( *LWS element *( *LWS "," *LWS element ))
 
     nprocessed = 0;
@@ -308,39 +386,33 @@ ssize_t parser_list(const char *string, void *ctx)
 
     wrapper = args->parsers;
 
+    for(count = 0; count < (size_t)args->max || args->max == -1; count++)
     {
-        combinator_t *comma                 = literal(",");
-        combinator_t *zero_or_more_lws      = many(WRAP(PARSER(lws)), 0, -1);
-        combinator_t *leading_element       = sequence(4, WRAP(COMBINATOR(zero_or_more_lws), COMBINATOR(comma), COMBINATOR(zero_or_more_lws), {wrapper->parser, wrapper->parser_ctx}));
-        combinator_t *many_leading_elements = many(WRAP(COMBINATOR(leading_element)), 0, -1);
-
-        combinator_t *com_list = sequence(3, WRAP(COMBINATOR(zero_or_more_lws), {wrapper->parser, wrapper->parser_ctx}, COMBINATOR(many_leading_elements)));
+        ssize_t offset = NODE_START(MANY(zero_or_more_lws), string + nprocessed);
+        ssize_t tprocessed;
 
-        for(count = 0; count < (size_t)args->max || args->max == -1; count++)
+        // Every element after the first one follows a comma
+        if(count > 0)
         {
-            ssize_t tprocessed;
-
-            if(string[nprocessed] == '\0')
-            {
-                break;
-            }
-
-            tprocessed = COMBINATOR_START(com_list, string);
+            tprocessed = NODE_START(LITERAL(comma), string + nprocessed + offset);
             if(tprocessed < 0)
             {
-                nprocessed = count >= (size_t)args->min ? nprocessed : 0;
                 break;
             }
-            nprocessed += tprocessed;
+            offset += tprocessed;
+            offset += NODE_START(MANY(zero_or_more_lws), string + nprocessed + offset);
         }
 
-        free_com(com_list);
-        free_com(many_leading_elements);
-        free_com(leading_element);
-        free_com(zero_or_more_lws);
-        free_com(comma);
+        tprocessed = parser_run(wrapper, string + nprocessed + offset);
+        if(tprocessed < 0)
+        {
+            break;
+        }
+        nprocessed += offset + tprocessed;
     }
 
+    nprocessed = count >= (size_t)args->min ? nprocessed : 0;
+
 exit:
     return nprocessed;
 }
@@ -371,11 +443,10 @@ combinator_t *optional(parser_wrapper_t *parser)
 ssize_t parser_literal(const char *string, void *ctx)
 {
     const literal_parser_ctx_t *args = (literal_parser_ctx_t *)ctx;
-    size_t                      len  = strlen(args->literal);
 
-    if(strncmp(string, args->literal, len) == 0)
+    if(strncmp(string, args->literal, args->len) == 0)
     {
-        return (ssize_t)len;
+        return (ssize_t)args->len;
     }
 
     return -1;
@@ -388,6 +459,7 @@ combinator_t *literal(const char *string)
 
     ctx          = (literal_parser_ctx_t *)calloc(1, sizeof(literal_parser_ctx_t));
     ctx->literal = string;
+    ctx->len     = strlen(string);
 
     combinator        = (combinator_t *)calloc(1, sizeof(combinator_t));
     combinator->parse = parser_literal;
@@ -396,6 +468,159 @@ combinator_t *literal(const char *string)
     return combinator;
 }
 
+// Packrat memo
+static void memo_begin(const char *request, size_t len)
+{
+    memo.base     = request;
+    memo.len      = len;
+    memo.nentries = 0;
+    memo.generation++;
+
+    // Entries are only stale by generation, so they have to be wiped when it wraps around
+    if(memo.generation == 0)
+    {
+        if(memo.entries)
+        {
+            memset(memo.entries, 0, memo.capacity * sizeof(memo_entry_t));
+        }
+        memo.generation = 1;
+    }
+
+    if(memo.entries == NULL && !memo_grow())
+    {
+        memo.base = NULL;
+    }
+}
+
+static void memo_end(void)
+{
+    memo.base = NULL;
+}
+
+/*
+ * Returns the entry for the pair, or the free slot it would go in. Free slots are the ones left by earlier requests.
+ */
+static memo_entry_t *memo_slot(const parser_wrapper_t *wrapper, size_t offset)
+{
+    uint64_t hash;
+    size_t   idx;
+
+    hash = ((uint64_t)(uintptr_t)wrapper->parser ^ ((uint64_t)(uintptr_t)wrapper->parser_ctx << 1) ^ ((uint64_t)offset << 32)) * MEMO_HASH_MULTIPLIER;
+    idx  = (size_t)(hash >> 32) & (memo.capacity - 1);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+    while(memo.entries[idx].generation == memo.generation)
+    {
+        const memo_entry_t *entry = &memo.entries[idx];
+
+        if(entry->parser == wrapper->parser && entry->ctx == wrapper->parser_ctx && entry->offset == offset)
+        {
+            break;
+        }
+        idx = (idx + 1) & (memo.capacity - 1);
+    }
+
+    return &memo.entries[idx];
+}
+
+/*
+ * Doubles the table, keeping the entries of the current request.
+ */
+static bool memo_grow(void)
+{
+    memo_entry_t *entries  = memo.entries;
+    size_t        capacity = memo.capacity;
+
+    memo.capacity = capacity ? capacity * 2 : MEMO_INITIAL_CAPACITY;
+    memo.entries  = (memo_entry_t *)calloc(memo.capacity, sizeof(memo_entry_t));
+    if(memo.entries == NULL)
+    {
+        memo.entries  = entries;
+        memo.capacity = capacity;
+        return false;
+    }
+
+    for(size_t idx = 0; idx < capacity; idx++)
+    {
+        if(entries[idx].generation == memo.generation)
+        {
+            const parser_wrapper_t wrapper = {entries[idx].parser, (void *)(uintptr_t)entries[idx].ctx};
+
+            *memo_slot(&wrapper, entries[idx].offset) = entries[idx];
+        }
+    }
+
+    free(entries);
+    return true;
+}
+
+static bool memo_lookup(const parser_wrapper_t *wrapper, const char *string, ssize_t *result)
+{
+    const memo_entry_t *entry;
+
+    if(memo.base == NULL || string < memo.base || string > memo.base + memo.len)
+    {
+        return false;
+    }
+
+    entry = memo_slot(wrapper, (size_t)(string - memo.base));
+    if(entry->generation != memo.generation)
+    {
+        return false;
+    }
+
+    *result = entry->result;
+    return true;
+}
+
+static void memo_store(const parser_wrapper_t *wrapper, const char *string, ssize_t result)
+{
+    memo_entry_t *entry;
+    size_t        offset;
+
+    if(memo.base == NULL || string < memo.base || string > memo.base + memo.len)
+    {
+        return;
+    }
+
+    if(memo.nentries + 1 > memo.capacity / 2 && !memo_grow())
+    {
+        return;
+    }
+
+    offset = (size_t)(string - memo.base);
+    entry  = memo_slot(wrapper, offset);
+    if(entry->generation != memo.generation)
+    {
+        memo.nentries++;
+    }
+
+    entry->parser     = wrapper->parser;
+    entry->ctx        = wrapper->parser_ctx;
+    entry->offset     = offset;
+    entry->result     = result;
+    entry->generation = memo.generation;
+}
+
+/*
+ * Runs a parser, through the memo while a request is being memoized. Atoms (parsers without a context) are cheaper to
+ * run again than to look up, grammar rules built from combinators are memoized through the nodes they start.
+ */
+ssize_t parser_run(const parser_wrapper_t *wrapper, const char *string)
+{
+    ssize_t result;
+
+    if(wrapper->parser_ctx == NULL || !memo_lookup(wrapper, string, &result))
+    {
+        result = wrapper->parser(string, wrapper->parser_ctx);
+        if(wrapper->parser_ctx != NULL)
+        {
+            memo_store(wrapper, string, result);
+        }
+    }
+
+    return result;
+}
+
 // Atoms
 ssize_t achar(const char *string, void *ctx)
 {
@@ -417,13 +642,12 @@ ssize_t loalpha(const char *string, void *ctx)
 
 ssize_t alpha(const char *string, void *ctx)
 {
-    combinator_t *loalpha_upalpha_choice = choice(2, WRAP(PARSER(loalpha), PARSER(upalpha)));
+    STATIC_CHOICE(loalpha_upalpha_choice, PARSER(loalpha), PARSER(upalpha));
 
-    ssize_t result = COMBINATOR_START(loalpha_upalpha_choice, string);
+    ssize_t result = NODE_START(CHOICE(loalpha_upalpha_choice), string);
 
     unused(ctx);
 
-    free_com(loalpha_upalpha_choice);
     return result;
 }
 
@@ -465,31 +689,25 @@ ssize_t dblqt(const char *string, void *ctx)
 
 ssize_t crlf(const char *string, void *ctx)
 {
-    combinator_t *crlf_seq = sequence(2, WRAP(PARSER(cr), PARSER(lf)));
+    STATIC_SEQUENCE(crlf_seq, PARSER(cr), PARSER(lf));
 
-    ssize_t result = COMBINATOR_START(crlf_seq, string);
+    ssize_t result = NODE_START(SEQUENCE(crlf_seq), string);
 
     unused(ctx);
 
-    free_com(crlf_seq);
     return result;
 }
 
 ssize_t lws(const char *string, void *ctx)
 {
-    combinator_t *com_opt_crlf          = optional(WRAP(PARSER(crlf)));
-    combinator_t *com_sp_ht_choice      = choice(2, WRAP(PARSER(sp), PARSER(ht)));
-    combinator_t *com_many_sp_ht_choice = many(WRAP(COMBINATOR(com_sp_ht_choice)), 1, -1);
-    combinator_t *com_lws               = sequence(2, WRAP(COMBINATOR(com_opt_crlf), COMBINATOR(com_many_sp_ht_choice)));
+    STATIC_OPTIONAL(com_opt_crlf, PARSER(crlf));
+    STATIC_CHOICE(com_sp_ht_choice, PARSER(sp), PARSER(ht));
+    STATIC_MANY(com_many_sp_ht_choice, CHOICE(com_sp_ht_choice), 1, -1);
+    STATIC_SEQUENCE(com_lws, OPTIONAL(com_opt_crlf), MANY(com_many_sp_ht_choice));
 
-    ssize_t result = COMBINATOR_START(com_lws, string);
+    ssize_t result = NODE_START(SEQUENCE(com_lws), string);
     unused(ctx);
 
-    free_com(com_lws);
-    free_com(com_many_sp_ht_choice);
-    free_com(com_sp_ht_choice);
-    free_com(com_opt_crlf);
-
     return result;
 }
 
@@ -584,12 +802,11 @@ static ssize_t char_except_ctl_or_tspecial(const char *string, void *ctx)
 
 ssize_t token(const char *string, void *ctx)
 {
-    combinator_t *com_token = many(WRAP(PARSER(char_except_ctl_or_tspecial)), 1, -1);
+    STATIC_MANY(com_token, PARSER(char_except_ctl_or_tspecial), 1, -1);
 
-    ssize_t result = COMBINATOR_START(com_token, string);
+    ssize_t result = NODE_START(MANY(com_token), string);
     unused(ctx);
 
-    free_com(com_token);
     return result;
 }
 
@@ -612,26 +829,23 @@ ssize_t qdtext(const char *string, void *ctx)
 
 ssize_t quoted_string(const char *string, void *ctx)
 {
-    combinator_t *com_many_qdtext = many(WRAP(PARSER(qdtext)), 0, -1);
+    STATIC_MANY(com_many_qdtext, PARSER(qdtext), 0, -1);
 
-    combinator_t *com_quoted_string = sequence(3, WRAP(PARSER(dblqt), COMBINATOR(com_many_qdtext), PARSER(dblqt)));
+    STATIC_SEQUENCE(com_quoted_string, PARSER(dblqt), MANY(com_many_qdtext), PARSER(dblqt));
 
-    ssize_t result = COMBINATOR_START(com_quoted_string, string);
+    ssize_t result = NODE_START(SEQUENCE(com_quoted_string), string);
     unused(ctx);
 
-    free_com(com_quoted_string);
-    free_com(com_many_qdtext);
     return result;
 }
 
 ssize_t word(const char *string, void *ctx)
 {
-    combinator_t *com_word = choice(2, WRAP(PARSER(token), PARSER(quoted_string)));
+    STATIC_CHOICE(com_word, PARSER(token), PARSER(quoted_string));
 
-    ssize_t result = COMBINATOR_START(com_word, string);
+    ssize_t result = NODE_START(CHOICE(com_word), string);
     unused(ctx);
 
-    free_com(com_word);
     return result;
 }
 
@@ -713,26 +927,23 @@ ssize_t unreserved(const char *string, void *ctx)
 
 ssize_t escape(const char *string, void *ctx)
 {
-    combinator_t *percent = literal("%");
+    STATIC_LITERAL(percent, "%");
 
-    combinator_t *com_escape = sequence(3, WRAP(COMBINATOR(percent), PARSER(hex), PARSER(hex)));
+    STATIC_SEQUENCE(com_escape, LITERAL(percent), PARSER(hex), PARSER(hex));
 
-    ssize_t result = COMBINATOR_START(com_escape, string);
+    ssize_t result = NODE_START(SEQUENCE(com_escape), string);
     unused(ctx);
 
-    free_com(com_escape);
-    free_com(percent);
     return result;
 }
 
 ssize_t uchar(const char *string, void *ctx)
 {
-    combinator_t *com_uchar = choice(2, WRAP(PARSER(unreserved), PARSER(escape)));
+    STATIC_CHOICE(com_uchar, PARSER(unreserved), PARSER(escape));
 
-    ssize_t result = COMBINATOR_START(com_uchar, string);
+    ssize_t result = NODE_START(CHOICE(com_uchar), string);
     unused(ctx);
 
-    free_com(com_uchar);
     return result;
 }
 
@@ -754,92 +965,77 @@ ssize_t pchar(const char *string, void *ctx)
 
 ssize_t fsegment(const char *string, void *ctx)
 {
-    combinator_t *many_pchar = many(WRAP(PARSER(pchar)), 1, -1);
+    STATIC_MANY(many_pchar, PARSER(pchar), 1, -1);
 
-    ssize_t result = COMBINATOR_START(many_pchar, string);
+    ssize_t result = NODE_START(MANY(many_pchar), string);
     unused(ctx);
 
-    free_com(many_pchar);
     return result;
 }
 
 ssize_t segment(const char *string, void *ctx)
 {
-    combinator_t *many_pchar = many(WRAP(PARSER(pchar)), 0, -1);
+    STATIC_MANY(many_pchar, PARSER(pchar), 0, -1);
 
-    ssize_t result = COMBINATOR_START(many_pchar, string);
+    ssize_t result = NODE_START(MANY(many_pchar), string);
     unused(ctx);
 
-    free_com(many_pchar);
     return result;
 }
 
 ssize_t path(const char *string, void *ctx)
 {
-    combinator_t *forward_slash = literal("/");
+    STATIC_LITERAL(forward_slash, "/");
 
-    combinator_t *slash_segment       = sequence(2, WRAP(COMBINATOR(forward_slash), PARSER(segment)));
-    combinator_t *many_slash_segments = many(WRAP(COMBINATOR(slash_segment)), 0, -1);
+    STATIC_SEQUENCE(slash_segment, LITERAL(forward_slash), PARSER(segment));
+    STATIC_MANY(many_slash_segments, SEQUENCE(slash_segment), 0, -1);
 
-    combinator_t *com_path = sequence(2, WRAP(PARSER(fsegment), COMBINATOR(many_slash_segments)));
+    STATIC_SEQUENCE(com_path, PARSER(fsegment), MANY(many_slash_segments));
 
-    ssize_t result = COMBINATOR_START(com_path, string);
+    ssize_t result = NODE_START(SEQUENCE(com_path), string);
     unused(ctx);
 
-    free_com(com_path);
-    free_com(many_slash_segments);
-    free_com(slash_segment);
-    free_com(forward_slash);
     return result;
 }
 
 ssize_t param(const char *string, void *ctx)
 {
-    combinator_t *forward_slash = literal("/");
+    STATIC_LITERAL(forward_slash, "/");
 
-    combinator_t *com_pchar_slash_choice = choice(2, WRAP(PARSER(pchar), COMBINATOR(forward_slash)));
+    STATIC_CHOICE(com_pchar_slash_choice, PARSER(pchar), LITERAL(forward_slash));
 
-    combinator_t *com_many_pchar_slash_choice = many(WRAP(COMBINATOR(com_pchar_slash_choice)), 0, -1);
+    STATIC_MANY(com_many_pchar_slash_choice, CHOICE(com_pchar_slash_choice), 0, -1);
 
-    ssize_t result = COMBINATOR_START(com_many_pchar_slash_choice, string);
+    ssize_t result = NODE_START(MANY(com_many_pchar_slash_choice), string);
     unused(ctx);
 
-    free_com(com_many_pchar_slash_choice);
-    free_com(com_pchar_slash_choice);
-    free_com(forward_slash);
     return result;
 }
 
 ssize_t params(const char *string, void *ctx)
 {
-    combinator_t *semi = literal(";");
+    STATIC_LITERAL(semi, ";");
 
-    combinator_t *com_semi_param       = sequence(2, WRAP(COMBINATOR(semi), PARSER(param)));
-    combinator_t *com_many_semi_params = many(WRAP(COMBINATOR(com_semi_param)), 0, -1);
+    STATIC_SEQUENCE(com_semi_param, LITERAL(semi), PARSER(param));
+    STATIC_MANY(com_many_semi_params, SEQUENCE(com_semi_param), 0, -1);
 
-    combinator_t *com_params = sequence(2, WRAP(PARSER(param), COMBINATOR(com_many_semi_params)));
+    STATIC_SEQUENCE(com_params, PARSER(param), MANY(com_many_semi_params));
 
-    ssize_t result = COMBINATOR_START(com_params, string);
+    ssize_t result = NODE_START(SEQUENCE(com_params), string);
     unused(ctx);
 
-    free_com(com_params);
-    free_com(com_many_semi_params);
-    free_com(com_semi_param);
-    free_com(semi);
     return result;
 }
 
 ssize_t query(const char *string, void *ctx)
 {
-    combinator_t *com_uchar_or_reserved = choice(2, WRAP(PARSER(uchar), PARSER(reserved)));
+    STATIC_CHOICE(com_uchar_or_reserved, PARSER(uchar), PARSER(reserved));
 
-    combinator_t *com_query = many(WRAP(COMBINATOR(com_uchar_or_reserved)), 0, -1);
+    STATIC_MANY(com_query, CHOICE(com_uchar_or_reserved), 0, -1);
 
-    ssize_t result = COMBINATOR_START(com_query, string);
+    ssize_t result = NODE_START(MANY(com_query), string);
     unused(ctx);
 
-    free_com(com_query);
-    free_com(com_uchar_or_reserved);
     return result;
 }
 
@@ -850,456 +1046,352 @@ ssize_t fragment(const char *string, void *ctx)
 
 ssize_t scheme(const char *string, void *ctx)
 {
-    combinator_t *plus  = literal("+");
-    combinator_t *minus = literal("-");
-    combinator_t *dot   = literal(".");
+    STATIC_LITERAL(plus, "+");
+    STATIC_LITERAL(minus, "-");
+    STATIC_LITERAL(dot, ".");
 
-    combinator_t *com_choice = choice(5, WRAP(PARSER(alpha), PARSER(digit), COMBINATOR(plus), COMBINATOR(minus), COMBINATOR(dot)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_CHOICE(com_choice, PARSER(alpha), PARSER(digit), LITERAL(plus), LITERAL(minus), LITERAL(dot));
 
-    combinator_t *com_scheme = many(WRAP(COMBINATOR(com_choice)), 1, -1);
+    STATIC_MANY(com_scheme, CHOICE(com_choice), 1, -1);
 
-    ssize_t result = COMBINATOR_START(com_scheme, string);
+    ssize_t result = NODE_START(MANY(com_scheme), string);
     unused(ctx);
 
-    free_com(com_scheme);
-    free_com(com_choice);
-    free_com(dot);
-    free_com(minus);
-    free_com(plus);
     return result;
 }
 
 ssize_t net_loc(const char *string, void *ctx)
 {
-    combinator_t *question_mark = literal("?");
-    combinator_t *semi          = literal(";");
+    STATIC_LITERAL(question_mark, "?");
+    STATIC_LITERAL(semi, ";");
 
-    combinator_t *com_choice = choice(3, WRAP(PARSER(pchar), COMBINATOR(semi), COMBINATOR(question_mark)));
+    STATIC_CHOICE(com_choice, PARSER(pchar), LITERAL(semi), LITERAL(question_mark));
 
-    combinator_t *com_net_loc = many(WRAP(COMBINATOR(com_choice)), 0, -1);
+    STATIC_MANY(com_net_loc, CHOICE(com_choice), 0, -1);
 
-    ssize_t result = COMBINATOR_START(com_net_loc, string);
+    ssize_t result = NODE_START(MANY(com_net_loc), string);
     unused(ctx);
 
-    free_com(com_net_loc);
-    free_com(com_choice);
-    free_com(semi);
-    free_com(question_mark);
     return result;
 }
 
 ssize_t rel_path(const char *string, void *ctx)
 {
-    combinator_t *question_mark = literal("?");
-    combinator_t *semi          = literal(";");
+    STATIC_LITERAL(question_mark, "?");
+    STATIC_LITERAL(semi, ";");
 
-    combinator_t *com_path                    = optional(WRAP(PARSER(path)));
-    combinator_t *com_semi_params             = sequence(2, WRAP(COMBINATOR(semi), PARSER(params)));
-    combinator_t *com_optional_semi_params    = optional(WRAP(COMBINATOR(com_semi_params)));
-    combinator_t *com_question_query          = sequence(2, WRAP(COMBINATOR(question_mark), PARSER(query)));
-    combinator_t *com_optional_question_query = optional(WRAP(COMBINATOR(com_question_query)));
+    STATIC_OPTIONAL(com_path, PARSER(path));
+    STATIC_SEQUENCE(com_semi_params, LITERAL(semi), PARSER(params));
+    STATIC_OPTIONAL(com_optional_semi_params, SEQUENCE(com_semi_params));
+    STATIC_SEQUENCE(com_question_query, LITERAL(question_mark), PARSER(query));
+    STATIC_OPTIONAL(com_optional_question_query, SEQUENCE(com_question_query));
 
-    combinator_t *com_rel_path = sequence(3, WRAP(COMBINATOR(com_path), COMBINATOR(com_optional_semi_params), COMBINATOR(com_optional_question_query)));
+    STATIC_SEQUENCE(com_rel_path, OPTIONAL(com_path), OPTIONAL(com_optional_semi_params), OPTIONAL(com_optional_question_query));
 
-    ssize_t result = COMBINATOR_START(com_rel_path, string);
+    ssize_t result = NODE_START(SEQUENCE(com_rel_path), string);
     unused(ctx);
 
-    free_com(com_rel_path);
-    free_com(com_optional_question_query);
-    free_com(com_question_query);
-    free_com(com_optional_semi_params);
-    free_com(com_semi_params);
-    free_com(com_path);
-    free_com(semi);
-    free_com(question_mark);
     return result;
 }
 
 ssize_t abs_path(const char *string, void *ctx)
 {
-    combinator_t *semi = literal("/");
+    STATIC_LITERAL(semi, "/");
 
-    combinator_t *com_abs_path = sequence(2, WRAP(COMBINATOR(semi), PARSER(rel_path)));
+    STATIC_SEQUENCE(com_abs_path, LITERAL(semi), PARSER(rel_path));
 
-    ssize_t result = COMBINATOR_START(com_abs_path, string);
+    ssize_t result = NODE_START(SEQUENCE(com_abs_path), string);
     unused(ctx);
 
-    free_com(com_abs_path);
-    free_com(semi);
     return result;
 }
 
 ssize_t net_path(const char *string, void *ctx)
 {
-    combinator_t *dbl_forward = literal("//");
+    STATIC_LITERAL(dbl_forward, "//");
 
-    combinator_t *com_optional_abs_path = optional(WRAP(PARSER(abs_path)));
+    STATIC_OPTIONAL(com_optional_abs_path, PARSER(abs_path));
 
-    combinator_t *com_net_path = sequence(3, WRAP(COMBINATOR(dbl_forward), PARSER(net_loc), COMBINATOR(com_optional_abs_path)));
+    STATIC_SEQUENCE(com_net_path, LITERAL(dbl_forward), PARSER(net_loc), OPTIONAL(com_optional_abs_path));
 
-    ssize_t result = COMBINATOR_START(com_net_path, string);
+    ssize_t result = NODE_START(SEQUENCE(com_net_path), string);
     unused(ctx);
 
-    free_com(com_net_path);
-    free_com(com_optional_abs_path);
-    free_com(dbl_forward);
     return result;
 }
 
 ssize_t relative_uri(const char *string, void *ctx)
 {
-    combinator_t *com_relative_uri = choice(3, WRAP(PARSER(net_path), PARSER(abs_path), PARSER(rel_path)));
+    STATIC_CHOICE(com_relative_uri, PARSER(net_path), PARSER(abs_path), PARSER(rel_path));
 
-    ssize_t result = COMBINATOR_START(com_relative_uri, string);
+    ssize_t result = NODE_START(CHOICE(com_relative_uri), string);
     unused(ctx);
 
-    free_com(com_relative_uri);
     return result;
 }
 
 ssize_t absolute_uri(const char *string, void *ctx)
 {
-    combinator_t *colon = literal(":");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_uchar_reserved_choice       = choice(2, WRAP(PARSER(uchar), PARSER(reserved)));
-    combinator_t *com_many_uchar_reserved_choices = many(WRAP(COMBINATOR(com_uchar_reserved_choice)), 0, -1);
+    STATIC_CHOICE(com_uchar_reserved_choice, PARSER(uchar), PARSER(reserved));
+    STATIC_MANY(com_many_uchar_reserved_choices, CHOICE(com_uchar_reserved_choice), 0, -1);
 
-    combinator_t *com_absolute_uri = sequence(3, WRAP(PARSER(scheme), COMBINATOR(colon), COMBINATOR(com_many_uchar_reserved_choices)));
+    STATIC_SEQUENCE(com_absolute_uri, PARSER(scheme), LITERAL(colon), MANY(com_many_uchar_reserved_choices));
 
-    ssize_t result = COMBINATOR_START(com_absolute_uri, string);
+    ssize_t result = NODE_START(SEQUENCE(com_absolute_uri), string);
     unused(ctx);
 
-    free_com(com_absolute_uri);
-    free_com(com_many_uchar_reserved_choices);
-    free_com(com_uchar_reserved_choice);
-    free_com(colon);
     return result;
 }
 
 ssize_t uri(const char *string, void *ctx)
 {
-    combinator_t *hash = literal("#");
+    STATIC_LITERAL(hash, "#");
 
-    combinator_t *com_abs_rel_choice         = choice(2, WRAP(PARSER(absolute_uri), PARSER(relative_uri)));
-    combinator_t *com_hash_fragment          = sequence(2, WRAP(COMBINATOR(hash), PARSER(fragment)));
-    combinator_t *com_optional_hash_fragment = optional(WRAP(COMBINATOR(com_hash_fragment)));
+    STATIC_CHOICE(com_abs_rel_choice, PARSER(absolute_uri), PARSER(relative_uri));
+    STATIC_SEQUENCE(com_hash_fragment, LITERAL(hash), PARSER(fragment));
+    STATIC_OPTIONAL(com_optional_hash_fragment, SEQUENCE(com_hash_fragment));
 
-    combinator_t *com_uri = sequence(2, WRAP(COMBINATOR(com_abs_rel_choice), COMBINATOR(com_optional_hash_fragment)));
+    STATIC_SEQUENCE(com_uri, CHOICE(com_abs_rel_choice), OPTIONAL(com_optional_hash_fragment));
 
-    ssize_t result = COMBINATOR_START(com_uri, string);
+    ssize_t result = NODE_START(SEQUENCE(com_uri), string);
     unused(ctx);
 
-    free_com(com_uri);
-    free_com(com_optional_hash_fragment);
-    free_com(com_hash_fragment);
-    free_com(com_abs_rel_choice);
-    free_com(hash);
     return result;
 }
 
 ssize_t month(const char *string, void *ctx)
 {
-    combinator_t *jan = literal("Jan");
-    combinator_t *feb = literal("Feb");
-    combinator_t *mar = literal("Mar");
-    combinator_t *apr = literal("Apr");
-    combinator_t *may = literal("May");
-    combinator_t *jun = literal("Jun");
-    combinator_t *jul = literal("Jul");
-    combinator_t *aug = literal("Aug");
-    combinator_t *sep = literal("Sep");
-    combinator_t *oct = literal("Oct");
-    combinator_t *nov = literal("Nov");
-    combinator_t *dec = literal("Dec");
-
-    combinator_t *com_month = choice(12,    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-                                     WRAP(COMBINATOR(jan), COMBINATOR(feb), COMBINATOR(mar), COMBINATOR(apr), COMBINATOR(may), COMBINATOR(jun), COMBINATOR(jul), COMBINATOR(aug), COMBINATOR(sep), COMBINATOR(oct), COMBINATOR(nov), COMBINATOR(dec)));
-
-    ssize_t result = COMBINATOR_START(com_month, string);
-    unused(ctx);
-
-    free_com(com_month);
-    free_com(jan);
-    free_com(feb);
-    free_com(mar);
-    free_com(apr);
-    free_com(may);
-    free_com(jun);
-    free_com(jul);
-    free_com(aug);
-    free_com(sep);
-    free_com(oct);
-    free_com(nov);
-    free_com(dec);
+    STATIC_LITERAL(jan, "Jan");
+    STATIC_LITERAL(feb, "Feb");
+    STATIC_LITERAL(mar, "Mar");
+    STATIC_LITERAL(apr, "Apr");
+    STATIC_LITERAL(may, "May");
+    STATIC_LITERAL(jun, "Jun");
+    STATIC_LITERAL(jul, "Jul");
+    STATIC_LITERAL(aug, "Aug");
+    STATIC_LITERAL(sep, "Sep");
+    STATIC_LITERAL(oct, "Oct");
+    STATIC_LITERAL(nov, "Nov");
+    STATIC_LITERAL(dec, "Dec");
+
+    STATIC_CHOICE(com_month, LITERAL(jan), LITERAL(feb), LITERAL(mar), LITERAL(apr), LITERAL(may), LITERAL(jun), LITERAL(jul), LITERAL(aug), LITERAL(sep), LITERAL(oct), LITERAL(nov), LITERAL(dec));
+
+    ssize_t result = NODE_START(CHOICE(com_month), string);
+    unused(ctx);
+
     return result;
 }
 
 ssize_t weekday(const char *string, void *ctx)
 {
-    combinator_t *mon = literal("Monday");
-    combinator_t *tue = literal("Tuesday");
-    combinator_t *wed = literal("Wednesday");
-    combinator_t *thu = literal("Thursday");
-    combinator_t *fri = literal("Friday");
-    combinator_t *sat = literal("Saturday");
-    combinator_t *sun = literal("Sunday");
+    STATIC_LITERAL(mon, "Monday");
+    STATIC_LITERAL(tue, "Tuesday");
+    STATIC_LITERAL(wed, "Wednesday");
+    STATIC_LITERAL(thu, "Thursday");
+    STATIC_LITERAL(fri, "Friday");
+    STATIC_LITERAL(sat, "Saturday");
+    STATIC_LITERAL(sun, "Sunday");
 
-    combinator_t *com_weekday = choice(7, WRAP(COMBINATOR(mon), COMBINATOR(tue), COMBINATOR(wed), COMBINATOR(thu), COMBINATOR(fri), COMBINATOR(sat), COMBINATOR(sun)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_CHOICE(com_weekday, LITERAL(mon), LITERAL(tue), LITERAL(wed), LITERAL(thu), LITERAL(fri), LITERAL(sat), LITERAL(sun));
 
-    ssize_t result = COMBINATOR_START(com_weekday, string);
+    ssize_t result = NODE_START(CHOICE(com_weekday), string);
     unused(ctx);
 
-    free_com(com_weekday);
-    free_com(mon);
-    free_com(tue);
-    free_com(wed);
-    free_com(thu);
-    free_com(fri);
-    free_com(sat);
-    free_com(sun);
     return result;
 }
 
 ssize_t wkday(const char *string, void *ctx)
 {
-    combinator_t *mon = literal("Mon");
-    combinator_t *tue = literal("Tue");
-    combinator_t *wed = literal("Wed");
-    combinator_t *thu = literal("Thu");
-    combinator_t *fri = literal("Fri");
-    combinator_t *sat = literal("Sat");
-    combinator_t *sun = literal("Sun");
+    STATIC_LITERAL(mon, "Mon");
+    STATIC_LITERAL(tue, "Tue");
+    STATIC_LITERAL(wed, "Wed");
+    STATIC_LITERAL(thu, "Thu");
+    STATIC_LITERAL(fri, "Fri");
+    STATIC_LITERAL(sat, "Sat");
+    STATIC_LITERAL(sun, "Sun");
 
-    combinator_t *com_wkday = choice(7, WRAP(COMBINATOR(mon), COMBINATOR(tue), COMBINATOR(wed), COMBINATOR(thu), COMBINATOR(fri), COMBINATOR(sat), COMBINATOR(sun)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_CHOICE(com_wkday, LITERAL(mon), LITERAL(tue), LITERAL(wed), LITERAL(thu), LITERAL(fri), LITERAL(sat), LITERAL(sun));
 
-    ssize_t result = COMBINATOR_START(com_wkday, string);
+    ssize_t result = NODE_START(CHOICE(com_wkday), string);
     unused(ctx);
 
-    free_com(com_wkday);
-    free_com(mon);
-    free_com(tue);
-    free_com(wed);
-    free_com(thu);
-    free_com(fri);
-    free_com(sat);
-    free_com(sun);
     return result;
 }
 
 ssize_t time(const char *string, void *ctx)
 {
-    combinator_t *colon     = literal(":");
-    combinator_t *dbl_digit = many(WRAP(PARSER(digit)), 2, 2);
+    STATIC_LITERAL(colon, ":");
+    STATIC_MANY(dbl_digit, PARSER(digit), 2, 2);
 
-    combinator_t *com_time = sequence(5, WRAP(COMBINATOR(dbl_digit), COMBINATOR(colon), COMBINATOR(dbl_digit), COMBINATOR(colon), COMBINATOR(dbl_digit)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_time, MANY(dbl_digit), LITERAL(colon), MANY(dbl_digit), LITERAL(colon), MANY(dbl_digit));
 
-    ssize_t result = COMBINATOR_START(com_time, string);
+    ssize_t result = NODE_START(SEQUENCE(com_time), string);
     unused(ctx);
 
-    free_com(com_time);
-    free_com(dbl_digit);
-    free_com(colon);
     return result;
 }
 
 ssize_t date3(const char *string, void *ctx)
 {
-    combinator_t *digit1 = many(WRAP(PARSER(digit)), 1, 1);
-    combinator_t *digit2 = many(WRAP(PARSER(digit)), 2, 2);
+    STATIC_MANY(digit1, PARSER(digit), 1, 1);
+    STATIC_MANY(digit2, PARSER(digit), 2, 2);
 
-    combinator_t *com_sp_digit1 = sequence(2, WRAP(PARSER(sp), COMBINATOR(digit1)));
-    combinator_t *com_day       = choice(2, WRAP(COMBINATOR(digit2), COMBINATOR(com_sp_digit1)));
+    STATIC_SEQUENCE(com_sp_digit1, PARSER(sp), MANY(digit1));
+    STATIC_CHOICE(com_day, MANY(digit2), SEQUENCE(com_sp_digit1));
 
-    combinator_t *com_date3 = sequence(3, WRAP(PARSER(month), PARSER(sp), COMBINATOR(com_day)));
+    STATIC_SEQUENCE(com_date3, PARSER(month), PARSER(sp), CHOICE(com_day));
 
-    ssize_t result = COMBINATOR_START(com_date3, string);
+    ssize_t result = NODE_START(SEQUENCE(com_date3), string);
     unused(ctx);
 
-    free_com(com_date3);
-    free_com(com_day);
-    free_com(com_sp_digit1);
-    free_com(digit2);
-    free_com(digit1);
     return result;
 }
 
 ssize_t date2(const char *string, void *ctx)
 {
-    combinator_t *digit2 = many(WRAP(PARSER(digit)), 2, 2);
-    combinator_t *hyphen = literal("-");
+    STATIC_MANY(digit2, PARSER(digit), 2, 2);
+    STATIC_LITERAL(hyphen, "-");
 
-    combinator_t *com_date2 = sequence(5, WRAP(COMBINATOR(digit2), COMBINATOR(hyphen), COMBINATOR(digit2), COMBINATOR(hyphen), COMBINATOR(digit2)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_date2, MANY(digit2), LITERAL(hyphen), MANY(digit2), LITERAL(hyphen), MANY(digit2));
 
-    ssize_t result = COMBINATOR_START(com_date2, string);
+    ssize_t result = NODE_START(SEQUENCE(com_date2), string);
     unused(ctx);
 
-    free_com(com_date2);
-    free_com(hyphen);
-    free_com(digit2);
     return result;
 }
 
 ssize_t date1(const char *string, void *ctx)
 {
-    combinator_t *digit2 = many(WRAP(PARSER(digit)), 2, 2);
-    combinator_t *digit4 = many(WRAP(PARSER(digit)), 4, 4);
+    STATIC_MANY(digit2, PARSER(digit), 2, 2);
+    STATIC_MANY(digit4, PARSER(digit), 4, 4);
 
-    combinator_t *com_date1 = sequence(5, WRAP(COMBINATOR(digit2), PARSER(sp), PARSER(month), PARSER(sp), COMBINATOR(digit4)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_date1, MANY(digit2), PARSER(sp), PARSER(month), PARSER(sp), MANY(digit4));
 
-    ssize_t result = COMBINATOR_START(com_date1, string);
+    ssize_t result = NODE_START(SEQUENCE(com_date1), string);
     unused(ctx);
 
-    free_com(com_date1);
-    free_com(digit4);
-    free_com(digit2);
     return result;
 }
 
 ssize_t asctime_date(const char *string, void *ctx)
 {
-    combinator_t *digit4 = many(WRAP(PARSER(digit)), 4, 4);
+    STATIC_MANY(digit4, PARSER(digit), 4, 4);
 
-    combinator_t *com_asctime_date = sequence(7, WRAP(PARSER(wkday), PARSER(sp), PARSER(date3), PARSER(sp), PARSER(time), PARSER(sp), COMBINATOR(digit4)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_asctime_date, PARSER(wkday), PARSER(sp), PARSER(date3), PARSER(sp), PARSER(time), PARSER(sp), MANY(digit4));
 
-    ssize_t result = COMBINATOR_START(com_asctime_date, string);
+    ssize_t result = NODE_START(SEQUENCE(com_asctime_date), string);
     unused(ctx);
 
-    free_com(com_asctime_date);
-    free_com(digit4);
     return result;
 }
 
 ssize_t rfc580_date(const char *string, void *ctx)
 {
-    combinator_t *comma = literal(",");
-    combinator_t *gmt   = literal("GMT");
+    STATIC_LITERAL(comma, ",");
+    STATIC_LITERAL(gmt, "GMT");
 
-    combinator_t *com_rfc580_date = sequence(8, WRAP(PARSER(weekday), COMBINATOR(comma), PARSER(sp), PARSER(date2), PARSER(sp), PARSER(time), PARSER(sp), COMBINATOR(gmt)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_rfc580_date, PARSER(weekday), LITERAL(comma), PARSER(sp), PARSER(date2), PARSER(sp), PARSER(time), PARSER(sp), LITERAL(gmt));
 
-    ssize_t result = COMBINATOR_START(com_rfc580_date, string);
+    ssize_t result = NODE_START(SEQUENCE(com_rfc580_date), string);
     unused(ctx);
 
-    free_com(com_rfc580_date);
-    free_com(gmt);
-    free_com(comma);
     return result;
 }
 
 ssize_t rfc1123_date(const char *string, void *ctx)
 {
-    combinator_t *comma = literal(",");
-    combinator_t *gmt   = literal("GMT");
+    STATIC_LITERAL(comma, ",");
+    STATIC_LITERAL(gmt, "GMT");
 
-    combinator_t *com_rfc580_date = sequence(8, WRAP(PARSER(wkday), COMBINATOR(comma), PARSER(sp), PARSER(date1), PARSER(sp), PARSER(time), PARSER(sp), COMBINATOR(gmt)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_rfc580_date, PARSER(wkday), LITERAL(comma), PARSER(sp), PARSER(date1), PARSER(sp), PARSER(time), PARSER(sp), LITERAL(gmt));
 
-    ssize_t result = COMBINATOR_START(com_rfc580_date, string);
+    ssize_t result = NODE_START(SEQUENCE(com_rfc580_date), string);
     unused(ctx);
 
-    free_com(com_rfc580_date);
-    free_com(gmt);
-    free_com(comma);
     return result;
 }
 
 ssize_t http_date(const char *string, void *ctx)
 {
-    combinator_t *com_http_date = choice(3, WRAP(PARSER(rfc1123_date), PARSER(rfc580_date), PARSER(asctime_date)));
+    STATIC_CHOICE(com_http_date, PARSER(rfc1123_date), PARSER(rfc580_date), PARSER(asctime_date));
 
-    ssize_t result = COMBINATOR_START(com_http_date, string);
+    ssize_t result = NODE_START(CHOICE(com_http_date), string);
     unused(ctx);
 
-    free_com(com_http_date);
     return result;
 }
 
 ssize_t date(const char *string, void *ctx)
 {
-    combinator_t *date  = literal("Date");
-    combinator_t *colon = literal(":");
+    STATIC_LITERAL(date, "Date");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
-    combinator_t *com_date     = sequence(4, WRAP(COMBINATOR(date), COMBINATOR(colon), COMBINATOR(com_many_lws), PARSER(http_date)));
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
+    STATIC_SEQUENCE(com_date, LITERAL(date), LITERAL(colon), MANY(com_many_lws), PARSER(http_date));
 
-    ssize_t result = COMBINATOR_START(com_date, string);
+    ssize_t result = NODE_START(SEQUENCE(com_date), string);
     unused(ctx);
 
-    free_com(com_date);
-    free_com(com_many_lws);
-    free_com(colon);
-    free_com(date);
     return result;
 }
 
 ssize_t extension_pragma(const char *string, void *ctx)
 {
-    combinator_t *equal = literal("=");
+    STATIC_LITERAL(equal, "=");
 
-    combinator_t *com_equal_word          = sequence(2, WRAP(COMBINATOR(equal)));
-    combinator_t *com_optional_equal_word = optional(WRAP(COMBINATOR(com_equal_word)));
+    STATIC_SEQUENCE(com_equal_word, LITERAL(equal), PARSER(word));
+    STATIC_OPTIONAL(com_optional_equal_word, SEQUENCE(com_equal_word));
 
-    combinator_t *com_extension_pragma = sequence(2, WRAP(PARSER(token), COMBINATOR(com_optional_equal_word)));
+    STATIC_SEQUENCE(com_extension_pragma, PARSER(token), OPTIONAL(com_optional_equal_word));
 
-    ssize_t result = COMBINATOR_START(com_extension_pragma, string);
+    ssize_t result = NODE_START(SEQUENCE(com_extension_pragma), string);
     unused(ctx);
 
-    free_com(com_extension_pragma);
-    free_com(com_optional_equal_word);
-    free_com(com_equal_word);
-    free_com(equal);
     return result;
 }
 
 ssize_t pragma_directive(const char *string, void *ctx)
 {
-    combinator_t *no_cache = literal("no-cache");
+    STATIC_LITERAL(no_cache, "no-cache");
 
-    combinator_t *com_pragma_directive = choice(2, WRAP(COMBINATOR(no_cache), PARSER(extension_pragma)));
+    STATIC_CHOICE(com_pragma_directive, LITERAL(no_cache), PARSER(extension_pragma));
 
-    ssize_t result = COMBINATOR_START(com_pragma_directive, string);
+    ssize_t result = NODE_START(CHOICE(com_pragma_directive), string);
     unused(ctx);
 
-    free_com(com_pragma_directive);
-    free_com(no_cache);
     return result;
 }
 
 ssize_t pragma(const char *string, void *ctx)
 {
-    combinator_t *literal_pragma = literal("pragma");
-    combinator_t *colon          = literal(":");
+    STATIC_LITERAL(literal_pragma, "pragma");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_pragma_directive_list = list(WRAP(PARSER(pragma_directive)), 1, -1);
-    combinator_t *com_many_lws              = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_LIST(com_pragma_directive_list, PARSER(pragma_directive), 1, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_pragma = sequence(4, WRAP(COMBINATOR(literal_pragma), COMBINATOR(colon), COMBINATOR(com_many_lws), COMBINATOR(com_pragma_directive_list)));
+    STATIC_SEQUENCE(com_pragma, LITERAL(literal_pragma), LITERAL(colon), MANY(com_many_lws), LIST(com_pragma_directive_list));
 
-    ssize_t result = COMBINATOR_START(com_pragma, string);
+    ssize_t result = NODE_START(SEQUENCE(com_pragma), string);
     unused(ctx);
 
-    free_com(com_pragma);
-    free_com(com_many_lws);
-    free_com(com_pragma_directive_list);
-    free_com(colon);
-    free_com(literal_pragma);
     return result;
 }
 
 ssize_t userid_password(const char *string, void *ctx)
 {
-    combinator_t *colon = literal(":");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_optional_token = optional(WRAP(PARSER(token)));
-    combinator_t *com_many_text      = many(WRAP(PARSER(text)), 0, -1);
+    STATIC_OPTIONAL(com_optional_token, PARSER(token));
+    STATIC_MANY(com_many_text, PARSER(text), 0, -1);
 
-    combinator_t *com_userid_password = sequence(3, WRAP(COMBINATOR(com_optional_token), COMBINATOR(colon), COMBINATOR(com_many_text)));
+    STATIC_SEQUENCE(com_userid_password, OPTIONAL(com_optional_token), LITERAL(colon), MANY(com_many_text));
 
-    ssize_t result = COMBINATOR_START(com_userid_password, string);
+    ssize_t result = NODE_START(SEQUENCE(com_userid_password), string);
     unused(ctx);
 
-    free_com(com_userid_password);
-    free_com(com_many_text);
-    free_com(com_optional_token);
-    free_com(colon);
     return result;
 }
 
@@ -1310,33 +1402,27 @@ ssize_t auth_scheme(const char *string, void *ctx)
 
 ssize_t auth_param(const char *string, void *ctx)
 {
-    combinator_t *equal = literal("=");
+    STATIC_LITERAL(equal, "=");
 
-    combinator_t *com_auth_param = sequence(3, WRAP(PARSER(token), COMBINATOR(equal), PARSER(quoted_string)));
+    STATIC_SEQUENCE(com_auth_param, PARSER(token), LITERAL(equal), PARSER(quoted_string));
 
-    ssize_t result = COMBINATOR_START(com_auth_param, string);
+    ssize_t result = NODE_START(SEQUENCE(com_auth_param), string);
     unused(ctx);
 
-    free_com(com_auth_param);
-    free_com(equal);
     return result;
 }
 
 ssize_t product(const char *string, void *ctx)
 {
-    combinator_t *forward_slash = literal("/");
+    STATIC_LITERAL(forward_slash, "/");
 
-    combinator_t *com_forward_product_version          = sequence(2, WRAP(COMBINATOR(forward_slash), PARSER(product_version)));
-    combinator_t *com_optional_forward_product_version = optional(WRAP(COMBINATOR(com_forward_product_version)));
-    combinator_t *com_product                          = sequence(2, WRAP(PARSER(token), COMBINATOR(com_optional_forward_product_version)));
+    STATIC_SEQUENCE(com_forward_product_version, LITERAL(forward_slash), PARSER(product_version));
+    STATIC_OPTIONAL(com_optional_forward_product_version, SEQUENCE(com_forward_product_version));
+    STATIC_SEQUENCE(com_product, PARSER(token), OPTIONAL(com_optional_forward_product_version));
 
-    ssize_t result = COMBINATOR_START(com_product, string);
+    ssize_t result = NODE_START(SEQUENCE(com_product), string);
     unused(ctx);
 
-    free_com(com_product);
-    free_com(com_optional_forward_product_version);
-    free_com(com_forward_product_version);
-    free_com(forward_slash);
     return result;
 }
 
@@ -1361,113 +1447,89 @@ ssize_t ctext(const char *string, void *ctx)
 ssize_t comment(const char *string, void *ctx)
 {
     // "(" *( ctext | comment ) ")"
-    combinator_t *lparen = literal("(");
-    combinator_t *rparen = literal(")");
+    STATIC_LITERAL(lparen, "(");
+    STATIC_LITERAL(rparen, ")");
 
-    combinator_t *com_ctext_comment      = choice(2, WRAP(PARSER(ctext), PARSER(comment)));
-    combinator_t *com_many_ctext_comment = many(WRAP(COMBINATOR(com_ctext_comment)), 0, -1);
+    STATIC_CHOICE(com_ctext_comment, PARSER(ctext), PARSER(comment));
+    STATIC_MANY(com_many_ctext_comment, CHOICE(com_ctext_comment), 0, -1);
 
-    combinator_t *com_comment = sequence(3, WRAP(COMBINATOR(lparen), COMBINATOR(com_many_ctext_comment), COMBINATOR(rparen)));
+    STATIC_SEQUENCE(com_comment, LITERAL(lparen), MANY(com_many_ctext_comment), LITERAL(rparen));
 
-    ssize_t result = COMBINATOR_START(com_comment, string);
+    ssize_t result = NODE_START(SEQUENCE(com_comment), string);
     unused(ctx);
 
-    free_com(com_comment);
-    free_com(com_many_ctext_comment);
-    free_com(com_ctext_comment);
-    free_com(rparen);
-    free_com(lparen);
     return result;
 }
 
 ssize_t if_modified_since(const char *string, void *ctx)
 {
-    combinator_t *literal_if_modified_since = literal("If-Modified-Since");
-    combinator_t *colon                     = literal(":");
+    STATIC_LITERAL(literal_if_modified_since, "If-Modified-Since");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_if_modified_since = sequence(4, WRAP(COMBINATOR(literal_if_modified_since), COMBINATOR(colon), COMBINATOR(com_many_lws), PARSER(http_date)));
+    STATIC_SEQUENCE(com_if_modified_since, LITERAL(literal_if_modified_since), LITERAL(colon), MANY(com_many_lws), PARSER(http_date));
 
-    ssize_t result = COMBINATOR_START(com_if_modified_since, string);
+    ssize_t result = NODE_START(SEQUENCE(com_if_modified_since), string);
     unused(ctx);
 
-    free_com(com_if_modified_since);
-    free_com(com_many_lws);
-    free_com(colon);
-    free_com(literal_if_modified_since);
     return result;
 }
 
 ssize_t referer(const char *string, void *ctx)
 {
-    combinator_t *literal_referer = literal("Referer");
-    combinator_t *colon           = literal(":");
+    STATIC_LITERAL(literal_referer, "Referer");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_absolute_uri_relative_uri_choice = choice(2, WRAP(PARSER(absolute_uri), PARSER(relative_uri)));
-    combinator_t *com_many_lws                         = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_CHOICE(com_absolute_uri_relative_uri_choice, PARSER(absolute_uri), PARSER(relative_uri));
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_referer = sequence(4, WRAP(COMBINATOR(literal_referer), COMBINATOR(colon), COMBINATOR(com_many_lws), COMBINATOR(com_absolute_uri_relative_uri_choice)));
+    STATIC_SEQUENCE(com_referer, LITERAL(literal_referer), LITERAL(colon), MANY(com_many_lws), CHOICE(com_absolute_uri_relative_uri_choice));
 
-    ssize_t result = COMBINATOR_START(com_referer, string);
+    ssize_t result = NODE_START(SEQUENCE(com_referer), string);
     unused(ctx);
 
-    free_com(com_referer);
-    free_com(com_many_lws);
-    free_com(com_absolute_uri_relative_uri_choice);
-    free_com(colon);
-    free_com(literal_referer);
     return result;
 }
 
 ssize_t user_agent(const char *string, void *ctx)
 {
-    combinator_t *literal_user_agent = literal("Referer");
-    combinator_t *colon              = literal(":");
+    STATIC_LITERAL(literal_user_agent, "Referer");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_product_comment_choice       = choice(2, WRAP(PARSER(product), PARSER(comment)));
-    combinator_t *com_many_product_comment_choices = many(WRAP(COMBINATOR(com_product_comment_choice)), 1, -1);
-    combinator_t *com_many_lws                     = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_CHOICE(com_product_comment_choice, PARSER(product), PARSER(comment));
+    STATIC_MANY(com_many_product_comment_choices, CHOICE(com_product_comment_choice), 1, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_user_agent = sequence(4, WRAP(COMBINATOR(literal_user_agent), COMBINATOR(colon), COMBINATOR(com_many_lws), COMBINATOR(com_product_comment_choice)));
+    STATIC_SEQUENCE(com_user_agent, LITERAL(literal_user_agent), LITERAL(colon), MANY(com_many_lws), MANY(com_many_product_comment_choices));
 
-    ssize_t result = COMBINATOR_START(com_user_agent, string);
+    ssize_t result = NODE_START(SEQUENCE(com_user_agent), string);
     unused(ctx);
 
-    free_com(com_user_agent);
-    free_com(com_many_lws);
-    free_com(com_many_product_comment_choices);
-    free_com(com_product_comment_choice);
-    free_com(colon);
-    free_com(literal_user_agent);
     return result;
 }
 
 ssize_t field_content(const char *string, void *ctx)
 {
-    combinator_t *com_choice = choice(4, WRAP(PARSER(text), PARSER(token), PARSER(tspecials), PARSER(quoted_string)));
+    STATIC_CHOICE(com_choice, PARSER(text), PARSER(token), PARSER(tspecials), PARSER(quoted_string));
 
-    combinator_t *com_field_content = many(WRAP(COMBINATOR(com_choice)), 0, -1);
+    STATIC_MANY(com_field_content, CHOICE(com_choice), 0, -1);
 
-    ssize_t result = COMBINATOR_START(com_field_content, string);
+    ssize_t result = NODE_START(MANY(com_field_content), string);
     unused(ctx);
 
-    free_com(com_field_content);
-    free_com(com_choice);
     return result;
 }
 
 ssize_t field_value(const char *string, void *ctx)
 {
-    combinator_t *com_choice = choice(2, WRAP(PARSER(field_content), PARSER(lws)));
+    STATIC_CHOICE(com_choice, PARSER(field_content), PARSER(lws));
 
-    combinator_t *com_field_value = many(WRAP(COMBINATOR(com_choice)), 0, -1);
+    STATIC_MANY(com_field_value, CHOICE(com_choice), 0, -1);
 
-    ssize_t result = COMBINATOR_START(com_field_value, string);
+    ssize_t result = NODE_START(MANY(com_field_value), string);
     unused(ctx);
 
-    free_com(com_field_value);
-    free_com(com_choice);
     return result;
 }
 
@@ -1478,33 +1540,27 @@ ssize_t field_name(const char *string, void *ctx)
 
 ssize_t http_header(const char *string, void *ctx)
 {
-    combinator_t *colon = literal(":");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_optional_value = optional(WRAP(PARSER(field_value)));
-    combinator_t *com_http_header    = sequence(5, WRAP(PARSER(field_name), COMBINATOR(colon), PARSER(sp), COMBINATOR(com_optional_value), PARSER(crlf)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_OPTIONAL(com_optional_value, PARSER(field_value));
+    STATIC_SEQUENCE(com_http_header, PARSER(field_name), LITERAL(colon), PARSER(sp), OPTIONAL(com_optional_value), PARSER(crlf));
 
-    ssize_t result = COMBINATOR_START(com_http_header, string);
+    ssize_t result = NODE_START(SEQUENCE(com_http_header), string);
     unused(ctx);
 
-    free_com(com_http_header);
-    free_com(com_optional_value);
-    free_com(colon);
     return result;
 }
 
 ssize_t content_coding(const char *string, void *ctx)
 {
-    combinator_t *x_gzip     = literal("x-gzip");
-    combinator_t *x_compress = literal("x-compress");
+    STATIC_LITERAL(x_gzip, "x-gzip");
+    STATIC_LITERAL(x_compress, "x-compress");
 
-    combinator_t *com_content_coding = choice(3, WRAP(COMBINATOR(x_gzip), COMBINATOR(x_compress), PARSER(token)));
+    STATIC_CHOICE(com_content_coding, LITERAL(x_gzip), LITERAL(x_compress), PARSER(token));
 
-    ssize_t result = COMBINATOR_START(com_content_coding, string);
+    ssize_t result = NODE_START(CHOICE(com_content_coding), string);
     unused(ctx);
 
-    free_com(com_content_coding);
-    free_com(x_compress);
-    free_com(x_gzip);
     return result;
 }
 
@@ -1515,26 +1571,23 @@ ssize_t attribute(const char *string, void *ctx)
 
 ssize_t value(const char *string, void *ctx)
 {
-    combinator_t *com_value = choice(2, WRAP(PARSER(token), PARSER(quoted_string)));
+    STATIC_CHOICE(com_value, PARSER(token), PARSER(quoted_string));
 
-    ssize_t result = COMBINATOR_START(com_value, string);
+    ssize_t result = NODE_START(CHOICE(com_value), string);
     unused(ctx);
 
-    free_com(com_value);
     return result;
 }
 
 ssize_t parameter(const char *string, void *ctx)
 {
-    combinator_t *equal = literal("=");
+    STATIC_LITERAL(equal, "=");
 
-    combinator_t *com_parameter = sequence(3, WRAP(PARSER(attribute), COMBINATOR(equal), PARSER(value)));
+    STATIC_SEQUENCE(com_parameter, PARSER(attribute), LITERAL(equal), PARSER(value));
 
-    ssize_t result = COMBINATOR_START(com_parameter, string);
+    ssize_t result = NODE_START(SEQUENCE(com_parameter), string);
     unused(ctx);
 
-    free_com(com_parameter);
-    free_com(equal);
     return result;
 }
 
@@ -1550,186 +1603,145 @@ ssize_t subtype(const char *string, void *ctx)
 
 ssize_t media_type(const char *string, void *ctx)
 {
-    combinator_t *semi          = literal(";");
-    combinator_t *forward_slash = literal("/");
+    STATIC_LITERAL(semi, ";");
+    STATIC_LITERAL(forward_slash, "/");
 
-    combinator_t *com_semi_parameter       = sequence(2, WRAP(COMBINATOR(semi), PARSER(parameter)));
-    combinator_t *com_many_semi_parameters = many(WRAP(COMBINATOR(com_semi_parameter)), 0, -1);
+    STATIC_SEQUENCE(com_semi_parameter, LITERAL(semi), PARSER(parameter));
+    STATIC_MANY(com_many_semi_parameters, SEQUENCE(com_semi_parameter), 0, -1);
 
-    combinator_t *com_media_type = sequence(4, WRAP(PARSER(type), COMBINATOR(forward_slash), PARSER(subtype), COMBINATOR(com_many_semi_parameters)));
+    STATIC_SEQUENCE(com_media_type, PARSER(type), LITERAL(forward_slash), PARSER(subtype), MANY(com_many_semi_parameters));
 
-    ssize_t result = COMBINATOR_START(com_media_type, string);
+    ssize_t result = NODE_START(SEQUENCE(com_media_type), string);
     unused(ctx);
 
-    free_com(com_media_type);
-    free_com(com_many_semi_parameters);
-    free_com(com_semi_parameter);
-    free_com(forward_slash);
-    free_com(semi);
     return result;
 }
 
 ssize_t allow(const char *string, void *ctx)
 {
-    combinator_t *literal_allow = literal("Allow");
-    combinator_t *colon         = literal(":");
+    STATIC_LITERAL(literal_allow, "Allow");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_method_list = list(WRAP(PARSER(method)), 1, -1);
-    combinator_t *com_many_lws    = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_LIST(com_method_list, PARSER(method), 1, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_allow = sequence(4, WRAP(COMBINATOR(literal_allow), COMBINATOR(colon), COMBINATOR(com_many_lws), COMBINATOR(com_method_list)));
+    STATIC_SEQUENCE(com_allow, LITERAL(literal_allow), LITERAL(colon), MANY(com_many_lws), LIST(com_method_list));
 
-    ssize_t result = COMBINATOR_START(com_allow, string);
+    ssize_t result = NODE_START(SEQUENCE(com_allow), string);
     unused(ctx);
 
-    free_com(com_allow);
-    free_com(com_many_lws);
-    free_com(com_method_list);
-    free_com(colon);
-    free_com(literal_allow);
     return result;
 }
 
 ssize_t content_encoding(const char *string, void *ctx)
 {
-    combinator_t *literal_content_encoding = literal("Content-Encoding");
-    combinator_t *colon                    = literal(":");
+    STATIC_LITERAL(literal_content_encoding, "Content-Encoding");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_content_encoding = sequence(4, WRAP(COMBINATOR(literal_content_encoding), COMBINATOR(colon), COMBINATOR(com_many_lws), PARSER(content_coding)));
+    STATIC_SEQUENCE(com_content_encoding, LITERAL(literal_content_encoding), LITERAL(colon), MANY(com_many_lws), PARSER(content_coding));
 
-    ssize_t result = COMBINATOR_START(com_content_encoding, string);
+    ssize_t result = NODE_START(SEQUENCE(com_content_encoding), string);
     unused(ctx);
 
-    free_com(com_content_encoding);
-    free_com(com_many_lws);
-    free_com(colon);
-    free_com(literal_content_encoding);
     return result;
 }
 
 ssize_t content_length(const char *string, void *ctx)
 {
-    combinator_t *literal_content_length = literal("Content-Length");
-    combinator_t *colon                  = literal(":");
-    combinator_t *one_or_more_digits     = many(WRAP(PARSER(digit)), 1, -1);
+    STATIC_LITERAL(literal_content_length, "Content-Length");
+    STATIC_LITERAL(colon, ":");
+    STATIC_MANY(one_or_more_digits, PARSER(digit), 1, -1);
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_content_length = sequence(4, WRAP(COMBINATOR(literal_content_length), COMBINATOR(colon), COMBINATOR(com_many_lws), COMBINATOR(one_or_more_digits)));
+    STATIC_SEQUENCE(com_content_length, LITERAL(literal_content_length), LITERAL(colon), MANY(com_many_lws), MANY(one_or_more_digits));
 
-    ssize_t result = COMBINATOR_START(com_content_length, string);
+    ssize_t result = NODE_START(SEQUENCE(com_content_length), string);
     unused(ctx);
 
-    free_com(com_content_length);
-    free_com(com_many_lws);
-    free_com(one_or_more_digits);
-    free_com(colon);
-    free_com(literal_content_length);
     return result;
 }
 
 ssize_t content_type(const char *string, void *ctx)
 {
-    combinator_t *literal_content_type = literal("Content-Type");
-    combinator_t *colon                = literal(":");
+    STATIC_LITERAL(literal_content_type, "Content-Type");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_content_type = sequence(4, WRAP(COMBINATOR(literal_content_type), COMBINATOR(colon), COMBINATOR(com_many_lws), PARSER(media_type)));
+    STATIC_SEQUENCE(com_content_type, LITERAL(literal_content_type), LITERAL(colon), MANY(com_many_lws), PARSER(media_type));
 
-    ssize_t result = COMBINATOR_START(com_content_type, string);
+    ssize_t result = NODE_START(SEQUENCE(com_content_type), string);
     unused(ctx);
 
-    free_com(com_content_type);
-    free_com(com_many_lws);
-    free_com(colon);
-    free_com(literal_content_type);
     return result;
 }
 
 ssize_t expires(const char *string, void *ctx)
 {
-    combinator_t *literal_expires = literal("Expires");
-    combinator_t *colon           = literal(":");
+    STATIC_LITERAL(literal_expires, "Expires");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_expires = sequence(4, WRAP(COMBINATOR(literal_expires), COMBINATOR(colon), COMBINATOR(com_many_lws), PARSER(http_date)));
+    STATIC_SEQUENCE(com_expires, LITERAL(literal_expires), LITERAL(colon), MANY(com_many_lws), PARSER(http_date));
 
-    ssize_t result = COMBINATOR_START(com_expires, string);
+    ssize_t result = NODE_START(SEQUENCE(com_expires), string);
     unused(ctx);
 
-    free_com(com_expires);
-    free_com(com_many_lws);
-    free_com(colon);
-    free_com(literal_expires);
     return result;
 }
 
 ssize_t last_modified(const char *string, void *ctx)
 {
-    combinator_t *literal_last_modified = literal("Last Modified");
-    combinator_t *colon                 = literal(":");
+    STATIC_LITERAL(literal_last_modified, "Last Modified");
+    STATIC_LITERAL(colon, ":");
 
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
 
-    combinator_t *com_last_modified = sequence(4, WRAP(COMBINATOR(literal_last_modified), COMBINATOR(colon), COMBINATOR(com_many_lws), PARSER(http_date)));
+    STATIC_SEQUENCE(com_last_modified, LITERAL(literal_last_modified), LITERAL(colon), MANY(com_many_lws), PARSER(http_date));
 
-    ssize_t result = COMBINATOR_START(com_last_modified, string);
+    ssize_t result = NODE_START(SEQUENCE(com_last_modified), string);
     unused(ctx);
 
-    free_com(com_last_modified);
-    free_com(com_many_lws);
-    free_com(colon);
-    free_com(literal_last_modified);
     return result;
 }
 
 ssize_t general_header(const char *string, void *ctx)
 {
-    combinator_t *com_many_lws              = many(WRAP(PARSER(lws)), 0, -1);
-    combinator_t *com_general_header_choice = choice(2, WRAP(PARSER(date), PARSER(pragma)));
-    combinator_t *com_general_header        = sequence(2, WRAP(COMBINATOR(com_many_lws), COMBINATOR(com_general_header_choice)));
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
+    STATIC_CHOICE(com_general_header_choice, PARSER(date), PARSER(pragma));
+    STATIC_SEQUENCE(com_general_header, MANY(com_many_lws), CHOICE(com_general_header_choice));
 
-    ssize_t result = COMBINATOR_START(com_general_header, string);
+    ssize_t result = NODE_START(SEQUENCE(com_general_header), string);
     unused(ctx);
 
-    free_com(com_general_header);
-    free_com(com_general_header_choice);
-    free_com(com_many_lws);
     return result;
 }
 
 ssize_t request_header(const char *string, void *ctx)
 {
-    combinator_t *com_many_lws              = many(WRAP(PARSER(lws)), 0, -1);
-    combinator_t *com_request_header_choice = choice(3, WRAP(PARSER(if_modified_since), PARSER(referer), PARSER(user_agent)));
-    combinator_t *com_request_header        = sequence(2, WRAP(COMBINATOR(com_many_lws), COMBINATOR(com_request_header_choice)));
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
+    STATIC_CHOICE(com_request_header_choice, PARSER(if_modified_since), PARSER(referer), PARSER(user_agent));
+    STATIC_SEQUENCE(com_request_header, MANY(com_many_lws), CHOICE(com_request_header_choice));
 
-    ssize_t result = COMBINATOR_START(com_request_header, string);
+    ssize_t result = NODE_START(SEQUENCE(com_request_header), string);
     unused(ctx);
 
-    free_com(com_request_header);
-    free_com(com_request_header_choice);
-    free_com(com_many_lws);
     return result;
 }
 
 ssize_t entity_header(const char *string, void *ctx)
 {
-    combinator_t *com_many_lws = many(WRAP(PARSER(lws)), 0, -1);
-    combinator_t *com_entity_header_choice =
-        choice(6, WRAP(PARSER(allow), PARSER(content_encoding), PARSER(content_length), PARSER(content_type), PARSER(expires), PARSER(last_modified)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-    combinator_t *com_entity_header = sequence(2, WRAP(COMBINATOR(com_many_lws), COMBINATOR(com_entity_header_choice)));
+    STATIC_MANY(com_many_lws, PARSER(lws), 0, -1);
+    STATIC_CHOICE(com_entity_header_choice, PARSER(allow), PARSER(content_encoding), PARSER(content_length), PARSER(content_type), PARSER(expires), PARSER(last_modified));
+    STATIC_SEQUENCE(com_entity_header, MANY(com_many_lws), CHOICE(com_entity_header_choice));
 
-    ssize_t result = COMBINATOR_START(com_entity_header, string);
+    ssize_t result = NODE_START(SEQUENCE(com_entity_header), string);
     unused(ctx);
 
-    free_com(com_entity_header);
-    free_com(com_entity_header_choice);
-    free_com(com_many_lws);
     return result;
 }
 
@@ -1745,63 +1757,46 @@ ssize_t extension_method(const char *string, void *ctx)
 
 ssize_t method(const char *string, void *ctx)
 {
-    combinator_t *options = literal("OPTIONS");
-    combinator_t *get     = literal("GET");
-    combinator_t *head    = literal("HEAD");
-    combinator_t *post    = literal("POST");
-    combinator_t *put     = literal("PUT");
-    combinator_t *delete  = literal("DELETE");
-    combinator_t *trace   = literal("TRACE");
-    combinator_t *connect = literal("CONNECT");
+    STATIC_LITERAL(options, "OPTIONS");
+    STATIC_LITERAL(get, "GET");
+    STATIC_LITERAL(head, "HEAD");
+    STATIC_LITERAL(post, "POST");
+    STATIC_LITERAL(put, "PUT");
+    STATIC_LITERAL(delete, "DELETE");
+    STATIC_LITERAL(trace, "TRACE");
+    STATIC_LITERAL(connect, "CONNECT");
 
-    combinator_t *com_method = choice(9,    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-                                      WRAP(COMBINATOR(options), COMBINATOR(get), COMBINATOR(head), COMBINATOR(post), COMBINATOR(put), COMBINATOR(delete), COMBINATOR(trace), COMBINATOR(connect), PARSER(extension_method)));
+    STATIC_CHOICE(com_method, LITERAL(options), LITERAL(get), LITERAL(head), LITERAL(post), LITERAL(put), LITERAL(delete), LITERAL(trace), LITERAL(connect), PARSER(extension_method));
 
-    ssize_t result = COMBINATOR_START(com_method, string);
+    ssize_t result = NODE_START(CHOICE(com_method), string);
     unused(ctx);
 
-    free_com(com_method);
-    free_com(connect);
-    free_com(trace);
-    free_com(delete);
-    free_com(put);
-    free_com(post);
-    free_com(head);
-    free_com(get);
-    free_com(options);
     return result;
 }
 
 ssize_t request_uri(const char *string, void *ctx)
 {
-    combinator_t *asterik = literal("*");
+    STATIC_LITERAL(asterik, "*");
 
-    combinator_t *com_request_uri = choice(3, WRAP(COMBINATOR(asterik), PARSER(absolute_uri), PARSER(abs_path)));
+    STATIC_CHOICE(com_request_uri, LITERAL(asterik), PARSER(absolute_uri), PARSER(abs_path));
 
-    ssize_t result = COMBINATOR_START(com_request_uri, string);
+    ssize_t result = NODE_START(CHOICE(com_request_uri), string);
     unused(ctx);
 
-    free_com(com_request_uri);
-    free_com(asterik);
     return result;
 }
 
 ssize_t http_version(const char *string, void *ctx)
 {
-    combinator_t *http          = literal("HTTP");
-    combinator_t *forward_slash = literal("/");
-    combinator_t *dot           = literal(".");
-    combinator_t *digit1        = many(WRAP(PARSER(digit)), 1, 1);
+    STATIC_LITERAL(http, "HTTP");
+    STATIC_LITERAL(forward_slash, "/");
+    STATIC_LITERAL(dot, ".");
+    STATIC_MANY(digit1, PARSER(digit), 1, 1);
 
-    combinator_t *com_http_version = sequence(5, WRAP(COMBINATOR(http), COMBINATOR(forward_slash), COMBINATOR(digit1), COMBINATOR(dot), COMBINATOR(digit1)));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    STATIC_SEQUENCE(com_http_version, LITERAL(http), LITERAL(forward_slash), MANY(digit1), LITERAL(dot), MANY(digit1));
 
-    ssize_t result = COMBINATOR_START(com_http_version, string);
+    ssize_t result = NODE_START(SEQUENCE(com_http_version), string);
     unused(ctx);
 
-    free_com(com_http_version);
-    free_com(digit1);
-    free_com(dot);
-    free_com(forward_slash);
-    free_com(http);
     return result;
 }
@@ -2,96 +2,22 @@
 #include "logger.h"
 #include "utils.h"
 #include <errno.h>
-#include <fcntl.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-ssize_t read_string(int fd, char **buf, size_t size, int *err)
-{
-    ssize_t nread;
-
-    // Check if our size is greater than 1 or if fd is invalid
-    if(size <= 1 || fd < 0)
-    {
-        seterr(EINVAL);
-        return -1;
-    }
-
-    // Set the read to non-blocking
-    errno = 0;
-    if(fcntl(fd, F_SETFL, O_NONBLOCK) == -1)
-    {
-        seterr(errno);
-        return -2;
-    }
-
-    // Allocate [size] heap memory for buf
-    errno = 0;
-    *buf  = (char *)calloc(size, sizeof(char));
-    if(*buf == NULL)
-    {
-        seterr(errno);
-        return -3;
-    }
-
-    nread = 0;
-    do
-    {
-        char   *tbuf;
-        ssize_t tread;
-
-        // Read [size - 1] bytes from fd
-        errno = 0;
-        tread = read(fd, *buf + nread, size - 1);
-        if(tread < 0)
-        {
-            if(errno == EAGAIN)
-            {
-                // It is assumed that the client has sent the entire request all at once.
-                // and once we have to "wait for more data", it's likely we've read all the data.
-                return nread;
-            }
-
-            seterr(errno);
-            return -4;
-        }
-
-        // if read returned EOF, return the total read size
-        if(tread == 0)
-        {
-            break;
-        }
-
-        // Add to total count
-        nread += tread;
-
-        // Null terminate last character
-        (*buf)[nread] = '\0';
-
-        // Add another [size] bytes into buf
-        errno = 0;
-        tbuf  = (char *)realloc(*buf, (size_t)nread + size);
-        if(tbuf == NULL)
-        {
-            seterr(errno);
-            return -5;    // NOLINT
-        }
-        *buf = tbuf;
-    } while(1);
-
-    return nread;
-}
-
-int send_fd(int sock, int fd, int *err)
+/*
+ * Sends a file descriptor over a unix domain socket, along with a one byte tag telling the receiver what it is.
+ */
+int send_fd(int sock, int fd, char tag, int *err)
 {
     struct iovec    io;
     struct msghdr   msg = {0};
     struct cmsghdr *cmsg;
 
-    char buf[1] = {0};
+    char buf[1] = {tag};
     char control[CMSG_SPACE(sizeof(int))];
 
     io.iov_base = buf;
@@ -118,15 +44,16 @@ int send_fd(int sock, int fd, int *err)
     return 0;
 }
 
-int recv_fd(int sock, int *err)
+int recv_fd(int sock, char *tag, int *err)
 {
     struct iovec    io;
     struct msghdr   msg = {0};
     struct cmsghdr *cmsg;
 
-    char control[CMSG_SPACE(sizeof(int))];
-    char buf[1];
-    int  fd;
+    char    control[CMSG_SPACE(sizeof(int))];
+    char    buf[1];
+    int     fd;
+    ssize_t nrecv;
 
     io.iov_base = buf;
     io.iov_len  = sizeof(buf);
@@ -137,12 +64,20 @@ int recv_fd(int sock, int *err)
     msg.msg_controllen = sizeof(control);
 
     errno = 0;
-    if(recvmsg(sock, &msg, 0) < 0)
+    nrecv = recvmsg(sock, &msg, 0);
+    if(nrecv < 0)
     {
         seterr(errno);
         return -1;
     }
 
+    // The other end has closed the socket
+    if(nrecv == 0)
+    {
+        seterr(ECONNRESET);
+        return -3;
+    }
+
     cmsg = CMSG_FIRSTHDR(&msg);
     if(!(cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS))
     {
@@ -151,5 +86,10 @@ int recv_fd(int sock, int *err)
 
     memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
 
+    if(tag)
+    {
+        *tag = buf[0];
+    }
+
     return fd;
 }
@@ -1,91 +1,170 @@
 #include "loader.h"
+#include "utils.h"
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <unistd.h>
 
-static void *dlhandle = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+#define COPY_BUFFER_SIZE 65536
 
-static int (*s_request_init)(http_request_t *, const char *, int *)                             = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
-static int (*s_request_parse)(http_request_t *, const char *, int *)                            = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
-static int (*s_request_process)(http_request_t *, http_response_t *, int *)                     = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
-static int (*s_response_write)(const http_response_t *, const http_request_t *, char **, int *) = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
-static int (*s_request_destroy)(http_request_t *, int *)                                        = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
-static int (*s_response_destroy)(http_response_t *, int *)                                      = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static library_t *current = NULL;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
 
-static void load_library(const char *filepath)
-{
-    dlhandle = dlopen(filepath, RTLD_LAZY);
-}
-
-static void unload_library(void)
-{
-    if(dlhandle)
-    {
-        s_request_init     = NULL;
-        s_request_parse    = NULL;
-        s_request_process  = NULL;
-        s_response_write   = NULL;
-        s_request_destroy  = NULL;
-        s_response_destroy = NULL;
-
-        dlclose(dlhandle);
-        dlhandle = NULL;
-    }
-}
+static void *open_copy(const char *filepath);
+static int   copy_file(int dstfd, int srcfd);
+static int   resolve_api(library_t *library);
 
+/*
+ * Load the library at `filepath` and swap it in for the current one.
+ *
+ * The new library is fully loaded and its table checked before anything is replaced, so a missing, half written or
+ * incompatible file leaves the current library in place. Every process is single threaded, so the swap is a single
+ * pointer store: a request sees either the whole old table or the whole new one. The old library is only closed once
+ * the requests that started on it have released it.
+ */
 int reload_library(const char *filepath)
 {
-    unload_library();
-    load_library(filepath);
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wstrict-prototypes"
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpedantic"
+    library_t *previous;
+    library_t *next;
 
-    s_request_init     = (int (*)(http_request_t *, const char *, int *))dlsym(dlhandle, "request_init");
-    s_request_parse    = (int (*)(http_request_t *, const char *, int *))dlsym(dlhandle, "request_parse");
-    s_request_process  = (int (*)(http_request_t *, http_response_t *, int *))dlsym(dlhandle, "request_process");
-    s_response_write   = (int (*)(const http_response_t *, const http_request_t *, char **, int *))dlsym(dlhandle, "response_write");
-    s_request_destroy  = (int (*)(http_request_t *, int *))dlsym(dlhandle, "request_destroy");
-    s_response_destroy = (int (*)(http_response_t *, int *))dlsym(dlhandle, "response_destroy");
+    next = (library_t *)calloc(1, sizeof(library_t));
+    if(next == NULL)
+    {
+        return -1;
+    }
 
-#pragma GCC diagnostic pop
-#pragma GCC diagnostic pop
+    next->handle = open_copy(filepath);
+    if(next->handle == NULL)
+    {
+        free(next);
+        return -2;
+    }
 
-    if(!(s_request_init && s_request_parse && s_request_process && s_response_write && s_request_destroy && s_response_destroy))
+    if(resolve_api(next) < 0)
     {
-        return -1;
+        dlclose(next->handle);
+        free(next);
+        return -3;
     }
 
+    next->refs = 1;    // The loader's own reference, dropped by the next reload
+    previous   = current;
+    current    = next;
+    library_release(previous);
+
     return 0;
 }
 
-int request_init(http_request_t *request, const char *public_dir, int *err)
+/*
+ * Pin the current library for the duration of a request. Returns NULL if no library has been loaded.
+ */
+library_t *library_acquire(void)
 {
-    return s_request_init ? s_request_init(request, public_dir, err) : -1;
+    if(current)
+    {
+        current->refs++;
+    }
+
+    return current;
 }
 
-int request_parse(http_request_t *request, const char *data, int *err)
+void library_release(library_t *library)
 {
-    return s_request_parse ? s_request_parse(request, data, err) : -1;
+    if(library == NULL || --library->refs > 0)
+    {
+        return;
+    }
+
+    dlclose(library->handle);
+    free(library);
 }
 
-int request_process(http_request_t *request, http_response_t *response, int *err)
+/*
+ * dlopen hands back the library it already has for a path it has seen before, even when the file has since been
+ * replaced. Loading a private copy under a fresh name makes every reload pick up what is currently on disk.
+ */
+static void *open_copy(const char *filepath)
 {
-    return s_request_process ? s_request_process(request, response, err) : -1;
+    char *copy_path;
+    void *handle = NULL;
+    int   srcfd;
+    int   dstfd;
+
+    copy_path = make_string("%s.XXXXXX", filepath);
+    if(copy_path == NULL)
+    {
+        return NULL;
+    }
+
+    srcfd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if(srcfd < 0)
+    {
+        goto free_path;
+    }
+
+    dstfd = mkstemp(copy_path);
+    if(dstfd < 0)
+    {
+        goto close_src;
+    }
+
+    if(copy_file(dstfd, srcfd) == 0)
+    {
+        // Resolve every symbol up front so an incompatible library is rejected here rather than in the middle of a request
+        handle = dlopen(copy_path, RTLD_NOW | RTLD_LOCAL);
+    }
+
+    // The mapping outlives the name
+    close(dstfd);
+    unlink(copy_path);
+
+close_src:
+    close(srcfd);
+
+free_path:
+    free(copy_path);
+    return handle;
 }
 
-int response_write(const http_response_t *response, const http_request_t *request, char **response_buf, int *err)
+static int copy_file(int dstfd, int srcfd)
 {
-    return s_response_write ? s_response_write(response, request, response_buf, err) : -1;
+    char    buf[COPY_BUFFER_SIZE];
+    ssize_t nread;
+
+    while((nread = read(srcfd, buf, sizeof(buf))) > 0)
+    {
+        ssize_t nwritten = 0;
+
+        while(nwritten < nread)
+        {
+            ssize_t n = write(dstfd, buf + nwritten, (size_t)(nread - nwritten));
+            if(n < 0)
+            {
+                return -1;
+            }
+            nwritten += n;
+        }
+    }
+
+    return nread < 0 ? -2 : 0;
 }
 
-int request_destroy(http_request_t *request, int *err)
+static int resolve_api(library_t *library)
 {
-    return s_request_destroy ? s_request_destroy(request, err) : -1;
+    library->api = (const http_library_t *)dlsym(library->handle, HTTP_LIBRARY_SYMBOL);
+    if(library->api == NULL || library->api->abi_version != HTTP_LIBRARY_ABI_VERSION)
+    {
+        return -1;
+    }
+
+    if(!(library->api->request_init && library->api->request_view_parse && library->api->request_from_view && library->api->request_process && library->api->response_write && library->api->request_destroy && library->api->response_destroy && library->api->get_mime_type))
+    {
+        return -2;
+    }
+
+    return 0;
 }
 
-int response_destroy(http_response_t *response, int *err)
+const char *get_mime_type(const char *filepath)
 {
-    return s_response_destroy ? s_response_destroy(response, err) : -1;
+    return current ? current->api->get_mime_type(filepath) : "application/octet-stream";
 }
@@ -3,59 +3,159 @@
 #include "utils.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <memory.h>
+#include <ndbm.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #pragma GCC diagnostic ignored "-Waggregate-return"
 
-int db_insert(DBM *db, const char *key, const uint8_t *buf, size_t size, int *err)
+#ifdef __APPLE__
+typedef size_t datum_size;
+#else
+typedef int datum_size;
+#endif
+
+typedef struct
 {
-    const_datum key_datum = MAKE_CONST_DATUM(key);
-    datum       value_datum;
-    int         result;
+    const void *dptr;
+    datum_size  dsize;
+} const_datum;
+
+#define MAKE_CONST_DATUM(str) ((const_datum){(str), (datum_size)strlen(str) + 1})
+
+static int      ndbm_open(void **handle, const char *filepath, int *err);
+static int      ndbm_put(void *handle, const char *key, const uint8_t *value, size_t len, int *err);
+static uint8_t *ndbm_get(void *handle, const char *key, size_t *len, int *err);
+static int      ndbm_iterate(void *handle, db_iterate_fn fn, void *arg, int *err);
+static int      ndbm_flush(void *handle, bool durable, int *err);
+static void     ndbm_close(void *handle);
+static void     db_cache_sync(db_cache_t *cache);
+
+static const char *const ndbm_files[] = {".dir", ".pag", NULL};
+
+const db_engine_t db_ndbm_engine = {"ndbm", ndbm_files, ndbm_open, ndbm_put, ndbm_get, ndbm_iterate, ndbm_flush, ndbm_close};
+
+static const db_engine_t *const engines[] = {&db_ndbm_engine, &db_log_engine};
+
+const db_engine_t *db_find_engine(const char *name)
+{
+    for(size_t idx = 0; idx < arrlen(engines); idx++)
+    {
+        if(strcmp(engines[idx]->name, name) == 0)
+        {
+            return engines[idx];
+        }
+    }
 
-    if(db == NULL || key == NULL || buf == NULL)
+    return NULL;
+}
+
+int db_insert(db_t *db, const char *key, const uint8_t *buf, size_t size, int *err)
+{
+    if(db == NULL || db->handle == NULL || key == NULL || buf == NULL)
     {
         seterr(EINVAL);
         return -1;
     }
 
-    errno            = 0;
-    value_datum.dptr = (char *)calloc(size, sizeof(char));
-    if(value_datum.dptr == NULL)
+    return db->engine->put(db->handle, key, buf, size, err);
+}
+
+/*
+ * Looks up a record. The value points into the engine's own buffer, it is only valid until the next call on the
+ * database, so callers copy it out straight away.
+ *
+ * Returns NULL with ENOENT when there is no record for the key.
+ */
+uint8_t *db_fetch(db_t *db, const char *key, size_t *len, int *err)
+{
+    if(db == NULL || db->handle == NULL || key == NULL || len == NULL)
     {
-        seterr(errno);
+        seterr(EINVAL);
+        return NULL;
+    }
+
+    return db->engine->get(db->handle, key, len, err);
+}
+
+/*
+ * Calls `fn` once for every record, in no particular order. Returns 0 once every record has been visited. When `fn`
+ * stops the walk, its value is returned as is and `err` is left untouched. A failure of the engine returns a negative
+ * value with `err` set.
+ */
+int db_iterate(db_t *db, db_iterate_fn fn, void *arg, int *err)
+{
+    if(db == NULL || db->handle == NULL || fn == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    return db->engine->iterate(db->handle, fn, arg, err);
+}
+
+int db_flush(db_t *db, bool durable, int *err)
+{
+    if(db == NULL || db->handle == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    return db->engine->flush(db->handle, durable, err);
+}
+
+int db_init(db_t *db, const char *engine, const char *filepath, int *err)
+{
+    seterr(0);
+    if(db == NULL || engine == NULL || filepath == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    db->handle = NULL;
+    db->engine = db_find_engine(engine);
+    if(db->engine == NULL)
+    {
+        seterr(ENOENT);
         return -2;
     }
 
-    memcpy(value_datum.dptr, buf, size);
+    log_debug("Opening %s database at %s\n", db->engine->name, filepath);
 
-#ifdef __APPLE__
-    value_datum.dsize = size;
-#else
-    value_datum.dsize = (int)size;
-#endif
+    if(db->engine->open(&db->handle, filepath, err) < 0)
+    {
+        db->handle = NULL;
+        return -3;
+    }
+
+    return 0;
+}
 
-    result = dbm_store(db, *(datum *)&key_datum, value_datum, DBM_REPLACE);
+void db_destroy(db_t *db)
+{
+    if(db->handle)
+    {
+        db->engine->close(db->handle);
+    }
 
-    free(value_datum.dptr);
-    return result;
+    db->handle = NULL;
 }
 
-int db_init(DBM **db, const char *filepath, int *err)
+static int ndbm_open(void **handle, const char *filepath, int *err)
 {
     char *database_name = strdup(filepath);
 
-    // Open NDBM database
-    log_debug("Opening DBM database at %s\n", filepath);
-
-    errno = 0;
-    *db   = dbm_open(database_name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-    if(*db == NULL)
+    errno   = 0;
+    *handle = dbm_open(database_name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if(*handle == NULL)
     {
         seterr(errno);
         free(database_name);
@@ -66,8 +166,285 @@ int db_init(DBM **db, const char *filepath, int *err)
     return 0;
 }
 
-void db_destroy(DBM **db)
+/*
+ * Stores a record straight from the caller's buffer. NDBM copies the value into its pages, so there is no need for a
+ * private copy here.
+ */
+static int ndbm_put(void *handle, const char *key, const uint8_t *value, size_t len, int *err)
 {
-    dbm_close(*db);
-    *db = NULL;
+    const_datum key_datum = MAKE_CONST_DATUM(key);
+    const_datum value_datum;
+
+    if(len > INT_MAX)
+    {
+        seterr(EFBIG);
+        return -1;
+    }
+
+    value_datum.dptr  = value;
+    value_datum.dsize = (datum_size)len;
+
+    errno = 0;
+    if(dbm_store((DBM *)handle, *(datum *)&key_datum, *(datum *)&value_datum, DBM_REPLACE) < 0)
+    {
+        seterr(errno ? errno : EIO);
+        return -2;
+    }
+
+    return 0;
+}
+
+static uint8_t *ndbm_get(void *handle, const char *key, size_t *len, int *err)
+{
+    const_datum key_datum = MAKE_CONST_DATUM(key);
+    datum       value_datum;
+
+    value_datum = dbm_fetch((DBM *)handle, *(datum *)&key_datum);
+    if(value_datum.dptr == NULL)
+    {
+        seterr(ENOENT);
+        return NULL;
+    }
+
+    *len = (size_t)value_datum.dsize;
+    return (uint8_t *)value_datum.dptr;
+}
+
+/*
+ * Walks the keys with dbm_firstkey/dbm_nextkey. Keys are stored with their NUL terminator, but are copied out anyway
+ * in case the database was written by something else.
+ */
+static int ndbm_iterate(void *handle, db_iterate_fn fn, void *arg, int *err)
+{
+    DBM   *db      = (DBM *)handle;
+    char  *key     = NULL;
+    size_t keysize = 0;
+    int    retval  = 0;
+
+    for(datum key_datum = dbm_firstkey(db); key_datum.dptr != NULL; key_datum = dbm_nextkey(db))
+    {
+        datum value_datum;
+
+        if(keysize < (size_t)key_datum.dsize + 1)
+        {
+            char *tkey = (char *)realloc(key, (size_t)key_datum.dsize + 1);
+
+            if(tkey == NULL)
+            {
+                seterr(ENOMEM);
+                retval = -1;
+                break;
+            }
+
+            key     = tkey;
+            keysize = (size_t)key_datum.dsize + 1;
+        }
+
+        memcpy(key, key_datum.dptr, (size_t)key_datum.dsize);
+        key[key_datum.dsize] = '\0';
+
+        value_datum = dbm_fetch(db, key_datum);
+        if(value_datum.dptr == NULL)
+        {
+            continue;
+        }
+
+        retval = fn(key, (const uint8_t *)value_datum.dptr, (size_t)value_datum.dsize, arg);
+        if(retval != 0)
+        {
+            break;
+        }
+    }
+
+    free(key);
+    return retval;
+}
+
+/*
+ * NDBM writes every record through to its files as it is stored, only syncing is left to do.
+ */
+static int ndbm_flush(void *handle, bool durable, int *err)
+{
+    int fds[2];
+
+    if(!durable)
+    {
+        return 0;
+    }
+
+    fds[0] = dbm_pagfno((DBM *)handle);
+    fds[1] = dbm_dirfno((DBM *)handle);
+
+    for(size_t idx = 0; idx < arrlen(fds); idx++)
+    {
+        // Some implementations keep everything in one file and report it twice
+        if(fds[idx] < 0 || (idx > 0 && fds[idx] == fds[0]))
+        {
+            continue;
+        }
+
+        errno = 0;
+        if(fsync(fds[idx]) < 0)
+        {
+            seterr(errno);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void ndbm_close(void *handle)
+{
+    dbm_close((DBM *)handle);
+}
+
+/*
+ * Maps the shared generation counter. Called by the server before forking, so every worker inherits the same one.
+ */
+int db_cache_init(db_cache_t *cache, int *err)
+{
+    void *generation;
+
+    seterr(0);
+    if(cache == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(cache, 0, sizeof(db_cache_t));
+
+    errno      = 0;
+    generation = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(generation == MAP_FAILED)
+    {
+        seterr(errno);
+        return -2;
+    }
+    cache->generation = (uint64_t *)generation;
+
+    return 0;
+}
+
+void db_cache_destroy(db_cache_t *cache)
+{
+    if(cache == NULL)
+    {
+        return;
+    }
+
+    for(size_t idx = 0; idx < DB_CACHE_SLOTS; idx++)
+    {
+        free(cache->slots[idx].data);
+    }
+
+    if(cache->generation)
+    {
+        munmap(cache->generation, sizeof(uint64_t));
+    }
+
+    memset(cache, 0, sizeof(db_cache_t));
+}
+
+const uint8_t *db_cache_lookup(db_cache_t *cache, const char *key, size_t *len)
+{
+    const db_cache_slot_t *slot;
+    size_t                 key_len = strlen(key);
+    uint32_t               hash    = hash_bytes(key, key_len);
+
+    db_cache_sync(cache);
+
+    slot = &cache->slots[hash % DB_CACHE_SLOTS];
+    if(!slot->used || slot->hash != hash || slot->key_len != key_len || memcmp(slot->data, key, key_len) != 0)
+    {
+        return NULL;
+    }
+
+    *len = slot->value_len;
+    return slot->data + key_len + 1;
+}
+
+/*
+ * Keeps a copy of a record that was just read, replacing whatever shared its slot. Nothing is kept if a record was
+ * inserted since the last lookup, the value may already be out of date.
+ */
+void db_cache_store(db_cache_t *cache, const char *key, const uint8_t *value, size_t len)
+{
+    db_cache_slot_t *slot;
+    size_t           key_len = strlen(key);
+    uint32_t         hash    = hash_bytes(key, key_len);
+
+    if(len > DB_CACHE_MAX_VALUE || cache->generation == NULL || __atomic_load_n(cache->generation, __ATOMIC_ACQUIRE) != cache->seen)
+    {
+        return;
+    }
+
+    slot       = &cache->slots[hash % DB_CACHE_SLOTS];
+    slot->used = false;
+    if(slot->capacity < key_len + 1 + len)
+    {
+        uint8_t *data = (uint8_t *)realloc(slot->data, key_len + 1 + len);
+
+        if(data == NULL)
+        {
+            return;
+        }
+
+        slot->data     = data;
+        slot->capacity = key_len + 1 + len;
+    }
+
+    memcpy(slot->data, key, key_len + 1);
+    memcpy(slot->data + key_len + 1, value, len);
+    slot->hash      = hash;
+    slot->key_len   = key_len;
+    slot->value_len = len;
+    slot->used      = true;
+}
+
+/*
+ * Tells every worker that records changed. The store calls this once per batch, after committing it and before
+ * acknowledging it, so a worker that sees the new generation also reads the new values.
+ */
+void db_cache_invalidate(db_cache_t *cache)
+{
+    if(cache->generation)
+    {
+        __atomic_fetch_add(cache->generation, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Number of commits made so far, a snapshot taken at any other count is out of date
+uint64_t db_cache_generation(const db_cache_t *cache)
+{
+    if(cache->generation == NULL)
+    {
+        return 0;
+    }
+
+    return __atomic_load_n(cache->generation, __ATOMIC_ACQUIRE);
+}
+
+// Drops every cached record once another insert has happened, the buffers are kept for the records read next
+static void db_cache_sync(db_cache_t *cache)
+{
+    uint64_t generation;
+
+    if(cache->generation == NULL)
+    {
+        return;
+    }
+
+    generation = __atomic_load_n(cache->generation, __ATOMIC_ACQUIRE);
+    if(generation == cache->seen)
+    {
+        return;
+    }
+
+    for(size_t idx = 0; idx < DB_CACHE_SLOTS; idx++)
+    {
+        cache->slots[idx].used = false;
+    }
+    cache->seen = generation;
 }
@@ -1,35 +1,736 @@
-#include "logger.h"
-#include <fcntl.h>
-#include <ndbm.h>
+#include "ndbm/database.h"
+#include "utils.h"
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#pragma GCC diagnostic ignored "-Waggregate-return"
+/*
+ * Bulk tool for record databases, works with every storage engine.
+ *
+ * The database is opened directly, so it must not be in use by a running server: the store process expects to be the
+ * only one writing to it.
+ *
+ * Exports start with a header, followed by every record as its key and value lengths in host byte order, the key
+ * without its NUL, then the value. An export from one engine can be imported into any other.
+ */
 
-int main(int argc, const char *argv[])
+#define EXPLORER_BUFFER_SIZE (1024 * 1024)
+#define EXPORT_MAGIC 0x504D4452U    // "RDMP"
+#define EXPORT_VERSION 1
+#define COMPACT_SUFFIX ".compact"
+#define HISTOGRAM_BUCKETS 65    // Empty values, then one bucket per power of two
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+} export_header_t;
+
+typedef struct
+{
+    uint64_t key_len;
+    uint64_t value_len;
+} export_record_t;
+
+// Records with keys from `first` up to, but not including, `last`. A NULL bound is open.
+typedef struct
+{
+    const char *first;
+    const char *last;
+    FILE       *out;
+    bool        binary;    // Export format instead of "key: value" lines
+    size_t      nrecords;
+} output_t;
+
+typedef struct
+{
+    size_t   nrecords;
+    uint64_t key_bytes;
+    uint64_t value_bytes;
+    size_t   min_value;
+    size_t   max_value;
+    size_t   histogram[HISTOGRAM_BUCKETS];
+} stats_t;
+
+typedef struct
+{
+    db_t  *db;
+    size_t nrecords;
+    int    err;    // Set when a put failed
+} copy_t;
+
+typedef int (*command_fn)(db_t *db, const char *filepath, int argc, char *argv[]);
+
+typedef struct
+{
+    const char *name;
+    int         max_args;
+    command_fn  fn;
+} command_t;
+
+static _Noreturn void usage(const char *binary_name, int exit_code, const char *message);
+static int            command_scan(db_t *db, const char *filepath, int argc, char *argv[]);
+static int            command_export(db_t *db, const char *filepath, int argc, char *argv[]);
+static int            command_import(db_t *db, const char *filepath, int argc, char *argv[]);
+static int            command_stats(db_t *db, const char *filepath, int argc, char *argv[]);
+static int            command_compact(db_t *db, const char *filepath, int argc, char *argv[]);
+static int            write_record(const char *key, const uint8_t *value, size_t len, void *arg);
+static int            count_record(const char *key, const uint8_t *value, size_t len, void *arg);
+static int            copy_record(const char *key, const uint8_t *value, size_t len, void *arg);
+static int            read_exact(FILE *in, void *buf, size_t size);
+static uint64_t       files_size(const db_engine_t *engine, const char *filepath);
+static int            rename_files(const db_engine_t *engine, const char *from, const char *to, size_t *renamed, int *err);
+static void           remove_files(const db_engine_t *engine, const char *filepath);
+static bool           keeps_file(const db_engine_t *engine, const char *suffix);
+
+static const command_t commands[] = {
+    {"scan",    2, command_scan   },
+    {"export",  1, command_export },
+    {"import",  1, command_import },
+    {"stats",   0, command_stats  },
+    {"compact", 1, command_compact},
+};
+
+int main(int argc, char *argv[])
+{
+    const command_t *command  = NULL;
+    const char      *engine   = DB_ENGINE_DEFAULT;
+    const char      *filepath = NULL;
+    char           **args     = NULL;
+    int              nargs    = 0;
+    int              opt;
+    int              retval;
+    db_t             db;
+    int              err;
+
+    while((opt = getopt(argc, argv, "hE:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'E':
+                engine = optarg;
+                break;
+            case 'h':
+                usage(argv[0], EXIT_SUCCESS, NULL);
+            default:
+                usage(argv[0], EXIT_FAILURE, NULL);
+        }
+    }
+
+    if(optind >= argc)
+    {
+        usage(argv[0], EXIT_FAILURE, "You must provide a database.");
+    }
+
+    for(size_t idx = 0; idx < arrlen(commands); idx++)
+    {
+        if(strcmp(commands[idx].name, argv[optind]) == 0)
+        {
+            command = &commands[idx];
+        }
+    }
+
+    // `explorer <database> [ndbm|log]` prints every record
+    if(command == NULL)
+    {
+        command  = &commands[0];
+        filepath = argv[optind];
+        if(optind + 1 < argc)
+        {
+            engine = argv[optind + 1];
+        }
+    }
+    else
+    {
+        if(optind + 1 >= argc)
+        {
+            usage(argv[0], EXIT_FAILURE, "You must provide a database.");
+        }
+
+        filepath = argv[optind + 1];
+        args     = &argv[optind + 2];
+        nargs    = argc - (optind + 2);
+        if(nargs > command->max_args)
+        {
+            usage(argv[0], EXIT_FAILURE, "Too many arguments.");
+        }
+    }
+
+    if(db_find_engine(engine) == NULL)
+    {
+        usage(argv[0], EXIT_FAILURE, "The database engine must be either 'ndbm' or 'log'.");
+    }
+
+    err = 0;
+    if(db_init(&db, engine, filepath, &err) < 0)
+    {
+        fprintf(stderr, "main::db_init: %s\n", strerror(err));
+        return 1;
+    }
+
+    retval = command->fn(&db, filepath, nargs, args);
+
+    db_destroy(&db);
+    return retval < 0 ? 1 : 0;
+}
+
+static _Noreturn void usage(const char *binary_name, int exit_code, const char *message)
+{
+    if(message)
+    {
+        fprintf(stderr, "%s\n\n", message);
+    }
+
+    fprintf(stderr, "Usage: %s [-h] [-E <engine>] <command> <database> [arguments]\n", binary_name);
+    fputs("Options:\n", stderr);
+    fputs("  -h                       Display this help message\n", stderr);
+    fputs("  -E <engine>              Storage engine of the database, 'ndbm' or 'log' (default: ndbm).\n", stderr);
+    fputs("Commands:\n", stderr);
+    fputs("  scan [first [last]]      Print the records with keys from first up to, not including, last.\n", stderr);
+    fputs("  export [file]            Write every record to file, or stdout, in the binary export format.\n", stderr);
+    fputs("  import [file]            Insert the records of an export read from file, or stdin.\n", stderr);
+    fputs("  stats                    Count the records and show how their sizes are spread.\n", stderr);
+    fputs("  compact [engine]         Rewrite the database without dead space, into another engine if given.\n", stderr);
+    exit(exit_code);
+}
+
+/*
+ * Prints records as "key: value" lines. Engines keep no order, so neither does the output.
+ */
+static int command_scan(db_t *db, const char *filepath, int argc, char *argv[])
+{
+    output_t output;
+    int      err;
+
+    unused(filepath);
+
+    memset(&output, 0, sizeof(output_t));
+    output.first = argc > 0 ? argv[0] : NULL;
+    output.last  = argc > 1 ? argv[1] : NULL;
+    output.out   = stdout;
+    setvbuf(stdout, NULL, _IOFBF, EXPLORER_BUFFER_SIZE);
+
+    err = 0;
+    if(db_iterate(db, write_record, &output, &err) < 0)
+    {
+        fprintf(stderr, "command_scan::db_iterate: %s\n", strerror(err ? err : EIO));
+        return -1;
+    }
+
+    if(fflush(stdout) != 0)
+    {
+        fprintf(stderr, "command_scan::fflush: %s\n", strerror(errno));
+        return -2;
+    }
+
+    return 0;
+}
+
+static int command_export(db_t *db, const char *filepath, int argc, char *argv[])
+{
+    output_t        output;
+    export_header_t header;
+    int             retval = 0;
+    int             err;
+
+    unused(filepath);
+
+    memset(&output, 0, sizeof(output_t));
+    output.binary = true;
+    output.out    = stdout;
+    if(argc > 0 && strcmp(argv[0], "-") != 0)
+    {
+        errno      = 0;
+        output.out = fopen(argv[0], "wbe");
+        if(output.out == NULL)
+        {
+            fprintf(stderr, "command_export::fopen: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    setvbuf(output.out, NULL, _IOFBF, EXPLORER_BUFFER_SIZE);
+
+    header.magic   = EXPORT_MAGIC;
+    header.version = EXPORT_VERSION;
+    if(fwrite(&header, sizeof(export_header_t), 1, output.out) != 1)
+    {
+        fprintf(stderr, "command_export::fwrite: %s\n", strerror(errno));
+        retval = -2;
+        goto cleanup;
+    }
+
+    err = 0;
+    if(db_iterate(db, write_record, &output, &err) < 0)
+    {
+        fprintf(stderr, "command_export::db_iterate: %s\n", strerror(err ? err : EIO));
+        retval = -3;
+        goto cleanup;
+    }
+
+    if(fflush(output.out) != 0)
+    {
+        fprintf(stderr, "command_export::fflush: %s\n", strerror(errno));
+        retval = -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    fprintf(stderr, "Exported %zu records.\n", output.nrecords);
+
+cleanup:
+    if(output.out != stdout)
+    {
+        fclose(output.out);
+    }
+
+    return retval;
+}
+
+/*
+ * Streams an export into the database. Both engines take a single writer and buffer their puts until the flush, so
+ * records are inserted in one pass as they are read and the database is synced once at the end.
+ */
+static int command_import(db_t *db, const char *filepath, int argc, char *argv[])
+{
+    FILE           *in     = stdin;
+    uint8_t        *buf    = NULL;
+    size_t          size   = 0;
+    size_t          count  = 0;
+    int             retval = 0;
+    export_header_t header;
+    int             err;
+
+    unused(filepath);
+
+    if(argc > 0 && strcmp(argv[0], "-") != 0)
+    {
+        errno = 0;
+        in    = fopen(argv[0], "rbe");
+        if(in == NULL)
+        {
+            fprintf(stderr, "command_import::fopen: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    setvbuf(in, NULL, _IOFBF, EXPLORER_BUFFER_SIZE);
+
+    if(read_exact(in, &header, sizeof(export_header_t)) != 1 || header.magic != EXPORT_MAGIC || header.version != EXPORT_VERSION)
+    {
+        fprintf(stderr, "command_import: Not an export\n");
+        retval = -2;
+        goto cleanup;
+    }
+
+    while(true)
+    {
+        export_record_t record;
+        int             nread = read_exact(in, &record, sizeof(export_record_t));
+
+        if(nread == 0)
+        {
+            break;
+        }
+
+        if(nread < 0 || record.key_len > SIZE_MAX / 2 || record.value_len > SIZE_MAX / 2)
+        {
+            fprintf(stderr, "command_import: Truncated export after %zu records\n", count);
+            retval = -3;
+            goto cleanup;
+        }
+
+        // The key is NUL terminated in place, its value follows it
+        if(size < record.key_len + 1 + record.value_len)
+        {
+            uint8_t *grown = (uint8_t *)realloc(buf, (size_t)(record.key_len + 1 + record.value_len));
+
+            if(grown == NULL)
+            {
+                fprintf(stderr, "command_import::realloc: %s\n", strerror(ENOMEM));
+                retval = -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                goto cleanup;
+            }
+
+            buf  = grown;
+            size = (size_t)(record.key_len + 1 + record.value_len);
+        }
+
+        if(read_exact(in, buf, (size_t)record.key_len) != 1 || read_exact(in, buf + record.key_len + 1, (size_t)record.value_len) != 1)
+        {
+            fprintf(stderr, "command_import: Truncated export after %zu records\n", count);
+            retval = -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            goto cleanup;
+        }
+
+        buf[record.key_len] = '\0';
+        if(memchr(buf, '\0', (size_t)record.key_len) != NULL)
+        {
+            fprintf(stderr, "command_import: Key of record %zu holds a NUL\n", count);
+            retval = -6;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            goto cleanup;
+        }
+
+        err = 0;
+        if(db_insert(db, (const char *)buf, buf + record.key_len + 1, (size_t)record.value_len, &err) < 0)
+        {
+            fprintf(stderr, "command_import::db_insert: %s\n", strerror(err ? err : EIO));
+            retval = -7;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            goto cleanup;
+        }
+
+        count++;
+    }
+
+    err = 0;
+    if(db_flush(db, true, &err) < 0)
+    {
+        fprintf(stderr, "command_import::db_flush: %s\n", strerror(err));
+        retval = -8;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    fprintf(stderr, "Imported %zu records.\n", count);
+
+cleanup:
+    if(in != stdin)
+    {
+        fclose(in);
+    }
+    free(buf);
+
+    return retval;
+}
+
+static int command_stats(db_t *db, const char *filepath, int argc, char *argv[])
+{
+    stats_t  stats;
+    uint64_t disk;
+    int      err;
+
+    unused(argc);
+    unused(argv);
+
+    memset(&stats, 0, sizeof(stats_t));
+    stats.min_value = SIZE_MAX;
+
+    err = 0;
+    if(db_iterate(db, count_record, &stats, &err) < 0)
+    {
+        fprintf(stderr, "command_stats::db_iterate: %s\n", strerror(err ? err : EIO));
+        return -1;
+    }
+
+    disk = files_size(db->engine, filepath);
+
+    printf("Records:  %zu\n", stats.nrecords);
+    printf("Keys:     %llu bytes\n", (unsigned long long)stats.key_bytes);
+    printf("Values:   %llu bytes", (unsigned long long)stats.value_bytes);
+    if(stats.nrecords > 0)
+    {
+        printf(" (min %zu, max %zu, mean %llu)", stats.min_value, stats.max_value, (unsigned long long)(stats.value_bytes / stats.nrecords));
+    }
+    printf("\nOn disk:  %llu bytes", (unsigned long long)disk);
+    if(disk > 0)
+    {
+        printf(" (%.1f%% keys and values)", (double)(stats.key_bytes + stats.value_bytes) * 100.0 / (double)disk);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+    printf("\n\nValue sizes:\n");
+
+    for(size_t idx = 0; idx < HISTOGRAM_BUCKETS; idx++)
+    {
+        if(stats.histogram[idx] == 0)
+        {
+            continue;
+        }
+
+        if(idx == 0)
+        {
+            printf("  %20s  %zu\n", "0", stats.histogram[idx]);
+        }
+        else
+        {
+            char   range[48];    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            size_t low = (size_t)1 << (idx - 1);
+
+            snprintf(range, sizeof(range), "%zu - %zu", low, low + (low - 1));
+            printf("  %20s  %zu\n", range, stats.histogram[idx]);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Copies every live record into a fresh database next to this one and swaps its files in. Records that have been
+ * overwritten, and whatever space the engine lost to them, are left behind. A failed copy or flush removes the
+ * partial copy and leaves the database as it was.
+ *
+ * The files are renamed one at a time, so an engine that keeps several of them isn't swapped atomically. Should a
+ * rename fail after an earlier one succeeded, the database is left with a mix of old and compacted files. The rest of
+ * the compacted files are then kept under the temporary name, so the swap can be finished by hand.
+ */
+static int command_compact(db_t *db, const char *filepath, int argc, char *argv[])
+{
+    const db_engine_t *source = db->engine;
+    const db_engine_t *target = argc > 0 ? db_find_engine(argv[0]) : source;
+    uint64_t           before;
+    size_t             renamed = 0;
+    char              *tmp_path;
+    db_t               compacted;
+    copy_t             copy;
+    int                retval = 0;
+    int                err;
+
+    if(target == NULL)
+    {
+        fprintf(stderr, "command_compact: The database engine must be either 'ndbm' or 'log'.\n");
+        return -1;
+    }
+
+    errno    = 0;
+    tmp_path = make_string("%s%s", filepath, COMPACT_SUFFIX);
+    if(tmp_path == NULL)
+    {
+        fprintf(stderr, "command_compact::make_string: %s\n", strerror(errno));
+        return -2;
+    }
+
+    // Whatever an interrupted compaction left behind
+    remove_files(target, tmp_path);
+
+    err = 0;
+    if(db_init(&compacted, target->name, tmp_path, &err) < 0)
+    {
+        fprintf(stderr, "command_compact::db_init: %s\n", strerror(err));
+        free(tmp_path);
+        return -3;
+    }
+
+    memset(&copy, 0, sizeof(copy_t));
+    copy.db = &compacted;
+
+    // Any stop short of the last record, a failed put included, must keep the original in place
+    err = 0;
+    if(db_iterate(db, copy_record, &copy, &err) != 0 || copy.err != 0)
+    {
+        fprintf(stderr, "command_compact::db_iterate: %s\n", strerror(copy.err ? copy.err : (err ? err : EIO)));
+        retval = -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    err = 0;
+    if(db_flush(&compacted, true, &err) < 0)
+    {
+        fprintf(stderr, "command_compact::db_flush: %s\n", strerror(err));
+        retval = -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    db_destroy(&compacted);
+    before = files_size(source, filepath);
+    db_destroy(db);
+
+    err = 0;
+    if(rename_files(target, tmp_path, filepath, &renamed, &err) < 0)
+    {
+        fprintf(stderr, "command_compact::rename_files: %s\n", strerror(err));
+        if(renamed > 0)
+        {
+            fprintf(stderr, "command_compact: %s holds a mix of old and compacted files, the rest are kept at %s\n", filepath, tmp_path);
+        }
+        retval = -6;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    // Converted, the old engine's files are no longer needed
+    if(target != source)
+    {
+        for(const char *const *suffix = source->files; *suffix; suffix++)
+        {
+            char *path = keeps_file(target, *suffix) ? NULL : make_string("%s%s", filepath, *suffix);
+
+            if(path)
+            {
+                unlink(path);
+                free(path);
+            }
+        }
+    }
+
+    fprintf(stderr, "Compacted %zu records from %llu to %llu bytes.\n", copy.nrecords, (unsigned long long)before, (unsigned long long)files_size(target, filepath));
+
+cleanup:
+    db_destroy(&compacted);
+    if(retval < 0 && renamed == 0)
+    {
+        remove_files(target, tmp_path);
+    }
+    free(tmp_path);
+
+    return retval;
+}
+
+static int write_record(const char *key, const uint8_t *value, size_t len, void *arg)
+{
+    output_t *output  = (output_t *)arg;
+    size_t    key_len = strlen(key);
+
+    if((output->first && strcmp(key, output->first) < 0) || (output->last && strcmp(key, output->last) >= 0))
+    {
+        return 0;
+    }
+
+    if(output->binary)
+    {
+        export_record_t record;
+
+        record.key_len   = key_len;
+        record.value_len = len;
+        if(fwrite(&record, sizeof(export_record_t), 1, output->out) != 1 || fwrite(key, 1, key_len, output->out) != key_len || fwrite(value, 1, len, output->out) != len)
+        {
+            return -1;
+        }
+    }
+    else if(fwrite(key, 1, key_len, output->out) != key_len || fputs(": ", output->out) == EOF || fwrite(value, 1, len, output->out) != len || fputc('\n', output->out) == EOF)
+    {
+        return -2;
+    }
+
+    output->nrecords++;
+    return 0;
+}
+
+static int count_record(const char *key, const uint8_t *value, size_t len, void *arg)
+{
+    stats_t *stats  = (stats_t *)arg;
+    size_t   bucket = len == 0 ? 0 : (size_t)(64 - __builtin_clzll((unsigned long long)len));    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+    unused(value);
+
+    stats->nrecords++;
+    stats->key_bytes += strlen(key);
+    stats->value_bytes += len;
+    stats->min_value = len < stats->min_value ? len : stats->min_value;
+    stats->max_value = len > stats->max_value ? len : stats->max_value;
+    stats->histogram[bucket]++;
+
+    return 0;
+}
+
+static int copy_record(const char *key, const uint8_t *value, size_t len, void *arg)
+{
+    copy_t *copy = (copy_t *)arg;
+
+    if(db_insert(copy->db, key, value, len, &copy->err) < 0)
+    {
+        return -1;
+    }
+
+    copy->nrecords++;
+    return 0;
+}
+
+// Returns 1 once `size` bytes have been read, 0 at the end of the input, or -1 if it ends partway through
+static int read_exact(FILE *in, void *buf, size_t size)
 {
-    DBM  *db;
-    datum key;
-    char *name = strdup(argv[1]);
+    size_t nread;
 
-    (void)(argc);
+    if(size == 0)
+    {
+        return 1;
+    }
 
-    db = dbm_open(name, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-    if(!db)
+    nread = fread(buf, 1, size, in);
+    if(nread == size)
     {
-        perror("main::dbm_open");
-        free(name);
         return 1;
     }
 
-    for(key = dbm_firstkey(db); key.dptr != NULL; key = dbm_nextkey(db))
+    return nread == 0 && feof(in) ? 0 : -1;
+}
+
+static uint64_t files_size(const db_engine_t *engine, const char *filepath)
+{
+    uint64_t total = 0;
+
+    for(const char *const *suffix = engine->files; *suffix; suffix++)
+    {
+        char       *path = make_string("%s%s", filepath, *suffix);
+        struct stat st;
+
+        if(path && stat(path, &st) == 0)
+        {
+            total += (uint64_t)st.st_size;
+        }
+        free(path);
+    }
+
+    return total;
+}
+
+/*
+ * Files the engine didn't create are skipped, some NDBM implementations keep a single file. `renamed` counts the files
+ * moved before a failure, those can't be moved back since they replaced the originals.
+ */
+static int rename_files(const db_engine_t *engine, const char *from, const char *to, size_t *renamed, int *err)
+{
+    for(const char *const *suffix = engine->files; *suffix; suffix++)
     {
-        datum val = dbm_fetch(db, key);
-        log_info("%.*s: %.*s\n", key.dsize, key.dptr, val.dsize, val.dptr);
+        char *from_path = make_string("%s%s", from, *suffix);
+        char *to_path   = make_string("%s%s", to, *suffix);
+        int   retval    = 0;
+
+        if(from_path == NULL || to_path == NULL)
+        {
+            seterr(ENOMEM);
+            retval = -1;
+        }
+        else if(rename(from_path, to_path) == 0)
+        {
+            (*renamed)++;
+        }
+        else if(errno != ENOENT)
+        {
+            seterr(errno);
+            retval = -2;
+        }
+
+        free(from_path);
+        free(to_path);
+        if(retval < 0)
+        {
+            return retval;
+        }
     }
 
-    dbm_close(db);
-    free(name);
     return 0;
 }
+
+static void remove_files(const db_engine_t *engine, const char *filepath)
+{
+    for(const char *const *suffix = engine->files; *suffix; suffix++)
+    {
+        char *path = make_string("%s%s", filepath, *suffix);
+
+        if(path)
+        {
+            unlink(path);
+            free(path);
+        }
+    }
+}
+
+static bool keeps_file(const db_engine_t *engine, const char *suffix)
+{
+    for(const char *const *kept = engine->files; *kept; kept++)
+    {
+        if(strcmp(*kept, suffix) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,637 @@
+#include "logger.h"
+#include "ndbm/database.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+ * Append-only log engine.
+ *
+ * Every put appends a record to `<filepath>.log`, a record that is stored again simply shadows the older copy. An
+ * in-memory hash index maps every key to its newest record and is rebuilt by scanning the log when it is opened, so
+ * writes are purely sequential and a lookup is a single read.
+ *
+ * Puts are collected in a write buffer and go out with one write per flush, a whole batch of records costs one
+ * system call. A record whose checksum doesn't match marks the end of the log: it was torn by a crash and is cut off
+ * along with everything after it.
+ */
+
+#define LOG_SUFFIX ".log"
+#define LOG_MAGIC 0x474F4C52U            // "RLOG"
+#define LOG_MIN_SLOTS 1024               // Power of two
+#define LOG_BUFFER_SIZE (1024 * 1024)    // Larger records bypass the write buffer
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t checksum;    // FNV-1a of the key and the value
+    uint32_t key_len;     // Without the NUL terminator, which is not stored
+    uint32_t reserved;
+    uint64_t value_len;
+} log_header_t;
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t key_len;       // 0 for empty slots
+    size_t   key_offset;    // Into `keys`
+    uint64_t offset;        // Position of the record's header in the log
+    uint64_t value_len;
+} log_slot_t;
+
+typedef struct
+{
+    int      fd;
+    uint64_t end;    // Bytes written to the file, buffered records start here
+
+    uint8_t *wbuf;
+    size_t   wbuf_len;
+    size_t   wbuf_size;
+
+    // Open-addressed index of the newest record of every key, keys are kept NUL terminated in one buffer
+    log_slot_t *slots;
+    size_t      nslots;
+    size_t      nrecords;
+    char       *keys;
+    size_t      keys_len;
+    size_t      keys_size;
+
+    uint8_t *rbuf;    // Value returned by the last get
+    size_t   rbuf_size;
+} log_db_t;
+
+static int      log_engine_open(void **handle, const char *filepath, int *err);
+static int      log_engine_put(void *handle, const char *key, const uint8_t *value, size_t len, int *err);
+static uint8_t *log_engine_get(void *handle, const char *key, size_t *len, int *err);
+static int      log_engine_iterate(void *handle, db_iterate_fn fn, void *arg, int *err);
+static int      log_engine_flush(void *handle, bool durable, int *err);
+static void     log_engine_close(void *handle);
+
+static int         replay_log(log_db_t *db, int *err);
+static log_slot_t *index_find(const log_db_t *db, const char *key, size_t key_len, uint32_t hash);
+static int         index_put(log_db_t *db, const char *key, size_t key_len, uint64_t offset, uint64_t value_len);
+static int         index_grow(log_db_t *db);
+static uint32_t    record_checksum(const char *key, size_t key_len, const uint8_t *value, size_t len);
+static int         write_all(int fd, struct iovec *iov, size_t iovcnt, int *err);
+
+static const char *const log_engine_files[] = {LOG_SUFFIX, NULL};
+
+const db_engine_t db_log_engine = {"log", log_engine_files, log_engine_open, log_engine_put, log_engine_get, log_engine_iterate, log_engine_flush, log_engine_close};
+
+static int log_engine_open(void **handle, const char *filepath, int *err)
+{
+    log_db_t *db;
+    char     *path;
+
+    errno = 0;
+    db    = (log_db_t *)calloc(1, sizeof(log_db_t));
+    if(db == NULL)
+    {
+        seterr(errno);
+        return -1;
+    }
+
+    errno = 0;
+    path  = make_string("%s%s", filepath, LOG_SUFFIX);
+    if(path == NULL)
+    {
+        seterr(errno);
+        free(db);
+        return -2;
+    }
+
+    // Appends always land at the end, even if the file was cut short while replaying it
+    errno  = 0;
+    db->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    free(path);
+    if(db->fd < 0)
+    {
+        seterr(errno);
+        free(db);
+        return -3;
+    }
+
+    if(replay_log(db, err) < 0)
+    {
+        log_engine_close(db);
+        return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+    *handle = db;
+    return 0;
+}
+
+/*
+ * Appends a record to the write buffer, or straight to the file when it doesn't fit in the buffer at all. The index
+ * points at the new record right away, gets read buffered records from the buffer.
+ */
+static int log_engine_put(void *handle, const char *key, const uint8_t *value, size_t len, int *err)
+{
+    log_db_t    *db      = (log_db_t *)handle;
+    size_t       key_len = strlen(key);
+    size_t       size    = sizeof(log_header_t) + key_len + len;
+    uint64_t     offset;
+    log_header_t header;
+
+    if(key_len == 0 || key_len > UINT32_MAX)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(log_header_t));
+    header.magic     = LOG_MAGIC;
+    header.checksum  = record_checksum(key, key_len, value, len);
+    header.key_len   = (uint32_t)key_len;
+    header.value_len = len;
+
+    if(db->wbuf_size - db->wbuf_len < size && log_engine_flush(db, false, err) < 0)
+    {
+        return -2;
+    }
+
+    offset = db->end + db->wbuf_len;
+    if(size > LOG_BUFFER_SIZE)
+    {
+        struct iovec iov[3];    // Header, key and value
+
+        iov[0].iov_base = &header;
+        iov[0].iov_len  = sizeof(log_header_t);
+        iov[1].iov_base = (void *)(uintptr_t)key;
+        iov[1].iov_len  = key_len;
+        iov[2].iov_base = (void *)(uintptr_t)value;
+        iov[2].iov_len  = len;
+
+        if(write_all(db->fd, iov, arrlen(iov), err) < 0)
+        {
+            return -3;
+        }
+        db->end += size;
+    }
+    else
+    {
+        if(db->wbuf == NULL)
+        {
+            errno    = 0;
+            db->wbuf = (uint8_t *)malloc(LOG_BUFFER_SIZE);
+            if(db->wbuf == NULL)
+            {
+                seterr(errno);
+                return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            }
+            db->wbuf_size = LOG_BUFFER_SIZE;
+        }
+
+        memcpy(db->wbuf + db->wbuf_len, &header, sizeof(log_header_t));
+        memcpy(db->wbuf + db->wbuf_len + sizeof(log_header_t), key, key_len);
+        memcpy(db->wbuf + db->wbuf_len + sizeof(log_header_t) + key_len, value, len);
+        db->wbuf_len += size;
+    }
+
+    if(index_put(db, key, key_len, offset, len) < 0)
+    {
+        seterr(ENOMEM);
+        return -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+    return 0;
+}
+
+static uint8_t *log_engine_get(void *handle, const char *key, size_t *len, int *err)
+{
+    log_db_t         *db      = (log_db_t *)handle;
+    size_t            key_len = strlen(key);
+    const log_slot_t *slot    = index_find(db, key, key_len, hash_bytes(key, key_len));
+    uint64_t          position;
+    size_t            nread = 0;
+
+    if(slot == NULL)
+    {
+        seterr(ENOENT);
+        return NULL;
+    }
+
+    position = slot->offset + sizeof(log_header_t) + slot->key_len;
+    *len     = (size_t)slot->value_len;
+
+    // Still in the write buffer
+    if(slot->offset >= db->end)
+    {
+        return db->wbuf + (position - db->end);
+    }
+
+    if(db->rbuf_size < *len || db->rbuf == NULL)
+    {
+        size_t   size = *len > 0 ? *len : 1;
+        uint8_t *rbuf = (uint8_t *)realloc(db->rbuf, size);
+
+        if(rbuf == NULL)
+        {
+            seterr(ENOMEM);
+            return NULL;
+        }
+
+        db->rbuf      = rbuf;
+        db->rbuf_size = size;
+    }
+
+    while(nread < *len)
+    {
+        ssize_t tread;
+
+        errno = 0;
+        tread = pread(db->fd, db->rbuf + nread, *len - nread, (off_t)(position + nread));
+        if(tread < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if(tread <= 0)
+        {
+            seterr(tread < 0 ? errno : EIO);
+            return NULL;
+        }
+
+        nread += (size_t)tread;
+    }
+
+    return db->rbuf;
+}
+
+/*
+ * Walks the log in order and hands out every record the index still points at, so the file is read sequentially and
+ * shadowed records are skipped.
+ */
+static int log_engine_iterate(void *handle, db_iterate_fn fn, void *arg, int *err)
+{
+    log_db_t *db = (log_db_t *)handle;
+    uint8_t  *map;
+    uint64_t  position = 0;
+    char     *key      = NULL;
+    size_t    keysize  = 0;
+    int       retval   = 0;
+
+    if(log_engine_flush(db, false, err) < 0)
+    {
+        return -1;
+    }
+
+    if(db->end == 0)
+    {
+        return 0;
+    }
+
+    errno = 0;
+    map   = (uint8_t *)mmap(NULL, (size_t)db->end, PROT_READ, MAP_SHARED, db->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    while(position < db->end)
+    {
+        log_header_t      header;
+        const log_slot_t *slot;
+
+        memcpy(&header, map + position, sizeof(log_header_t));
+
+        if(keysize < (size_t)header.key_len + 1)
+        {
+            char *tkey = (char *)realloc(key, (size_t)header.key_len + 1);
+
+            if(tkey == NULL)
+            {
+                seterr(ENOMEM);
+                retval = -3;
+                break;
+            }
+
+            key     = tkey;
+            keysize = (size_t)header.key_len + 1;
+        }
+
+        memcpy(key, map + position + sizeof(log_header_t), header.key_len);
+        key[header.key_len] = '\0';
+
+        slot = index_find(db, key, header.key_len, hash_bytes(key, header.key_len));
+        if(slot != NULL && slot->offset == position)
+        {
+            retval = fn(key, map + position + sizeof(log_header_t) + header.key_len, (size_t)header.value_len, arg);
+            if(retval != 0)
+            {
+                break;
+            }
+        }
+
+        position += sizeof(log_header_t) + header.key_len + header.value_len;
+    }
+
+    free(key);
+    munmap(map, (size_t)db->end);
+    return retval;
+}
+
+static int log_engine_flush(void *handle, bool durable, int *err)
+{
+    log_db_t *db = (log_db_t *)handle;
+
+    if(db->wbuf_len > 0)
+    {
+        struct iovec iov;
+
+        iov.iov_base = db->wbuf;
+        iov.iov_len  = db->wbuf_len;
+
+        if(write_all(db->fd, &iov, 1, err) < 0)
+        {
+            return -1;
+        }
+
+        db->end += db->wbuf_len;
+        db->wbuf_len = 0;
+    }
+
+    errno = 0;
+    if(durable && fsync(db->fd) < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    return 0;
+}
+
+static void log_engine_close(void *handle)
+{
+    log_db_t *db = (log_db_t *)handle;
+
+    if(db->fd > -1 && log_engine_flush(db, false, NULL) < 0)
+    {
+        log_error("log_engine_close::log_engine_flush: Lost %zu bytes of records.\n", db->wbuf_len);
+    }
+
+    if(db->fd > -1)
+    {
+        close(db->fd);
+    }
+
+    free(db->wbuf);
+    free(db->slots);
+    free(db->keys);
+    free(db->rbuf);
+    free(db);
+}
+
+/*
+ * Rebuilds the index from the log. The log is cut off at the first record that is incomplete or doesn't match its
+ * checksum, the rest of the file can't be trusted.
+ */
+static int replay_log(log_db_t *db, int *err)
+{
+    struct stat    st;
+    const uint8_t *map;
+    uint64_t       position = 0;
+
+    errno = 0;
+    if(fstat(db->fd, &st) < 0)
+    {
+        seterr(errno);
+        return -1;
+    }
+
+    if(st.st_size == 0)
+    {
+        return 0;
+    }
+
+    errno = 0;
+    map   = (const uint8_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, db->fd, 0);
+    if(map == MAP_FAILED)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    while((uint64_t)st.st_size - position >= sizeof(log_header_t))
+    {
+        log_header_t header;
+        const char  *key;
+        uint64_t     available = (uint64_t)st.st_size - position - sizeof(log_header_t);
+
+        memcpy(&header, map + position, sizeof(log_header_t));
+        if(header.magic != LOG_MAGIC || header.key_len == 0 || header.key_len > available || header.value_len > available - header.key_len)
+        {
+            break;
+        }
+
+        key = (const char *)map + position + sizeof(log_header_t);
+        if(record_checksum(key, header.key_len, (const uint8_t *)key + header.key_len, (size_t)header.value_len) != header.checksum)
+        {
+            break;
+        }
+
+        if(index_put(db, key, header.key_len, position, header.value_len) < 0)
+        {
+            munmap((void *)(uintptr_t)map, (size_t)st.st_size);
+            seterr(ENOMEM);
+            return -3;
+        }
+
+        position += sizeof(log_header_t) + header.key_len + header.value_len;
+    }
+
+    munmap((void *)(uintptr_t)map, (size_t)st.st_size);
+
+    if(position < (uint64_t)st.st_size)
+    {
+        log_warn("replay_log: Dropping %lld bytes of torn records at the end of the log.\n", (long long)((uint64_t)st.st_size - position));
+
+        errno = 0;
+        if(ftruncate(db->fd, (off_t)position) < 0)
+        {
+            seterr(errno);
+            return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        }
+    }
+
+    db->end = position;
+    log_debug("Replayed %zu records (%llu bytes) from the log.\n", db->nrecords, (unsigned long long)position);
+
+    return 0;
+}
+
+static log_slot_t *index_find(const log_db_t *db, const char *key, size_t key_len, uint32_t hash)
+{
+    if(db->nslots == 0)
+    {
+        return NULL;
+    }
+
+    for(size_t idx = hash & (db->nslots - 1);; idx = (idx + 1) & (db->nslots - 1))
+    {
+        log_slot_t *slot = &db->slots[idx];
+
+        if(slot->key_len == 0)
+        {
+            return NULL;
+        }
+
+        if(slot->hash == hash && slot->key_len == key_len && memcmp(db->keys + slot->key_offset, key, key_len) == 0)
+        {
+            return slot;
+        }
+    }
+}
+
+/*
+ * Points the key at a record, adding the key if it is new. The table is kept at most three quarters full.
+ */
+static int index_put(log_db_t *db, const char *key, size_t key_len, uint64_t offset, uint64_t value_len)
+{
+    uint32_t    hash = hash_bytes(key, key_len);
+    log_slot_t *slot = index_find(db, key, key_len, hash);
+    size_t      idx;
+
+    if(slot != NULL)
+    {
+        slot->offset    = offset;
+        slot->value_len = value_len;
+        return 0;
+    }
+
+    if((db->nrecords + 1) * 4 > db->nslots * 3 && index_grow(db) < 0)
+    {
+        return -1;
+    }
+
+    if(db->keys_size - db->keys_len < key_len + 1)
+    {
+        size_t size = db->keys_size == 0 ? LOG_MIN_SLOTS * 16 : db->keys_size;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        char  *keys;
+
+        while(size - db->keys_len < key_len + 1)
+        {
+            size *= 2;
+        }
+
+        keys = (char *)realloc(db->keys, size);
+        if(keys == NULL)
+        {
+            return -2;
+        }
+
+        db->keys      = keys;
+        db->keys_size = size;
+    }
+
+    for(idx = hash & (db->nslots - 1); db->slots[idx].key_len != 0; idx = (idx + 1) & (db->nslots - 1))
+    {
+    }
+
+    slot             = &db->slots[idx];
+    slot->hash       = hash;
+    slot->key_len    = (uint32_t)key_len;
+    slot->key_offset = db->keys_len;
+    slot->offset     = offset;
+    slot->value_len  = value_len;
+
+    memcpy(db->keys + db->keys_len, key, key_len);
+    db->keys[db->keys_len + key_len] = '\0';
+    db->keys_len += key_len + 1;
+    db->nrecords++;
+
+    return 0;
+}
+
+static int index_grow(log_db_t *db)
+{
+    size_t      nslots = db->nslots == 0 ? LOG_MIN_SLOTS : db->nslots * 2;
+    log_slot_t *slots  = (log_slot_t *)calloc(nslots, sizeof(log_slot_t));
+
+    if(slots == NULL)
+    {
+        return -1;
+    }
+
+    for(size_t old = 0; old < db->nslots; old++)
+    {
+        size_t idx;
+
+        if(db->slots[old].key_len == 0)
+        {
+            continue;
+        }
+
+        for(idx = db->slots[old].hash & (nslots - 1); slots[idx].key_len != 0; idx = (idx + 1) & (nslots - 1))
+        {
+        }
+        slots[idx] = db->slots[old];
+    }
+
+    free(db->slots);
+    db->slots  = slots;
+    db->nslots = nslots;
+
+    return 0;
+}
+
+static uint32_t record_checksum(const char *key, size_t key_len, const uint8_t *value, size_t len)
+{
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    for(size_t idx = 0; idx < key_len; idx++)
+    {
+        hash = (hash ^ (uint8_t)key[idx]) * FNV_PRIME;
+    }
+
+    for(size_t idx = 0; idx < len; idx++)
+    {
+        hash = (hash ^ value[idx]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static int write_all(int fd, struct iovec *iov, size_t iovcnt, int *err)
+{
+    while(iovcnt > 0)
+    {
+        ssize_t nwritten;
+
+        errno    = 0;
+        nwritten = writev(fd, iov, (int)iovcnt);
+        if(nwritten < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if(nwritten < 0)
+        {
+            seterr(errno);
+            return -1;
+        }
+
+        while(iovcnt > 0 && (size_t)nwritten >= iov->iov_len)
+        {
+            nwritten -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + nwritten;
+            iov->iov_len -= (size_t)nwritten;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,549 @@
+#include "ndbm/snapshot.h"
+#include "logger.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SNAPSHOT_SUFFIX ".snap"
+#define SNAPSHOT_TMP_SUFFIX ".snap.tmp"
+#define SNAPSHOT_BUFFER_SIZE (1024 * 1024)
+#define SNAPSHOT_ALIGNMENT 8    // The entry table is read in place
+
+// Collects the records of the database into a new snapshot file
+typedef struct
+{
+    int      fd;
+    int      err;
+    uint8_t *buf;
+    size_t   buf_len;
+    uint64_t offset;    // Bytes written to the file and the buffer so far
+
+    db_snapshot_entry_t *entries;
+    size_t               nentries;
+    size_t               entries_size;
+} snapshot_writer_t;
+
+// An entry while the table is sorted, along with its key
+typedef struct
+{
+    const uint8_t      *key;
+    db_snapshot_entry_t entry;
+} snapshot_sort_item_t;
+
+static int  collect_record(const char *key, const uint8_t *value, size_t len, void *arg);
+static int  write_snapshot(snapshot_writer_t *writer, db_t *db, uint64_t generation, int *err);
+static int  writer_append(snapshot_writer_t *writer, const void *data, size_t size);
+static int  writer_flush(snapshot_writer_t *writer);
+static int  compare_items(const void *a, const void *b);
+static int  compare_key(const uint8_t *key, size_t key_len, const uint8_t *other, size_t other_len);
+static void remap_snapshot(db_snapshot_t *snapshot);
+
+/*
+ * Maps the shared sequence counter. Called by the server before forking, so the store and every worker inherit the
+ * same one. Nothing is mapped until the store publishes its first snapshot.
+ */
+int db_snapshot_init(db_snapshot_t *snapshot, const char *filepath, int *err)
+{
+    void *sequence;
+
+    seterr(0);
+    if(snapshot == NULL || filepath == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(snapshot, 0, sizeof(db_snapshot_t));
+
+    errno          = 0;
+    snapshot->path = make_string("%s%s", filepath, SNAPSHOT_SUFFIX);
+    if(snapshot->path == NULL)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    errno              = 0;
+    snapshot->tmp_path = make_string("%s%s", filepath, SNAPSHOT_TMP_SUFFIX);
+    if(snapshot->tmp_path == NULL)
+    {
+        seterr(errno);
+        db_snapshot_destroy(snapshot);
+        return -3;
+    }
+
+    errno    = 0;
+    sequence = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(sequence == MAP_FAILED)
+    {
+        seterr(errno);
+        db_snapshot_destroy(snapshot);
+        return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+    snapshot->sequence = (uint64_t *)sequence;
+
+    return 0;
+}
+
+void db_snapshot_destroy(db_snapshot_t *snapshot)
+{
+    if(snapshot == NULL)
+    {
+        return;
+    }
+
+    if(snapshot->base)
+    {
+        munmap(snapshot->base, snapshot->size);
+    }
+
+    if(snapshot->sequence)
+    {
+        munmap(snapshot->sequence, sizeof(uint64_t));
+    }
+
+    free(snapshot->path);
+    free(snapshot->tmp_path);
+    memset(snapshot, 0, sizeof(db_snapshot_t));
+}
+
+/*
+ * Writes every record of the database into a new snapshot and swaps it in. Workers still reading the previous one
+ * keep it mapped until they notice the new one, renaming over it doesn't take it away from them.
+ */
+int db_snapshot_publish(db_snapshot_t *snapshot, db_t *db, uint64_t generation, int *err)
+{
+    snapshot_writer_t writer;
+    int               retval = 0;
+
+    seterr(0);
+    if(snapshot == NULL || snapshot->sequence == NULL || db == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(&writer, 0, sizeof(snapshot_writer_t));
+
+    errno     = 0;
+    writer.fd = open(snapshot->tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if(writer.fd < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    errno      = 0;
+    writer.buf = (uint8_t *)malloc(SNAPSHOT_BUFFER_SIZE);
+    if(writer.buf == NULL)
+    {
+        seterr(errno);
+        retval = -3;
+        goto cleanup;
+    }
+
+    if(write_snapshot(&writer, db, generation, err) < 0)
+    {
+        retval = -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    errno = 0;
+    if(rename(snapshot->tmp_path, snapshot->path) < 0)
+    {
+        seterr(errno);
+        retval = -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    __atomic_add_fetch(snapshot->sequence, 1, __ATOMIC_RELEASE);
+    log_debug("Published a snapshot of %zu records (%llu bytes).\n", writer.nentries, (unsigned long long)writer.offset);
+
+cleanup:
+    close(writer.fd);
+    if(retval < 0)
+    {
+        unlink(snapshot->tmp_path);
+    }
+    free(writer.buf);
+    free(writer.entries);
+
+    return retval;
+}
+
+/*
+ * Looks a record up in the newest snapshot, mapping it first if the store has published one since the last lookup.
+ *
+ * Returns 1 with the value, 0 if the snapshot knows there is no such record, or -1 if there is no snapshot or inserts
+ * have been committed since it was taken. The value stays valid until the next lookup.
+ */
+int db_snapshot_lookup(db_snapshot_t *snapshot, uint64_t generation, const char *key, const uint8_t **value, size_t *len)
+{
+    const db_snapshot_entry_t *entries;
+    size_t                     key_len = strlen(key);
+    size_t                     low     = 0;
+    size_t                     high;
+
+    if(snapshot->sequence == NULL)
+    {
+        return -1;
+    }
+
+    if(__atomic_load_n(snapshot->sequence, __ATOMIC_ACQUIRE) != snapshot->seen)
+    {
+        remap_snapshot(snapshot);
+    }
+
+    if(snapshot->header == NULL || snapshot->header->generation != generation)
+    {
+        return -1;
+    }
+
+    entries = snapshot->entries;
+    high    = (size_t)snapshot->header->nrecords;
+    while(low < high)
+    {
+        size_t mid   = low + ((high - low) / 2);
+        int    order = compare_key((const uint8_t *)key, key_len, snapshot->base + entries[mid].key_offset, (size_t)entries[mid].key_len);
+
+        if(order == 0)
+        {
+            *value = snapshot->base + entries[mid].value_offset;
+            *len   = (size_t)entries[mid].value_len;
+            return 1;
+        }
+
+        if(order < 0)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return 0;
+}
+
+static int collect_record(const char *key, const uint8_t *value, size_t len, void *arg)
+{
+    snapshot_writer_t   *writer  = (snapshot_writer_t *)arg;
+    size_t               key_len = strlen(key);
+    db_snapshot_entry_t *entry;
+
+    if(writer->nentries == writer->entries_size)
+    {
+        size_t               size    = writer->entries_size == 0 ? SNAPSHOT_BUFFER_SIZE / sizeof(db_snapshot_entry_t) : writer->entries_size * 2;
+        db_snapshot_entry_t *entries = (db_snapshot_entry_t *)realloc(writer->entries, size * sizeof(db_snapshot_entry_t));
+
+        if(entries == NULL)
+        {
+            writer->err = ENOMEM;
+            return -1;
+        }
+
+        writer->entries      = entries;
+        writer->entries_size = size;
+    }
+
+    entry               = &writer->entries[writer->nentries++];
+    entry->key_offset   = writer->offset;
+    entry->key_len      = key_len;
+    entry->value_offset = writer->offset + key_len + 1;
+    entry->value_len    = len;
+
+    if(writer_append(writer, key, key_len + 1) < 0 || writer_append(writer, value, len) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Header placeholder, heap, then the entry table sorted by key. The header is filled in last, once the table's offset
+ * is known.
+ */
+static int write_snapshot(snapshot_writer_t *writer, db_t *db, uint64_t generation, int *err)
+{
+    static const uint8_t  padding[SNAPSHOT_ALIGNMENT] = {0};
+    db_snapshot_header_t  header;
+    snapshot_sort_item_t *items = NULL;
+    void                 *heap  = MAP_FAILED;
+    uint64_t              index_offset;
+    int                   retval = 0;
+
+    memset(&header, 0, sizeof(db_snapshot_header_t));
+    if(writer_append(writer, &header, sizeof(db_snapshot_header_t)) < 0)
+    {
+        seterr(writer->err);
+        return -1;
+    }
+
+    if(db_iterate(db, collect_record, writer, err) < 0)
+    {
+        if(writer->err != 0)
+        {
+            seterr(writer->err);
+        }
+        return -2;
+    }
+
+    if(writer->offset % SNAPSHOT_ALIGNMENT != 0 && writer_append(writer, padding, SNAPSHOT_ALIGNMENT - (writer->offset % SNAPSHOT_ALIGNMENT)) < 0)
+    {
+        seterr(writer->err);
+        return -3;
+    }
+
+    if(writer_flush(writer) < 0)
+    {
+        seterr(writer->err);
+        return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+    index_offset = writer->offset;
+
+    // The keys are sorted in place, through a mapping of the heap that was just written
+    if(writer->nentries > 0)
+    {
+        errno = 0;
+        heap  = mmap(NULL, (size_t)index_offset, PROT_READ, MAP_SHARED, writer->fd, 0);
+        if(heap == MAP_FAILED)
+        {
+            seterr(errno);
+            return -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        }
+
+        errno = 0;
+        items = (snapshot_sort_item_t *)malloc(writer->nentries * sizeof(snapshot_sort_item_t));
+        if(items == NULL)
+        {
+            seterr(errno);
+            retval = -6;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            goto cleanup;
+        }
+
+        for(size_t i = 0; i < writer->nentries; i++)
+        {
+            items[i].key   = (const uint8_t *)heap + writer->entries[i].key_offset;
+            items[i].entry = writer->entries[i];
+        }
+
+        qsort(items, writer->nentries, sizeof(snapshot_sort_item_t), compare_items);
+
+        for(size_t i = 0; i < writer->nentries; i++)
+        {
+            if(writer_append(writer, &items[i].entry, sizeof(db_snapshot_entry_t)) < 0)
+            {
+                seterr(writer->err);
+                retval = -7;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                goto cleanup;
+            }
+        }
+    }
+
+    if(writer_flush(writer) < 0)
+    {
+        seterr(writer->err);
+        retval = -8;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto cleanup;
+    }
+
+    header.magic        = DB_SNAPSHOT_MAGIC;
+    header.version      = DB_SNAPSHOT_VERSION;
+    header.generation   = generation;
+    header.nrecords     = writer->nentries;
+    header.index_offset = index_offset;
+    header.size         = writer->offset;
+
+    errno = 0;
+    if(pwrite(writer->fd, &header, sizeof(db_snapshot_header_t), 0) != (ssize_t)sizeof(db_snapshot_header_t))
+    {
+        seterr(errno ? errno : EIO);
+        retval = -9;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+cleanup:
+    free(items);
+    if(heap != MAP_FAILED)
+    {
+        munmap(heap, (size_t)index_offset);
+    }
+
+    return retval;
+}
+
+static int writer_append(snapshot_writer_t *writer, const void *data, size_t size)
+{
+    if(writer->buf_len + size > SNAPSHOT_BUFFER_SIZE)
+    {
+        if(writer_flush(writer) < 0)
+        {
+            return -1;
+        }
+    }
+
+    // Values larger than the buffer are written straight through
+    if(size > SNAPSHOT_BUFFER_SIZE)
+    {
+        const uint8_t *bytes = (const uint8_t *)data;
+        size_t         left  = size;
+
+        while(left > 0)
+        {
+            ssize_t nwrote;
+
+            errno  = 0;
+            nwrote = write(writer->fd, bytes, left);
+            if(nwrote < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                writer->err = errno;
+                return -2;
+            }
+
+            bytes += nwrote;
+            left -= (size_t)nwrote;
+        }
+
+        writer->offset += size;
+        return 0;
+    }
+
+    memcpy(writer->buf + writer->buf_len, data, size);
+    writer->buf_len += size;
+    writer->offset += size;
+
+    return 0;
+}
+
+static int writer_flush(snapshot_writer_t *writer)
+{
+    size_t written = 0;
+
+    while(written < writer->buf_len)
+    {
+        ssize_t nwrote;
+
+        errno  = 0;
+        nwrote = write(writer->fd, writer->buf + written, writer->buf_len - written);
+        if(nwrote < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            writer->err = errno;
+            return -1;
+        }
+
+        written += (size_t)nwrote;
+    }
+
+    writer->buf_len = 0;
+
+    return 0;
+}
+
+static int compare_items(const void *a, const void *b)
+{
+    const snapshot_sort_item_t *item  = (const snapshot_sort_item_t *)a;
+    const snapshot_sort_item_t *other = (const snapshot_sort_item_t *)b;
+
+    return compare_key(item->key, (size_t)item->entry.key_len, other->key, (size_t)other->entry.key_len);
+}
+
+// Byte order, a key sorts before every longer key it is a prefix of
+static int compare_key(const uint8_t *key, size_t key_len, const uint8_t *other, size_t other_len)
+{
+    int order = memcmp(key, other, key_len < other_len ? key_len : other_len);
+
+    if(order != 0)
+    {
+        return order;
+    }
+
+    if(key_len == other_len)
+    {
+        return 0;
+    }
+
+    return key_len < other_len ? -1 : 1;
+}
+
+/*
+ * Maps the newest snapshot in place of the current one. A snapshot that can't be opened or doesn't look right leaves
+ * this process without one, lookups go to the store until the next publish.
+ */
+static void remap_snapshot(db_snapshot_t *snapshot)
+{
+    const db_snapshot_header_t *header;
+    const db_snapshot_entry_t  *table;
+    struct stat                 st;
+    uint64_t                    sequence;
+    void                       *base;
+    int                         fd;
+
+    sequence = __atomic_load_n(snapshot->sequence, __ATOMIC_ACQUIRE);
+
+    if(snapshot->base)
+    {
+        munmap(snapshot->base, snapshot->size);
+    }
+    snapshot->seen    = sequence;
+    snapshot->base    = NULL;
+    snapshot->size    = 0;
+    snapshot->header  = NULL;
+    snapshot->entries = NULL;
+
+    errno = 0;
+    fd    = open(snapshot->path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        log_error("remap_snapshot::open: %s\n", strerror(errno));
+        return;
+    }
+
+    errno = 0;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(db_snapshot_header_t))
+    {
+        log_error("remap_snapshot::fstat: %s\n", errno ? strerror(errno) : "Truncated snapshot");
+        close(fd);
+        return;
+    }
+
+    errno = 0;
+    base  = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+    {
+        log_error("remap_snapshot::mmap: %s\n", strerror(errno));
+        return;
+    }
+
+    header = (const db_snapshot_header_t *)base;
+    if(header->magic != DB_SNAPSHOT_MAGIC || header->version != DB_SNAPSHOT_VERSION || header->size != (uint64_t)st.st_size || header->index_offset % SNAPSHOT_ALIGNMENT != 0 || header->index_offset > header->size ||
+       header->nrecords > (header->size - header->index_offset) / sizeof(db_snapshot_entry_t))
+    {
+        log_error("remap_snapshot: Invalid snapshot %s\n", snapshot->path);
+        munmap(base, (size_t)st.st_size);
+        return;
+    }
+
+    // The table's offset was checked to be aligned above
+    table             = (const db_snapshot_entry_t *)(const void *)((const uint8_t *)base + header->index_offset);
+    snapshot->base    = (uint8_t *)base;
+    snapshot->size    = (size_t)st.st_size;
+    snapshot->header  = header;
+    snapshot->entries = table;
+}
@@ -2,6 +2,7 @@
 #include "utils.h"
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <memory.h>
 #include <netinet/in.h>
 #include <stdint.h>
@@ -29,7 +30,13 @@ int tcp_socket(struct sockaddr_storage *sockaddr, int *err)
     return sockfd;
 }
 
-int tcp_server(char *address, in_port_t port)
+/*
+ * Creates a non-blocking listener.
+ *
+ * With `reuseport`, several processes can each own a listener on the same address and the kernel spreads incoming
+ * connections between them.
+ */
+int tcp_server(char *address, in_port_t port, bool reuseport)
 {
     int ISETOPTION = 1;
     int err;
@@ -63,6 +70,25 @@ int tcp_server(char *address, in_port_t port)
         goto exit;
     }
 
+    if(reuseport)
+    {
+#ifdef SO_REUSEPORT
+        errno = 0;
+        if(setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, (char *)&ISETOPTION, sizeof(ISETOPTION)) == -1)
+        {
+            perror("tcp_server::setsockopt");
+            close(sockfd);
+            sockfd = -6;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            goto exit;
+        }
+#else
+        fputs("tcp_server::setsockopt: SO_REUSEPORT is not supported on this platform\n", stderr);
+        close(sockfd);
+        sockfd = -6;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto exit;
+#endif
+    }
+
     // Bind the socket
     errno = 0;
     if(bind(sockfd, (struct sockaddr *)&sockaddr, socklen) < 0)
@@ -83,6 +109,16 @@ int tcp_server(char *address, in_port_t port)
         goto exit;
     }
 
+    // Accepting is done until EAGAIN, so the socket must not block once the backlog is empty
+    errno = 0;
+    if(fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        perror("tcp_server::fcntl");
+        close(sockfd);
+        sockfd = -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        goto exit;
+    }
+
 exit:
     return sockfd;
 }
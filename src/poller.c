@@ -0,0 +1,414 @@
+#include "poller.h"
+#include "utils.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+#endif
+
+#define POLLER_MAX_EVENTS 64
+
+#ifdef __linux__
+
+static uint32_t to_epoll_events(const poller_t *poller, short events)
+{
+    uint32_t epoll_events = 0;
+
+    if(events & POLLIN)
+    {
+        epoll_events |= EPOLLIN;
+    }
+
+    if(events & POLLOUT)
+    {
+        epoll_events |= EPOLLOUT;
+    }
+
+    if(events & POLLHUP)
+    {
+        epoll_events |= EPOLLRDHUP;
+    }
+
+    if(poller->edge_triggered)
+    {
+        epoll_events |= EPOLLET;
+    }
+
+    return epoll_events;
+}
+
+static short from_epoll_events(uint32_t epoll_events)
+{
+    short events = 0;
+
+    if(epoll_events & EPOLLIN)
+    {
+        events |= POLLIN;
+    }
+
+    if(epoll_events & EPOLLOUT)
+    {
+        events |= POLLOUT;
+    }
+
+    if(epoll_events & (EPOLLHUP | EPOLLRDHUP))
+    {
+        events |= POLLHUP;
+    }
+
+    if(epoll_events & EPOLLERR)
+    {
+        events |= POLLERR;
+    }
+
+    return events;
+}
+
+int poller_init(poller_t *poller, size_t max_fds, bool edge_triggered, int *err)
+{
+    seterr(0);
+    if(poller == NULL || max_fds < 1)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    poller->max_fds        = max_fds;
+    poller->nfds           = 0;
+    poller->edge_triggered = edge_triggered;
+
+    errno        = 0;
+    poller->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(poller->epfd < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    return 0;
+}
+
+int poller_destroy(poller_t *poller, int *err)
+{
+    seterr(0);
+    if(poller == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(poller->epfd > -1)
+    {
+        close(poller->epfd);
+    }
+
+    poller->epfd = -1;
+    poller->nfds = 0;
+
+    return 0;
+}
+
+int poller_add(poller_t *poller, int fd, short events, void *data, int *err)
+{
+    struct epoll_event event;
+
+    seterr(0);
+    if(poller == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(poller->nfds == poller->max_fds)
+    {
+        seterr(ENOSPC);
+        return -2;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events   = to_epoll_events(poller, events);
+    event.data.ptr = data;
+
+    errno = 0;
+    if(epoll_ctl(poller->epfd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        seterr(errno);
+        return -3;
+    }
+
+    poller->nfds++;
+
+    return 0;
+}
+
+int poller_modify(poller_t *poller, int fd, short events, void *data, int *err)
+{
+    struct epoll_event event;
+
+    seterr(0);
+    if(poller == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events   = to_epoll_events(poller, events);
+    event.data.ptr = data;
+
+    // Modifying an fd makes epoll re-check its readiness, so an edge-triggered fd that is already ready reports again
+    errno = 0;
+    if(epoll_ctl(poller->epfd, EPOLL_CTL_MOD, fd, &event) < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    return 0;
+}
+
+int poller_remove(poller_t *poller, int fd, int *err)
+{
+    seterr(0);
+    if(poller == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    errno = 0;
+    if(epoll_ctl(poller->epfd, EPOLL_CTL_DEL, fd, NULL) < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    poller->nfds--;
+
+    return 0;
+}
+
+int poller_wait(poller_t *poller, poller_event_t *events, size_t max_events, int timeout, int *err)
+{
+    struct epoll_event epoll_events[POLLER_MAX_EVENTS];
+    int                nevents;
+
+    seterr(0);
+    if(poller == NULL || events == NULL || max_events < 1)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(max_events > POLLER_MAX_EVENTS)
+    {
+        max_events = POLLER_MAX_EVENTS;
+    }
+
+    errno   = 0;
+    nevents = epoll_wait(poller->epfd, epoll_events, (int)max_events, timeout);
+    if(nevents < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    for(int idx = 0; idx < nevents; idx++)
+    {
+        events[idx].fd      = -1;    // epoll only hands back the user data
+        events[idx].revents = from_epoll_events(epoll_events[idx].events);
+        events[idx].data    = epoll_events[idx].data.ptr;
+    }
+
+    return nevents;
+}
+
+#else
+
+static int find_pollfd(const poller_t *poller, int fd)
+{
+    for(size_t idx = 0; idx < poller->nfds; idx++)
+    {
+        if(poller->pollfds[idx].fd == fd)
+        {
+            return (int)idx;
+        }
+    }
+
+    return -1;
+}
+
+int poller_init(poller_t *poller, size_t max_fds, bool edge_triggered, int *err)
+{
+    seterr(0);
+    if(poller == NULL || max_fds < 1)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    poller->max_fds        = max_fds;
+    poller->nfds           = 0;
+    poller->edge_triggered = edge_triggered;
+
+    errno           = 0;
+    poller->pollfds = (struct pollfd *)calloc(max_fds, sizeof(struct pollfd));
+    if(poller->pollfds == NULL)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    errno        = 0;
+    poller->data = (void **)calloc(max_fds, sizeof(void *));
+    if(poller->data == NULL)
+    {
+        seterr(errno);
+        free(poller->pollfds);
+        return -3;
+    }
+
+    return 0;
+}
+
+int poller_destroy(poller_t *poller, int *err)
+{
+    seterr(0);
+    if(poller == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    free(poller->pollfds);
+    free((void *)poller->data);
+    poller->pollfds = NULL;
+    poller->data    = NULL;
+    poller->nfds    = 0;
+
+    return 0;
+}
+
+int poller_add(poller_t *poller, int fd, short events, void *data, int *err)
+{
+    seterr(0);
+    if(poller == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(poller->nfds == poller->max_fds)
+    {
+        seterr(ENOSPC);
+        return -2;
+    }
+
+    poller->pollfds[poller->nfds].fd      = fd;
+    poller->pollfds[poller->nfds].events  = (short)(events | POLLHUP | POLLERR);
+    poller->pollfds[poller->nfds].revents = 0;
+    poller->data[poller->nfds]            = data;
+    poller->nfds++;
+
+    return 0;
+}
+
+int poller_modify(poller_t *poller, int fd, short events, void *data, int *err)
+{
+    int idx;
+
+    seterr(0);
+    if(poller == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    idx = find_pollfd(poller, fd);
+    if(idx < 0)
+    {
+        seterr(ENOENT);
+        return -2;
+    }
+
+    poller->pollfds[idx].events = (short)(events | POLLHUP | POLLERR);
+    poller->data[idx]           = data;
+
+    return 0;
+}
+
+/*
+ * Removes the fd by moving the last entry into its place, so nothing has to be shifted.
+ */
+int poller_remove(poller_t *poller, int fd, int *err)
+{
+    int    idx;
+    size_t last;
+
+    seterr(0);
+    if(poller == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    idx = find_pollfd(poller, fd);
+    if(idx < 0)
+    {
+        seterr(ENOENT);
+        return -2;
+    }
+
+    last                  = poller->nfds - 1;
+    poller->pollfds[idx]  = poller->pollfds[last];
+    poller->data[idx]     = poller->data[last];
+    poller->pollfds[last] = (struct pollfd){-1, 0, 0};
+    poller->data[last]    = NULL;
+    poller->nfds--;
+
+    return 0;
+}
+
+int poller_wait(poller_t *poller, poller_event_t *events, size_t max_events, int timeout, int *err)
+{
+    int    poll_result;
+    size_t nevents;
+
+    seterr(0);
+    if(poller == NULL || events == NULL || max_events < 1)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    errno       = 0;
+    poll_result = poll(poller->pollfds, (nfds_t)poller->nfds, timeout);
+    if(poll_result < 0)
+    {
+        seterr(errno);
+        return -2;
+    }
+
+    nevents = 0;
+    for(size_t idx = 0; idx < poller->nfds && nevents < max_events && poll_result > 0; idx++)
+    {
+        if(poller->pollfds[idx].revents == 0)
+        {
+            continue;
+        }
+
+        events[nevents].fd      = poller->pollfds[idx].fd;
+        events[nevents].revents = poller->pollfds[idx].revents;
+        events[nevents].data    = poller->data[idx];
+        nevents++;
+        poll_result--;
+    }
+
+    return (int)nevents;
+}
+
+#endif
@@ -1,11 +1,13 @@
+#include "cache.h"
 #include "handlers.h"
 #include "loader.h"
 #include "logger.h"
+#include "ndbm/database.h"
 #include "networking.h"
 #include "state.h"
+#include "store.h"
 #include "utils.h"
 #include "worker.h"
-#include <dlfcn.h>
 #include <errno.h>
 #include <getopt.h>
 #include <poll.h>
@@ -14,19 +16,39 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
 #define UNKNOWN_OPTION_MESSAGE_LEN 22
-#define POLL_TIMEOUT (-1)
+#define POLL_TIMEOUT CACHE_REFRESH_INTERVAL    // Wake up to refresh the static file cache even when idle
+#define MAX_EVENTS 64
 #define MAX_CLIENTS 1024
 #define PUBLIC_DIR "./public/"
+#define IDLE_TIMEOUT 15
+#define MAX_REQUESTS 1000
+#define CACHE_SIZE 32       // MiB
+#define MAX_BODY_SIZE 16    // MiB
+#define DB_PREFIX "/db"
+#define DB_DURABILITY "none"
+#define DB_SNAPSHOT_MS 1000
+#define BYTES_PER_MIB (1024 * 1024)
 
 typedef struct
 {
     char       *address;
     in_port_t   port;
     bool        debug;
+    bool        edge_triggered;
+    bool        reuseport;
+    bool        strict_parser;
+    unsigned    idle_timeout;
+    size_t      max_requests;
+    size_t      cache_size;
+    size_t      max_body_size;
+    const char *db_prefix;
+    const char *db_engine;
+    unsigned    db_flush_ms;
+    unsigned    db_snapshot_ms;
+    const char *db_durability;
     const char *libhttp_path;
     size_t      workers;
     const char *public_dir;
@@ -35,8 +57,10 @@ typedef struct
 static _Noreturn void usage(const char *binary_name, int exit_code, const char *message);
 static void           get_arguments(arguments_t *args, int argc, char *argv[]);
 static void           validate_arguments(const char *binary_name, arguments_t *args);
+static void           handle_library_change(app_state_t *app);
 
-static bool volatile is_running = true;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static bool volatile is_running       = true;     // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static bool volatile reload_requested = false;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
 
 static void signal_handler_fn(int signal)
 {
@@ -44,6 +68,10 @@ static void signal_handler_fn(int signal)
     {
         is_running = false;
     }
+    else if(signal == SIGHUP)
+    {
+        reload_requested = true;
+    }
 }
 
 int main(int argc, char *argv[])
@@ -52,8 +80,11 @@ int main(int argc, char *argv[])
 
     int sockfd;
 
-    app_state_t app;
-    arguments_t args;
+    app_state_t     app;
+    arguments_t     args;
+    worker_config_t worker_config;
+    store_config_t  store_config;
+    char           *store_path;
 
     setup_signals(signal_handler_fn);
 
@@ -68,115 +99,228 @@ int main(int argc, char *argv[])
 
     // Setup app state
     err = 0;
-    if(app_init(&app, MAX_CLIENTS, &err) < 0)
+    if(app_init(&app, MAX_CLIENTS, args.edge_triggered, &err) < 0)
     {
         log_error("main::app_init: %s\n", strerror(err));
         return EXIT_FAILURE;
     }
 
+    // One process owns the database, workers send it their inserts and lookups
+    errno      = 0;
+    store_path = make_string("./store-%d.sock", getpid());
+    if(store_path == NULL)
+    {
+        log_error("main::make_string: %s\n", strerror(errno));
+        app_destroy(&app, NULL);
+        return EXIT_FAILURE;
+    }
+
+    store_config.db_engine            = args.db_engine;
+    store_config.db_path              = DB_RECORDS;
+    store_config.socket_path          = store_path;
+    store_config.max_clients          = MAX_CLIENTS;
+    store_config.flush_interval_ms    = args.db_flush_ms;
+    store_config.snapshot_interval_ms = args.db_snapshot_ms;
+    store_config.durability           = strcmp(args.db_durability, "sync") == 0 ? STORE_DURABILITY_SYNC : STORE_DURABILITY_NONE;
+
+    err = 0;
+    if(app_start_store(&app, &store_config, &err) < 0)
+    {
+        log_error("main::app_start_store: %s\n", strerror(err));
+        free(store_path);
+        app_destroy(&app, NULL);
+        return EXIT_FAILURE;
+    }
+
+    // Workers load the HTTP library themselves
+    worker_config.public_dir     = args.public_dir;
+    worker_config.libhttp_path   = args.libhttp_path;
+    worker_config.edge_triggered = args.edge_triggered;
+    worker_config.strict_parser  = args.strict_parser;
+    worker_config.idle_timeout   = args.idle_timeout;
+    worker_config.max_requests   = args.max_requests;
+    worker_config.max_body_size  = args.max_body_size * BYTES_PER_MIB;
+    worker_config.db_prefix      = args.db_prefix;
+    worker_config.store_path     = store_path;
+    worker_config.reuseport      = args.reuseport;
+    worker_config.address        = args.address;
+    worker_config.port           = args.port;
+
+    // The server renders the cached header blocks, so it needs the HTTP library for content types. Workers inherit the
+    // loaded library when they are forked and only reload it when told to.
     if(reload_library(args.libhttp_path) < 0)
     {
-        log_error("main::reload_library: %s\n", dlerror());
+        log_warn("main::reload_library: Failed to load HTTP library, requests will fail until it is reloaded.\n");
+    }
+
+    // Reload the library whenever it is rebuilt, SIGHUP does the same where it can't be watched
+    err = 0;
+    if(app_watch_library(&app, args.libhttp_path, &err) < 0)
+    {
+        log_warn("main::app_watch_library: Not watching the HTTP library, send SIGHUP to reload it (%s).\n", strerror(err));
+    }
+
+    // Build the static file cache before forking so every worker starts out with the snapshot mapped
+    err = 0;
+    if(app_init_cache(&app, args.public_dir, args.cache_size * BYTES_PER_MIB, &err) < 0)
+    {
+        log_warn("main::app_init_cache: Static file cache disabled (%s).\n", strerror(err));
     }
 
     // Set number of available workers
     app_set_desired_workers(&app, args.workers, NULL);
 
     // Setup TCP Server
-    sockfd = tcp_server(args.address, args.port);
-    if(sockfd < -1)
+    sockfd = tcp_server(args.address, args.port, args.reuseport);
+    if(sockfd < 0)
     {
         return EXIT_FAILURE;
     }
     log_info("Listening on %s:%d.\n", args.address, args.port);
 
-    // Add SOCKFD to poll list
-    app.pollfds[0].fd     = sockfd;
-    app.pollfds[0].events = POLLIN;
-    app.npollfds++;
+    if(args.reuseport)
+    {
+        // Every worker opens its own listener, the server's one was only needed to check that the address can be bound.
+        // Keeping it open would make the kernel route connections to a socket nobody accepts on.
+        close(sockfd);
+        sockfd = -1;
+        log_debug("\n%sServer | Init%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        log_debug("Workers accept on their own SO_REUSEPORT listeners.\n");
+    }
+    else
+    {
+        // Add SOCKFD to the poller
+        err = 0;
+        if(app_listen(&app, sockfd, &err) < 0)
+        {
+            log_error("main::app_listen: %s\n", strerror(err));
+            close(sockfd);
+            return EXIT_FAILURE;
+        }
 
-    log_debug("\n%sServer | Init%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
-    log_debug("Added server socket to poll list.\n");
+        log_debug("\n%sServer | Init%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        log_debug("Added server socket to the poller (%s-triggered).\n", args.edge_triggered ? "edge" : "level");
+    }
 
     // Poll for connections
     log_debug("Polling for data...\n");
     while(is_running)
     {
-        int poll_result;
+        poller_event_t events[MAX_EVENTS];
+        int            nevents;
 
         // Scale workers
         app_health_check_workers(&app, NULL);
-        if(app_scale_workers(&app, args.public_dir, &err) < 0)
+        if(app_scale_workers(&app, &worker_config, &err) < 0)
         {
             log_error("main::app_scale_workers: Failed to scale workers (%s)\n", strerror(err));
         }
 
-        // Listen for events
-        errno       = 0;
-        poll_result = poll(app.pollfds, (nfds_t)app.npollfds, POLL_TIMEOUT);
-        if(poll_result < 0)
+        // Pick up changed files and access patterns
+        if(app.cache.stats)
         {
-            if(errno != EINTR)
-            {
-                log_error("main::poll: %s\n", strerror(errno));
-            }
+            app_refresh_cache(&app, false, NULL);
         }
 
-        // Check incoming connections to server
-        if(app.pollfds[0].revents & POLLIN)
-        {    // On client connect...
-            // Accept the client and assign the client to a worker...
-            handle_client_connect(app.pollfds[0].fd, &app, args.libhttp_path);
+        // Swap in a rebuilt HTTP library
+        if(reload_requested)
+        {
+            reload_requested = false;
+            handle_library_change(&app);
         }
 
-        // Iterate through all workers
-        for(size_t idx = 0; idx < app.nworkers; idx++)
+        // Listen for events
+        err     = 0;
+        nevents = app_wait(&app, events, MAX_EVENTS, POLL_TIMEOUT, &err);
+        if(nevents < 0)
         {
-            struct pollfd *worker_pollfd = &app.pollfds[1 + idx];
-            worker_t      *worker        = app_find_worker_by_fd(&app, worker_pollfd->fd);
-
-            int status;
-
-            if(worker == NULL || worker->pid == 0 || worker->fd < 0 || worker->client.fd < 0)
+            if(err != EINTR)
             {
-                continue;    // Only allow workers with assigned clients
+                log_error("main::app_wait: %s\n", strerror(err));
             }
+            continue;
+        }
 
-            if(waitpid(worker->pid, &status, WNOHANG) != 0 && WIFEXITED(status))
-            {
-                worker_pollfd->revents |= POLLHUP;
+        // Every event carries a pointer to its worker, NULL for the server socket or the library watch's own fd
+        for(int idx = 0; idx < nevents; idx++)
+        {
+            const poller_event_t *event  = &events[idx];
+            worker_t             *worker = (worker_t *)event->data;
+
+            if(worker == NULL)
+            {    // On client connect...
+                // Accept the client and hand the client to a worker...
+                handle_client_connect(app.sockfd, &app);
+                continue;
             }
 
-            if(worker_pollfd->revents & POLLIN)
+            if(event->data == &app.libwatch_fd)
+            {    // Something in the library's directory has changed
+                if(app_library_changed(&app))
+                {
+                    handle_library_change(&app);
+                }
+                continue;
+            }
+
+            if(worker->pid == 0 || worker->fd < 0)
             {
-                handle_worker_connect(worker, worker->fd);
+                continue;    // The worker has been removed while handling an earlier event
             }
 
-            if(worker_pollfd->revents & (POLLHUP | POLLERR))
+            if(event->revents & POLLIN)
+            {    // The worker has closed some of its clients, or has exited
+                handle_worker_message(worker, &app);
+            }
+            else if(event->revents & (POLLHUP | POLLERR))
             {
                 handle_worker_disconnect(worker, &app);
             }
         }
     }
 
-    close(sockfd);
+    if(sockfd > -1)
+    {
+        close(sockfd);
+    }
 
-    for(size_t idx = 0; idx < app.nworkers; idx++)
+    for(size_t idx = 0; idx < app.nworker_slots; idx++)
     {
         const worker_t *worker = &app.workers[idx];
 
-        if(app_remove_worker(&app, worker->pid, NULL) < 0)
+        if(worker->pid > 0 && app_remove_worker(&app, worker->pid, NULL) < 0)
         {
             log_error("main::app_remove_worker: Failed to remove worker.\n");
         }
     }
 
+    // Every insert a worker has sent is committed before the store exits
+    if(app_stop_store(&app, &err) < 0)
+    {
+        log_error("main::app_stop_store: %s\n", strerror(err));
+    }
+    free(store_path);
+
     app_destroy(&app, NULL);
 
     // Done!
     return EXIT_SUCCESS;
 }
 
+static void handle_library_change(app_state_t *app)
+{
+    int err;
+
+    err = 0;
+    if(app_reload_library(app, &err) < 0)
+    {
+        log_error("main::app_reload_library: Failed to reload \"%s\", keeping the loaded library.\n", app->libhttp_path);
+        return;
+    }
+
+    log_info("Reloaded the HTTP library.\n");
+}
+
 static _Noreturn void usage(const char *binary_name, int exit_code, const char *message)
 {
     if(message)
@@ -184,15 +328,27 @@ static _Noreturn void usage(const char *binary_name, int exit_code, const char *
         fprintf(stderr, "%s\n\n", message);
     }
 
-    fprintf(stderr, "Usage: %s [-h] [-d] [-l <filepath>] [-w <workers>] -a <address> -p <port>\n", binary_name);
+    fprintf(stderr, "Usage: %s [-h] [-d] [-e] [-r] [-S] [-l <filepath>] [-w <workers>] [-t <seconds>] [-m <requests>] [-c <MiB>] [-b <MiB>] [-P <prefix>] [-E <engine>] [-F <ms>] [-i <ms>] [-D <none|sync>] -a <address> -p <port>\n", binary_name);
     fputs("Options:\n", stderr);
     fputs("  -a, --address <address>   Address of the web server\n", stderr);
     fputs("  -p, --port <port>         Port to bind to\n", stderr);
     fputs("  -h, --help                Display this help message\n", stderr);
     fputs("  -d, --debug               Enables the debug mode\n", stderr);
     fputs("  -l, --lib <filepath>      Filepath to an accompanying HTTP library.\n", stderr);
-    fputs("  -w, --workers <workers>   Number of workers to always be available.\n", stderr);
+    fputs("  -w, --workers <workers>   Number of workers to always be available (default: one per core).\n", stderr);
     fputs("  -s, --serve <directory>   Serve files from inside this directory.\n", stderr);
+    fputs("  -e, --edge-triggered      Use edge-triggered instead of level-triggered polling.\n", stderr);
+    fputs("  -r, --reuseport           Let every worker accept on its own SO_REUSEPORT listener.\n", stderr);
+    fputs("  -t, --idle-timeout <secs> Seconds an idle keep-alive connection is kept open.\n", stderr);
+    fputs("  -m, --max-requests <num>  Requests answered on a connection before it is closed.\n", stderr);
+    fputs("  -c, --cache-size <MiB>    Size of the static file cache shared by the workers.\n", stderr);
+    fputs("  -b, --max-body <MiB>      Largest request body accepted, larger ones are refused with 413.\n", stderr);
+    fputs("  -P, --db-prefix <prefix>  GET <prefix>/<key> reads back what was POSTed to /<key> (default: /db).\n", stderr);
+    fputs("  -E, --db-engine <engine>  Storage engine for records, 'ndbm' or the append-only 'log' (default: ndbm).\n", stderr);
+    fputs("  -F, --db-flush <ms>       Milliseconds inserts wait to be committed together (default: 0).\n", stderr);
+    fputs("  -i, --db-snapshot <ms>    Milliseconds between read-only snapshots of the records (default: 1000).\n", stderr);
+    fputs("  -D, --durability <mode>   'sync' syncs every commit to disk before acknowledging it (default: none).\n", stderr);
+    fputs("  -S, --strict-parser       Parse requests with the full HTTP grammar instead of the fast scanner.\n", stderr);
     exit(exit_code);
 }
 
@@ -202,17 +358,29 @@ static void get_arguments(arguments_t *args, int argc, char *argv[])
     int opt;
 
     static struct option long_options[] = {
-        {"address", required_argument, NULL, 'a'},
-        {"port",    required_argument, NULL, 'p'},
-        {"debug",   no_argument,       NULL, 'd'},
-        {"lib",     required_argument, NULL, 'l'},
-        {"workers", required_argument, NULL, 'w'},
-        {"serve",   required_argument, NULL, 's'},
-        {"help",    no_argument,       NULL, 'h'},
-        {NULL,      0,                 NULL, 0  }
+        {"address",        required_argument, NULL, 'a'},
+        {"port",           required_argument, NULL, 'p'},
+        {"debug",          no_argument,       NULL, 'd'},
+        {"lib",            required_argument, NULL, 'l'},
+        {"workers",        required_argument, NULL, 'w'},
+        {"serve",          required_argument, NULL, 's'},
+        {"edge-triggered", no_argument,       NULL, 'e'},
+        {"reuseport",      no_argument,       NULL, 'r'},
+        {"idle-timeout",   required_argument, NULL, 't'},
+        {"max-requests",   required_argument, NULL, 'm'},
+        {"cache-size",     required_argument, NULL, 'c'},
+        {"max-body",       required_argument, NULL, 'b'},
+        {"db-prefix",      required_argument, NULL, 'P'},
+        {"db-engine",      required_argument, NULL, 'E'},
+        {"db-flush",       required_argument, NULL, 'F'},
+        {"db-snapshot",    required_argument, NULL, 'i'},
+        {"durability",     required_argument, NULL, 'D'},
+        {"strict-parser",  no_argument,       NULL, 'S'},
+        {"help",           no_argument,       NULL, 'h'},
+        {NULL,             0,                 NULL, 0  }
     };
 
-    while((opt = getopt_long(argc, argv, "hda:p:l:w:s:", long_options, NULL)) != -1)
+    while((opt = getopt_long(argc, argv, "hderSa:p:l:w:s:t:m:c:b:P:E:F:i:D:", long_options, NULL)) != -1)
     {
         switch(opt)
         {
@@ -244,6 +412,72 @@ static void get_arguments(arguments_t *args, int argc, char *argv[])
             case 's':
                 args->public_dir = optarg;
                 break;
+            case 'e':
+                args->edge_triggered = true;
+                break;
+            case 'r':
+                args->reuseport = true;
+                break;
+            case 'S':
+                args->strict_parser = true;
+                break;
+            case 't':
+                if(optarg)
+                {
+                    char *end;
+
+                    args->idle_timeout = (unsigned)strtoul(optarg, &end, 10);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                }
+                break;
+            case 'm':
+                if(optarg)
+                {
+                    char *end;
+
+                    args->max_requests = strtoul(optarg, &end, 10);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                }
+                break;
+            case 'c':
+                if(optarg)
+                {
+                    char *end;
+
+                    args->cache_size = strtoul(optarg, &end, 10);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                }
+                break;
+            case 'b':
+                if(optarg)
+                {
+                    char *end;
+
+                    args->max_body_size = strtoul(optarg, &end, 10);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                }
+                break;
+            case 'P':
+                args->db_prefix = optarg;
+                break;
+            case 'E':
+                args->db_engine = optarg;
+                break;
+            case 'F':
+                if(optarg)
+                {
+                    char *end;
+
+                    args->db_flush_ms = (unsigned)strtoul(optarg, &end, 10);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                }
+                break;
+            case 'i':
+                if(optarg)
+                {
+                    char *end;
+
+                    args->db_snapshot_ms = (unsigned)strtoul(optarg, &end, 10);    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+                }
+                break;
+            case 'D':
+                args->db_durability = optarg;
+                break;
             case 'h':
                 usage(argv[0], EXIT_SUCCESS, NULL);
             case '?':
@@ -278,13 +512,77 @@ static void validate_arguments(const char *binary_name, arguments_t *args)
         args->libhttp_path = LIBHTTP_PATH;
     }
 
+    // Every worker multiplexes its own connections, so one per core is enough by default
     if(args->workers == 0)
     {
-        args->workers = NUM_WORKERS;
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+        args->workers = ncpus > 0 ? (size_t)ncpus : NUM_WORKERS;
+    }
+
+    if(args->idle_timeout == 0)
+    {
+        args->idle_timeout = IDLE_TIMEOUT;
+    }
+
+    if(args->max_requests == 0)
+    {
+        args->max_requests = MAX_REQUESTS;
+    }
+
+    if(args->cache_size == 0)
+    {
+        args->cache_size = CACHE_SIZE;
+    }
+
+    if(args->max_body_size == 0)
+    {
+        args->max_body_size = MAX_BODY_SIZE;
     }
 
     if(args->public_dir == NULL)
     {
         args->public_dir = PUBLIC_DIR;
     }
+
+    if(args->db_prefix == NULL)
+    {
+        args->db_prefix = DB_PREFIX;
+    }
+
+    if(args->db_prefix[0] != '/')
+    {
+        usage(binary_name, EXIT_FAILURE, "The database prefix must start with '/'.");
+    }
+
+    // "/" alone would turn every request into a record lookup, static files could no longer be served
+    if(strcmp(args->db_prefix, "/") == 0)
+    {
+        usage(binary_name, EXIT_FAILURE, "The database prefix must name a path below '/'.");
+    }
+
+    if(args->db_engine == NULL)
+    {
+        args->db_engine = DB_ENGINE_DEFAULT;
+    }
+
+    if(db_find_engine(args->db_engine) == NULL)
+    {
+        usage(binary_name, EXIT_FAILURE, "The database engine must be either 'ndbm' or 'log'.");
+    }
+
+    if(args->db_snapshot_ms == 0)
+    {
+        args->db_snapshot_ms = DB_SNAPSHOT_MS;
+    }
+
+    if(args->db_durability == NULL)
+    {
+        args->db_durability = DB_DURABILITY;
+    }
+
+    if(strcmp(args->db_durability, "none") != 0 && strcmp(args->db_durability, "sync") != 0)
+    {
+        usage(binary_name, EXIT_FAILURE, "The database durability must be either 'none' or 'sync'.");
+    }
 }
@@ -1,6 +1,9 @@
 #include "state.h"
 #include "logger.h"
 #include "ndbm/database.h"
+#include "io.h"
+#include "loader.h"
+#include "networking.h"
 #include "utils.h"
 #include "worker.h"
 #include <errno.h>
@@ -12,9 +15,14 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-static int reset_pollfd(struct pollfd *pollfd, int *err);
+#ifdef __linux__
+    #include <limits.h>
+    #include <sys/inotify.h>
+#endif
 
-int app_init(app_state_t *state, size_t max_clients, int *err)
+static void close_inherited_fds(app_state_t *state);
+
+int app_init(app_state_t *state, size_t max_clients, bool edge_triggered, int *err)
 {
     seterr(0);
     if(state == NULL || max_clients < 1)
@@ -23,21 +31,32 @@ int app_init(app_state_t *state, size_t max_clients, int *err)
         return -1;
     }
 
-    if(db_init(&state->db, DB_RECORDS, err) < 0)
+    if(db_cache_init(&state->db_cache, err) < 0)
     {
         return -2;
     }
 
-    state->npollfds    = 0;
-    state->nworkers    = 0;
-    state->max_clients = max_clients;
+    // Mapped once the store is started and knows where the records are
+    memset(&state->snapshot, 0, sizeof(db_snapshot_t));
 
-    // +1 because we want include the server socket without impacting client limits.
-    errno          = 0;
-    state->pollfds = (struct pollfd *)calloc(max_clients + 1, sizeof(struct pollfd));
-    if(state->pollfds == NULL)
+    state->store_pid     = 0;
+    state->nworkers      = 0;
+    state->nworker_slots = 0;
+    state->max_clients   = max_clients;
+    state->sockfd        = -1;
+
+    // The cache stays empty until `app_init_cache`
+    memset(&state->cache, 0, sizeof(cache_t));
+    state->cache.fd           = -1;
+    state->cache_refreshed_ms = 0;
+
+    // The library is only watched once `app_watch_library` succeeds
+    state->libhttp_path = NULL;
+    state->libwatch_fd  = -1;
+
+    // +2 because we want include the server socket and the library watch without impacting client limits.
+    if(poller_init(&state->poller, max_clients + 2, edge_triggered, err) < 0)
     {
-        seterr(errno);
         return -3;
     }
 
@@ -54,16 +73,93 @@ int app_init(app_state_t *state, size_t max_clients, int *err)
         reset_worker(&state->workers[idx], NULL);
     }
 
-    for(size_t idx = 0; idx < max_clients + 1; idx++)
+    return 0;
+}
+
+int app_destroy(app_state_t *state, int *err)
+{
+    seterr(0);
+    if(state == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    free(state->workers);
+    poller_destroy(&state->poller, NULL);
+    cache_destroy(&state->cache, NULL);
+
+    if(state->libwatch_fd > -1)
     {
-        reset_pollfd(&state->pollfds[idx], NULL);
+        close(state->libwatch_fd);
     }
 
+    db_cache_destroy(&state->db_cache);
+    db_snapshot_destroy(&state->snapshot);
+
     return 0;
 }
 
-int app_destroy(app_state_t *state, int *err)
+/*
+ * Forks the store process. Its socket is listening before the fork returns, so workers spawned afterwards can connect
+ * right away.
+ */
+int app_start_store(app_state_t *state, const store_config_t *config, int *err)
+{
+    int   listenfd;
+    pid_t pid;
+
+    seterr(0);
+    if(state == NULL || config == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(db_snapshot_init(&state->snapshot, config->db_path, err) < 0)
+    {
+        return -2;
+    }
+
+    listenfd = dmn_server(config->socket_path, err);
+    if(listenfd < 0)
+    {
+        db_snapshot_destroy(&state->snapshot);
+        return -3;
+    }
+
+    errno = 0;
+    pid   = fork();
+    if(pid < 0)
+    {
+        seterr(errno);
+        close(listenfd);
+        unlink(config->socket_path);
+        db_snapshot_destroy(&state->snapshot);
+        return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+    if(pid == 0)    // Store
+    {
+        close_inherited_fds(state);
+        store_entrypoint(listenfd, &state->db_cache, &state->snapshot, config);
+    }
+
+    close(listenfd);
+    state->store_pid = pid;
+
+    log_debug("Store[PID:%d] spawned.\n", pid);
+
+    return 0;
+}
+
+/*
+ * Stops the store once the workers are gone. It commits what it has received before it exits.
+ */
+int app_stop_store(app_state_t *state, int *err)
 {
+    int status;
+
     seterr(0);
     if(state == NULL)
     {
@@ -71,11 +167,24 @@ int app_destroy(app_state_t *state, int *err)
         return -1;
     }
 
-    free(state->workers);
-    free(state->pollfds);
+    if(state->store_pid <= 0)
+    {
+        return 0;
+    }
 
-    db_destroy(&state->db);
+    kill(state->store_pid, SIGINT);
+
+    errno = 0;
+    while(waitpid(state->store_pid, &status, 0) < 0)
+    {
+        if(errno != EINTR)
+        {
+            seterr(errno);
+            return -2;
+        }
+    }
 
+    state->store_pid = 0;
     return 0;
 }
 
@@ -91,7 +200,8 @@ worker_t *app_create_worker(app_state_t *state, int *err)
     pid = spawn_worker(&worker, err);
     if(pid < 0)
     {
-        log_error("app_create_worker::spawn_worker: %s\n", strerror(*err));
+        log_error("app_create_worker::spawn_worker: %s\n", strerror(err ? *err : 0));
+        return NULL;
     }
 
     // Add new worker to workers list
@@ -110,34 +220,29 @@ worker_t *app_create_worker(app_state_t *state, int *err)
         }
     }
 
-    if(pid != 0)
+    if(pid != 0 && worker_ptr != NULL)
     {
-        // Add worker domain socket to pollfd list
+        // Add worker domain socket to the poller, the worker slot is handed back with every event
         seterr(0);
-        if(app_poll(state, worker.fd, err) == NULL)
+        if(app_poll(state, worker_ptr->fd, worker_ptr, err) < 0)
         {
             // This case occurs when a worker (that has been spawned and is tracked in the worker list) has an fd
-            // that needs to be added the pollfd is unable to, for any reason.
+            // that needs to be added to the poller is unable to, for any reason.
             //
             // The consequence is that the worker will send a request that will never be processed.
             //
             // In this case, we should get the worker to quit so we can reclaim resources by following the same procedure as the `app_add_worker` error
             // but additionally, clear the entry in the worker list.
 
-            log_error("app_create_worker::app_poll: Failed to add worker socket to pollfds list [FD:%d].\n", worker.fd);
+            log_error("app_create_worker::app_poll: Failed to add worker socket to poller [FD:%d].\n", worker.fd);
 
-            if(signal_worker(&worker, SIGINT, NULL) < 0)    // Attempt to gracefully shutdown
-            {
-                log_warn("app_create_worker::signal_worker: Failed to gracefully stop worker, using SIGKILL instead [PID:%d].\n", worker.pid);
-                signal_worker(&worker, SIGKILL, NULL);    // Force-kill with SIGKILL
-            }
-
-            if(reset_worker(&worker, NULL) < 0)
+            if(app_remove_worker(state, worker.pid, NULL) < 0)
             {
                 // Something is seriously wrong at this point...
-                log_error("app_create_worker::reset_worker: Failed to reset worker.\n");
-                return NULL;
+                log_error("app_create_worker::app_remove_worker: Failed to remove worker.\n");
             }
+
+            return NULL;
         }
     }
 
@@ -145,7 +250,9 @@ worker_t *app_create_worker(app_state_t *state, int *err)
 }
 
 /*
- * Add a new worker to the end of the workers list.
+ * Add a new worker to the first free slot of the workers list.
+ *
+ * Slots never move once a worker is added, so a pointer to a worker stays valid until the worker is removed.
  */
 worker_t *app_add_worker(app_state_t *state, const worker_t *worker, int *err)
 {
@@ -156,14 +263,37 @@ worker_t *app_add_worker(app_state_t *state, const worker_t *worker, int *err)
         return NULL;
     }
 
-    memcpy(&state->workers[state->nworkers], worker, sizeof(worker_t));
-    state->nworkers++;
+    for(size_t idx = 0; idx < state->max_clients; idx++)
+    {
+        worker_t *slot = &state->workers[idx];
+
+        if(slot->pid != 0)
+        {
+            continue;
+        }
+
+        memcpy(slot, worker, sizeof(worker_t));
+        state->nworkers++;
+
+        if(idx >= state->nworker_slots)
+        {
+            state->nworker_slots = idx + 1;
+        }
+
+        return slot;
+    }
 
-    return &state->workers[state->nworkers - 1];
+    seterr(ENOSPC);
+    return NULL;
 }
 
+/*
+ * Find the worker with the fewest connections that can still take another one.
+ */
 worker_t *app_find_available_worker(const app_state_t *state, int *err)
 {
+    worker_t *available = NULL;
+
     seterr(0);
     if(state == NULL)
     {
@@ -171,26 +301,38 @@ worker_t *app_find_available_worker(const app_state_t *state, int *err)
         return NULL;
     }
 
-    for(size_t idx = 0; idx < state->nworkers; idx++)
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
     {
         worker_t *worker = &state->workers[idx];
 
-        if(worker->pid > 0 && worker->fd > -1 && worker->client.fd == -1)
+        if(worker->pid <= 0 || worker->fd < 0 || worker->nconnections >= MAX_WORKER_CONNECTIONS)
         {
-            return worker;
+            continue;
+        }
+
+        if(available == NULL || worker->nconnections < available->nconnections)
+        {
+            available = worker;
         }
     }
 
-    return NULL;
+    return available;
 }
 
-worker_t *app_find_worker_by_fd(const app_state_t *state, int fd)
+worker_t *app_find_idle_worker(const app_state_t *state, int *err)
 {
-    for(size_t idx = 0; idx < state->nworkers; idx++)
+    seterr(0);
+    if(state == NULL)
+    {
+        seterr(EINVAL);
+        return NULL;
+    }
+
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
     {
         worker_t *worker = &state->workers[idx];
 
-        if(worker->fd == fd)
+        if(worker->pid > 0 && worker->fd > -1 && worker->nconnections == 0)
         {
             return worker;
         }
@@ -199,13 +341,13 @@ worker_t *app_find_worker_by_fd(const app_state_t *state, int fd)
     return NULL;
 }
 
-worker_t *app_find_worker_by_client_fd(const app_state_t *state, int fd)
+worker_t *app_find_worker_by_fd(const app_state_t *state, int fd)
 {
-    for(size_t idx = 0; idx < state->nworkers; idx++)
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
     {
         worker_t *worker = &state->workers[idx];
 
-        if(worker->client.fd == fd)
+        if(worker->fd == fd)
         {
             return worker;
         }
@@ -215,12 +357,10 @@ worker_t *app_find_worker_by_client_fd(const app_state_t *state, int fd)
 }
 
 /*
- * Remove a new worker and shift the workers to fill the gap.
+ * Remove a worker and free its slot.
  */
 int app_remove_worker(app_state_t *state, pid_t pid, int *err)
 {
-    bool should_shift_workers = false;
-
     seterr(0);
     if(state == NULL || pid <= 0)
     {
@@ -228,54 +368,55 @@ int app_remove_worker(app_state_t *state, pid_t pid, int *err)
         return -1;
     }
 
-    for(size_t idx = 0; idx < state->nworkers; idx++)
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
     {
-        worker_t *worker          = &state->workers[idx];
-        bool      is_last_element = idx == state->max_clients;
+        worker_t *worker = &state->workers[idx];
 
-        if(worker->pid == pid)
+        if(worker->pid != pid)
         {
-            // Remove worker domain socket from poll list
-            seterr(0);
-            if(app_unpoll(state, worker->fd, err) < 0)
-            {
-                if(err && *err == EINVAL)
-                {
-                    // The worker does not have a valid domain socket, likely means data corruption has occurred and this worker obj
-                    // can not be trusted
-                    log_error("app_remove_worker::app_unpoll: Worker has an invalid domain socket FD, skipping [PID:%d,FD:%d].\n", worker->pid, worker->fd);
-                    continue;    // We use continue here so that this worker obj doesn't get overwriten and allow us to clean it up later.
-                                 // Overwriting the record would be disasterous because assuming there were a worker, we would lose track
-                                 // of it and it would remain forever until the next system reboot or manual clean up were done.
-                }
-
-                log_error("app_remove_worker::app_unpoll: Failed to remove worker domain socket from pollfds list [PID:%d,FD:%d].\n", worker->pid, worker->fd);
-            }
+            continue;
+        }
 
-            // Kill the worker
-            seterr(0);
-            if(signal_worker(worker, SIGINT, err) < 0)    // Attempt to gracefully shutdown
+        // Remove worker domain socket from the poller
+        seterr(0);
+        if(app_unpoll(state, worker->fd, err) < 0)
+        {
+            if(err && *err == EINVAL)
             {
-                log_warn("app_remove_worker::signal_worker: Failed to gracefully stop worker, using SIGKILL instead [PID:%d].\n", worker->pid);
-                signal_worker(worker, SIGKILL, NULL);    // Force-kill with SIGKILL
+                // The worker does not have a valid domain socket, likely means data corruption has occurred and this worker obj
+                // can not be trusted
+                log_error("app_remove_worker::app_unpoll: Worker has an invalid domain socket FD, skipping [PID:%d,FD:%d].\n", worker->pid, worker->fd);
+                continue;    // We use continue here so that this worker obj doesn't get overwriten and allow us to clean it up later.
+                             // Overwriting the record would be disasterous because assuming there were a worker, we would lose track
+                             // of it and it would remain forever until the next system reboot or manual clean up were done.
             }
 
-            // Set worker back to default values
-            seterr(0);
-            if(reset_worker(worker, err) < 0)
-            {
-                log_error("app_remove_worker::reset_worker: Failed to reset worker.\n");
-            }
+            log_error("app_remove_worker::app_unpoll: Failed to remove worker domain socket from poller [PID:%d,FD:%d].\n", worker->pid, worker->fd);
+        }
 
-            state->nworkers--;
-            should_shift_workers = true;
+        // Kill the worker
+        seterr(0);
+        if(signal_worker(worker, SIGINT, err) < 0)    // Attempt to gracefully shutdown
+        {
+            log_warn("app_remove_worker::signal_worker: Failed to gracefully stop worker, using SIGKILL instead [PID:%d].\n", worker->pid);
+            signal_worker(worker, SIGKILL, NULL);    // Force-kill with SIGKILL
         }
 
-        // Shift the remaining workers one index down
-        if(!is_last_element && should_shift_workers)
+        close(worker->fd);
+
+        // Set worker back to default values
+        seterr(0);
+        if(reset_worker(worker, err) < 0)
         {
-            memmove(&state->workers[idx], &state->workers[idx + 1], sizeof(worker_t));    // Copy bytes from the next index over
-            reset_worker(&state->workers[idx + 1], NULL);                                 // Reset the worker -- This way, the last element wont have duplicate data
+            log_error("app_remove_worker::reset_worker: Failed to reset worker.\n");
+        }
+
+        state->nworkers--;
+
+        // Shrink the slot range if the last slot was freed
+        while(state->nworker_slots > 0 && state->workers[state->nworker_slots - 1].pid == 0)
+        {
+            state->nworker_slots--;
         }
     }
 
@@ -304,7 +445,7 @@ int app_health_check_workers(app_state_t *state, int *err)
         return -1;
     }
 
-    for(size_t idx = 0; idx < state->nworkers; idx++)
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
     {
         const worker_t *worker = &state->workers[idx];
         int             status = 0;
@@ -323,7 +464,7 @@ int app_health_check_workers(app_state_t *state, int *err)
     return 0;
 }
 
-int app_scale_workers(app_state_t *state, const char *public_dir, int *err)
+int app_scale_workers(app_state_t *state, const worker_config_t *config, int *err)
 {
     if(state->nworkers == state->desired_workers)
     {
@@ -348,7 +489,8 @@ int app_scale_workers(app_state_t *state, const char *public_dir, int *err)
 
             if(worker->pid == 0)    // Worker
             {
-                worker_entrypoint(state->db, public_dir);
+                close_inherited_fds(state);
+                worker_entrypoint(&state->db_cache, &state->snapshot, &state->cache, config);
             }
         }
     }
@@ -362,7 +504,7 @@ int app_scale_workers(app_state_t *state, const char *public_dir, int *err)
         {
             const worker_t *worker;
 
-            worker = app_find_available_worker(state, err);
+            worker = app_find_idle_worker(state, err);
             if(worker)
             {
                 app_remove_worker(state, worker->pid, NULL);
@@ -373,78 +515,315 @@ int app_scale_workers(app_state_t *state, const char *public_dir, int *err)
     return 0;
 }
 
-struct pollfd *app_poll(app_state_t *state, int fd, int *err)
+int app_poll(app_state_t *state, int fd, void *data, int *err)
 {
-    struct pollfd *pollfd;
+    seterr(0);
+    if(state == NULL || fd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
 
+    return poller_add(&state->poller, fd, POLLIN | POLLHUP | POLLERR, data, err);
+}
+
+int app_unpoll(app_state_t *state, int fd, int *err)
+{
     seterr(0);
     if(state == NULL || fd < 0)
     {
         seterr(EINVAL);
-        return NULL;
+        return -1;
+    }
+
+    return poller_remove(&state->poller, fd, err);
+}
+
+int app_wait(app_state_t *state, poller_event_t *events, size_t max_events, int timeout, int *err)
+{
+    seterr(0);
+    if(state == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
     }
 
-    pollfd         = &state->pollfds[state->npollfds];
-    pollfd->fd     = fd;
-    pollfd->events = POLLIN | POLLHUP | POLLERR;
+    return poller_wait(&state->poller, events, max_events, timeout, err);
+}
+
+/*
+ * Add the server socket to the poller. Events on the server socket carry NULL user data.
+ */
+int app_listen(app_state_t *state, int sockfd, int *err)
+{
+    seterr(0);
+    if(state == NULL || sockfd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
 
-    state->npollfds++;
+    if(app_poll(state, sockfd, NULL, err) < 0)
+    {
+        return -2;
+    }
 
-    return pollfd;
+    state->sockfd = sockfd;
+    return 0;
 }
 
-int app_unpoll(app_state_t *state, int fd, int *err)
+/*
+ * Stop polling the server socket while every worker is busy, otherwise the poller would keep waking up on the pending connection.
+ */
+int app_pause_accepting(app_state_t *state, int *err)
 {
-    bool should_shift_pollfds = false;
+    seterr(0);
+    if(state == NULL || state->sockfd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    return poller_modify(&state->poller, state->sockfd, 0, NULL, err);
+}
 
+int app_resume_accepting(app_state_t *state, int *err)
+{
     seterr(0);
-    if(state == NULL || fd < 0)
+    if(state == NULL || state->sockfd < 0)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    return poller_modify(&state->poller, state->sockfd, POLLIN, NULL, err);
+}
+
+/*
+ * Set up the static file cache and build its first snapshot. Workers forked afterwards inherit the snapshot.
+ */
+int app_init_cache(app_state_t *state, const char *public_dir, size_t max_size, int *err)
+{
+    seterr(0);
+    if(state == NULL || public_dir == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(cache_init(&state->cache, public_dir, max_size, err) < 0)
+    {
+        return -2;
+    }
+
+    return app_refresh_cache(state, true, err) < 0 ? -3 : 0;
+}
+
+/*
+ * Rebuild the static file cache once every CACHE_REFRESH_INTERVAL and hand a changed snapshot to every worker.
+ */
+int app_refresh_cache(app_state_t *state, bool force, int *err)
+{
+    uint64_t now_ms = monotonic_ms();
+    bool     changed;
+
+    seterr(0);
+    if(state == NULL || state->cache.stats == NULL)
     {
         seterr(EINVAL);
         return -1;
     }
 
-    for(size_t idx = 0; idx < state->npollfds; idx++)
+    if(!force && now_ms - state->cache_refreshed_ms < CACHE_REFRESH_INTERVAL)
+    {
+        return 0;
+    }
+    state->cache_refreshed_ms = now_ms;
+
+    if(cache_refresh(&state->cache, &changed, err) < 0)
+    {
+        log_error("app_refresh_cache::cache_refresh: %s\n", strerror(err ? *err : 0));
+        return -2;
+    }
+
+    if(!changed)
     {
-        bool is_last_element = idx == state->max_clients;
+        return 0;
+    }
 
-        // Reset the pollfd obj
-        if(state->pollfds[idx].fd == fd && !should_shift_pollfds)
+    log_debug("Built a new static file cache snapshot (%zu bytes).\n", state->cache.size);
+
+    // A worker that misses the snapshot keeps serving from its previous one, or from disk
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
+    {
+        const worker_t *worker = &state->workers[idx];
+        int             serr   = 0;
+
+        if(worker->pid > 0 && worker->fd > -1 && send_fd(worker->fd, state->cache.fd, WORKER_MESSAGE_CACHE, &serr) < 0)
         {
-            if(reset_pollfd(&state->pollfds[idx], NULL) < 0)
-            {
-                log_error("app_unpoll::reset_pollfd: Failed to set pollfd to default values [IDX:%d]\n", idx);
-                continue;
-            }
-            state->npollfds--;
-            should_shift_pollfds = true;
+            log_warn("app_refresh_cache::send_fd: Failed to send cache snapshot to worker [PID:%d] (%s).\n", worker->pid, strerror(serr));
         }
+    }
 
-        // Shift the remaining pollfds one index down
-        if(!is_last_element && should_shift_pollfds)
-        {
-            memmove(&state->pollfds[idx], &state->pollfds[idx + 1], sizeof(struct pollfd));    // Copy bytes from the next index over
+    return 0;
+}
+
+/*
+ * Watch the HTTP library for changes. The directory is watched rather than the file, so that a library that is
+ * replaced by a rename is still picked up. The path is kept for `app_reload_library` even if it can't be watched.
+ */
+int app_watch_library(app_state_t *state, const char *filepath, int *err)
+{
+#ifdef __linux__
+    char       *dir;
+    const char *slash;
+    int         fd;
+#endif
+
+    seterr(0);
+    if(state == NULL || filepath == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+    state->libhttp_path = filepath;
+
+#ifdef __linux__
+    slash = strrchr(filepath, '/');
+    dir   = slash ? strndup(filepath, (size_t)(slash - filepath) + 1) : strdup(".");
+    if(dir == NULL)
+    {
+        seterr(errno);
+        return -2;
+    }
 
-            // Reset the pollfd -- This way, the last element wont have duplicate data
-            reset_pollfd(&state->pollfds[idx + 1], NULL);
+    errno = 0;
+    fd    = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        seterr(errno);
+        free(dir);
+        if(fd > -1)
+        {
+            close(fd);
         }
+        return -3;
+    }
+    free(dir);
+
+    if(app_poll(state, fd, &state->libwatch_fd, err) < 0)
+    {
+        close(fd);
+        return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
     }
 
+    state->libwatch_fd = fd;
     return 0;
+#else
+    seterr(ENOSYS);    // Only SIGHUP can trigger a reload
+    return -2;
+#endif
+}
+
+/*
+ * Drain the library watch. Returns true if the library itself was written or moved into place, any other file in its
+ * directory is ignored.
+ */
+bool app_library_changed(app_state_t *state)
+{
+#ifdef __linux__
+    char        buf[sizeof(struct inotify_event) + NAME_MAX + 1];
+    const char *slash;
+    const char *name;
+    bool        changed = false;
+    ssize_t     nread;
+
+    if(state == NULL || state->libwatch_fd < 0)
+    {
+        return false;
+    }
+
+    slash = strrchr(state->libhttp_path, '/');
+    name  = slash ? slash + 1 : state->libhttp_path;
+
+    while((nread = read(state->libwatch_fd, buf, sizeof(buf))) > 0)
+    {
+        for(ssize_t offset = 0; offset < nread;)
+        {
+            struct inotify_event event;
+
+            // Events are packed back to back, the fixed part is copied out rather than read in place
+            memcpy(&event, buf + offset, sizeof(struct inotify_event));
+            if(event.len > 0 && strcmp(buf + offset + sizeof(struct inotify_event), name) == 0)
+            {
+                changed = true;
+            }
+            offset += (ssize_t)(sizeof(struct inotify_event) + event.len);
+        }
+    }
+
+    return changed;
+#else
+    unused(state);
+    return false;
+#endif
 }
 
-static int reset_pollfd(struct pollfd *pollfd, int *err)
+/*
+ * Reload the server's copy of the HTTP library and ask every worker to do the same. The previous library stays
+ * loaded wherever the new one can't be loaded.
+ */
+int app_reload_library(app_state_t *state, int *err)
 {
     seterr(0);
-    if(pollfd == NULL)
+    if(state == NULL || state->libhttp_path == NULL)
     {
         seterr(EINVAL);
         return -1;
     }
 
-    pollfd->fd      = -1;
-    pollfd->events  = 0;
-    pollfd->revents = 0;
+    if(reload_library(state->libhttp_path) < 0)
+    {
+        seterr(ENOEXEC);
+        return -2;
+    }
+
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
+    {
+        const worker_t *worker = &state->workers[idx];
+
+        if(worker->pid > 0)
+        {
+            signal_worker(worker, SIGHUP, NULL);
+        }
+    }
 
     return 0;
 }
+
+/*
+ * A freshly forked worker holds copies of the server socket, the poller and the domain sockets of every other worker.
+ * These are closed so that the worker does not keep its siblings' connections alive.
+ */
+static void close_inherited_fds(app_state_t *state)
+{
+    for(size_t idx = 0; idx < state->nworker_slots; idx++)
+    {
+        if(state->workers[idx].pid > 0 && state->workers[idx].fd > -1)
+        {
+            close(state->workers[idx].fd);
+        }
+    }
+
+    if(state->sockfd > -1)
+    {
+        close(state->sockfd);
+    }
+
+    if(state->libwatch_fd > -1)
+    {
+        close(state->libwatch_fd);
+    }
+
+    poller_destroy(&state->poller, NULL);
+}
@@ -0,0 +1,1018 @@
+#include "store.h"
+#include "connection.h"
+#include "logger.h"
+#include "networking.h"
+#include "poller.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define STORE_MAX_EVENTS 64
+#define STORE_BUFFER_SIZE 65536    // Smallest batch and reply buffer, and the most a worker reads in one go
+
+// An insert waiting for its batch to be committed. Its key and value are kept in the batch's buffer.
+typedef struct
+{
+    connection_t *conn;    // NULL once the worker has gone away, the record is still committed
+    uint64_t      token;
+    size_t        key_offset;    // NUL terminated
+    size_t        value_offset;
+    size_t        value_len;
+} store_record_t;
+
+typedef struct
+{
+    int                   listenfd;    // Polled with a pointer to itself
+    db_t                  db;
+    db_cache_t           *db_cache;
+    db_snapshot_t        *snapshot;
+    const store_config_t *config;
+    poller_t              poller;
+    connection_pool_t     connections;    // One per worker
+
+    // Batch of inserts that haven't been committed yet
+    store_record_t *records;
+    size_t          nrecords;
+    uint8_t        *data;
+    size_t          data_len;
+    size_t          data_size;
+    uint64_t        opened_ms;    // Monotonic time the first insert of the batch arrived
+
+    bool     snapshot_dirty;    // Records have been committed since the last snapshot
+    uint64_t snapshot_ms;       // Monotonic time of the last snapshot
+} store_state_t;
+
+static bool volatile is_running = true;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+static void signal_handler_fn(int signal);
+static void accept_clients(store_state_t *state);
+static void handle_client_event(store_state_t *state, connection_t *conn, short revents);
+static int  handle_message(store_state_t *state, connection_t *conn);
+static void answer_fetch(store_state_t *state, connection_t *conn, const store_message_t *message, char *key);
+static void answer_status(connection_t *conn, const store_message_t *message, int status);
+static int  batch_add(store_state_t *state, connection_t *conn, const store_message_t *message, const char *key, const uint8_t *value);
+static void commit_batch(store_state_t *state);
+static int  snapshot_timeout(const store_state_t *state);
+static void publish_snapshot(store_state_t *state);
+static int  flush_client(store_state_t *state, connection_t *conn, int *err);
+static void close_client(store_state_t *state, connection_t *conn);
+static int  send_all(int fd, struct iovec *iov, size_t iovcnt, int *err);
+static int  read_reply(store_client_t *client, bool wait, int *err);
+static int  next_reply(store_client_t *client, store_message_t *reply, const uint8_t **value);
+static int  push_ack(store_client_t *client, const store_message_t *reply);
+
+/*
+ * Long-lived store loop.
+ *
+ * The server creates the listening socket before forking, so workers can connect as soon as they start. The store
+ * opens the database itself, no other process ever holds a handle to it.
+ */
+_Noreturn void store_entrypoint(int listenfd, db_cache_t *db_cache, db_snapshot_t *snapshot, const store_config_t *config)
+{
+    int           retval = EXIT_FAILURE;
+    int           err;
+    store_state_t state;
+
+    setup_signals(signal_handler_fn);
+    signal(SIGHUP, SIG_IGN);     // Library reloads are no concern of the store
+    signal(SIGPIPE, SIG_IGN);    // A worker exiting mid-reply should fail the write, not the store
+
+    memset(&state, 0, sizeof(store_state_t));
+    state.listenfd = listenfd;
+    state.db_cache = db_cache;
+    state.snapshot = snapshot;
+    state.config   = config;
+
+    // Workers get their first snapshot as soon as the store is up
+    state.snapshot_dirty = true;
+
+    err = 0;
+    if(db_init(&state.db, config->db_engine, config->db_path, &err) < 0)
+    {
+        log_error("store::db_init: %s\n", strerror(err));
+        goto exit;
+    }
+
+    errno         = 0;
+    state.records = (store_record_t *)calloc(STORE_BATCH_MAX_RECORDS, sizeof(store_record_t));
+    if(state.records == NULL)
+    {
+        log_error("store::calloc: %s\n", strerror(errno));
+        goto destroy_db;
+    }
+
+    err = 0;
+    if(connection_pool_init(&state.connections, config->max_clients, &err) < 0)
+    {
+        log_error("store::connection_pool_init: %s\n", strerror(err));
+        goto free_batch;
+    }
+
+    // Workers are accepted until the backlog is drained
+    errno = 0;
+    if(fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        log_error("store::fcntl: %s\n", strerror(errno));
+        goto destroy_pool;
+    }
+
+    // +1 for the listening socket, always level-triggered so that reads can stop at their budget
+    err = 0;
+    if(poller_init(&state.poller, config->max_clients + 1, false, &err) < 0 || poller_add(&state.poller, listenfd, POLLIN, &state.listenfd, &err) < 0)
+    {
+        log_error("store::poller_init: %s\n", strerror(err));
+        goto destroy_pool;
+    }
+
+    retval = EXIT_SUCCESS;
+    while(is_running)
+    {
+        poller_event_t events[STORE_MAX_EVENTS];
+        int            nevents;
+        int            timeout = -1;
+
+        // Wake up when the open batch is due
+        if(state.nrecords > 0)
+        {
+            uint64_t age_ms = monotonic_ms() - state.opened_ms;
+
+            timeout = age_ms >= config->flush_interval_ms ? 0 : (int)(config->flush_interval_ms - age_ms);
+        }
+
+        // Or when the next snapshot is
+        if(state.snapshot_dirty)
+        {
+            int due = snapshot_timeout(&state);
+
+            timeout = timeout < 0 || due < timeout ? due : timeout;
+        }
+
+        err     = 0;
+        nevents = poller_wait(&state.poller, events, STORE_MAX_EVENTS, timeout, &err);
+        if(nevents < 0)
+        {
+            if(err != EINTR)
+            {
+                log_error("store::poller_wait: %s\n", strerror(err));
+            }
+            continue;
+        }
+
+        for(int idx = 0; idx < nevents; idx++)
+        {
+            connection_t *conn = (connection_t *)events[idx].data;
+
+            if(events[idx].data == &state.listenfd)
+            {
+                accept_clients(&state);
+                continue;
+            }
+
+            if(conn->state == CONNECTION_STATE_FREE)
+            {
+                continue;    // The worker has gone away while handling an earlier event
+            }
+
+            handle_client_event(&state, conn, events[idx].revents);
+        }
+
+        // Everything that arrived together is committed together
+        if(state.nrecords > 0 && monotonic_ms() - state.opened_ms >= config->flush_interval_ms)
+        {
+            commit_batch(&state);
+        }
+
+        if(state.snapshot_dirty && snapshot_timeout(&state) == 0)
+        {
+            publish_snapshot(&state);
+        }
+    }
+
+    // Nothing that has been received is lost on shutdown
+    if(state.nrecords > 0)
+    {
+        commit_batch(&state);
+    }
+
+    poller_destroy(&state.poller, NULL);
+
+destroy_pool:
+    connection_pool_destroy(&state.connections, NULL);
+
+free_batch:
+    free(state.records);
+    free(state.data);
+
+destroy_db:
+    db_destroy(&state.db);
+
+exit:
+    close(listenfd);
+    unlink(config->socket_path);
+    unlink(snapshot->path);
+    exit(retval);
+}
+
+/*
+ * Connects a worker to the store. The socket is non-blocking, calls that need an answer wait for it with poll(2), for
+ * at most STORE_TIMEOUT_MS at a time.
+ */
+int store_connect(store_client_t *client, const char *socket_path, int *err)
+{
+    seterr(0);
+    if(client == NULL || socket_path == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    memset(client, 0, sizeof(store_client_t));
+
+    client->fd = dmn_client(socket_path, err);
+    if(client->fd < 0)
+    {
+        return -2;
+    }
+
+    errno = 0;
+    if(fcntl(client->fd, F_SETFL, fcntl(client->fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        seterr(errno);
+        close(client->fd);
+        client->fd = -1;
+        return -3;
+    }
+
+    return 0;
+}
+
+void store_disconnect(store_client_t *client)
+{
+    if(client->fd > -1)
+    {
+        close(client->fd);
+    }
+
+    free(client->inbuf);
+    free(client->acks);
+    memset(client, 0, sizeof(store_client_t));
+    client->fd = -1;
+}
+
+/*
+ * Sends an insert to the store. It is acknowledged with `token` once its batch has been committed.
+ */
+int store_insert(store_client_t *client, const char *key, const uint8_t *value, size_t len, uint64_t token, int *err)
+{
+    store_message_t message;
+    struct iovec    iov[3];    // Header, key and value
+
+    seterr(0);
+    if(client == NULL || key == NULL || value == NULL)
+    {
+        seterr(EINVAL);
+        return -1;
+    }
+
+    if(client->fd < 0)
+    {
+        seterr(ENOTCONN);
+        return -2;
+    }
+
+    memset(&message, 0, sizeof(store_message_t));
+    message.op        = STORE_OP_INSERT;
+    message.token     = token;
+    message.key_len   = strlen(key);
+    message.value_len = len;
+
+    iov[0].iov_base = &message;
+    iov[0].iov_len  = sizeof(store_message_t);
+    iov[1].iov_base = (void *)(uintptr_t)key;
+    iov[1].iov_len  = message.key_len;
+    iov[2].iov_base = (void *)(uintptr_t)value;
+    iov[2].iov_len  = len;
+
+    if(send_all(client->fd, iov, arrlen(iov), err) < 0)
+    {
+        return -3;
+    }
+
+    return 0;
+}
+
+/*
+ * Looks up a record and waits for the answer. Inserts acknowledged in the meantime are added to `acks`.
+ *
+ * The value points into the client's buffer, it is only valid until the next call on the client. Returns NULL with
+ * ENOENT when there is no record for the key, or with ETIMEDOUT when the store hasn't answered in time. The answer
+ * to a lookup that timed out is skipped once it arrives.
+ */
+uint8_t *store_fetch(store_client_t *client, const char *key, size_t *len, int *err)
+{
+    store_message_t message;
+    struct iovec    iov[2];    // Header and key
+
+    seterr(0);
+    if(client == NULL || key == NULL || len == NULL)
+    {
+        seterr(EINVAL);
+        return NULL;
+    }
+
+    if(client->fd < 0)
+    {
+        seterr(ENOTCONN);
+        return NULL;
+    }
+
+    memset(&message, 0, sizeof(store_message_t));
+    message.op      = STORE_OP_FETCH;
+    message.token   = ++client->nfetches;
+    message.key_len = strlen(key);
+
+    iov[0].iov_base = &message;
+    iov[0].iov_len  = sizeof(store_message_t);
+    iov[1].iov_base = (void *)(uintptr_t)key;
+    iov[1].iov_len  = message.key_len;
+
+    if(send_all(client->fd, iov, arrlen(iov), err) < 0)
+    {
+        return NULL;
+    }
+
+    while(true)
+    {
+        store_message_t reply;
+        const uint8_t  *value;
+        const uint8_t  *found    = NULL;
+        bool            answered = false;
+        int             status   = 0;
+
+        while(next_reply(client, &reply, &value) > 0)
+        {
+            if(reply.op == STORE_OP_INSERT)
+            {
+                if(push_ack(client, &reply) < 0)
+                {
+                    seterr(ENOMEM);
+                    return NULL;
+                }
+                continue;
+            }
+
+            if(reply.token != message.token)
+            {
+                continue;    // Answers an earlier lookup that timed out
+            }
+
+            // Acknowledgements read along with the answer are taken too, the socket won't report them again
+            answered = true;
+            status   = reply.status;
+            found    = value;
+            *len     = (size_t)reply.value_len;
+        }
+
+        if(answered)
+        {
+            seterr(status);
+            return status == 0 ? (uint8_t *)(uintptr_t)found : NULL;
+        }
+
+        if(read_reply(client, true, err) < 0)
+        {
+            return NULL;
+        }
+    }
+}
+
+/*
+ * Reads the replies that have arrived without waiting for more, the tokens of committed inserts are added to `acks`.
+ *
+ * Returns -1 once the store has gone away.
+ */
+int store_receive(store_client_t *client, int *err)
+{
+    store_message_t reply;
+    const uint8_t  *value;
+
+    seterr(0);
+    if(client == NULL || client->fd < 0)
+    {
+        seterr(ENOTCONN);
+        return -1;
+    }
+
+    if(read_reply(client, false, err) < 0)
+    {
+        return -1;
+    }
+
+    while(next_reply(client, &reply, &value) > 0)
+    {
+        // Lookups are answered while the worker waits for them, anything else is an insert
+        if(reply.op == STORE_OP_INSERT && push_ack(client, &reply) < 0)
+        {
+            seterr(ENOMEM);
+            return -2;
+        }
+    }
+
+    return 0;
+}
+
+static void signal_handler_fn(int signal)
+{
+    if(signal == SIGINT)
+    {
+        is_running = false;
+    }
+}
+
+static void accept_clients(store_state_t *state)
+{
+    while(true)
+    {
+        int           err;
+        int           fd;
+        connection_t *conn;
+
+        errno = 0;
+        fd    = accept(state->listenfd, NULL, NULL);
+        if(fd < 0)
+        {
+            if(errno != EINTR && !would_block(errno))
+            {
+                log_error("store::accept: %s\n", strerror(errno));
+            }
+            return;
+        }
+
+        err  = 0;
+        conn = connection_open(&state->connections, fd, &err);
+        if(conn == NULL)
+        {
+            log_error("store::connection_open: %s\n", strerror(err));
+            close(fd);
+            continue;
+        }
+
+        err = 0;
+        if(poller_add(&state->poller, fd, POLLIN | POLLHUP, conn, &err) < 0)
+        {
+            log_error("store::poller_add: %s\n", strerror(err));
+            connection_close(&state->connections, conn, NULL);
+            continue;
+        }
+        conn->events = POLLIN | POLLHUP;
+    }
+}
+
+static void handle_client_event(store_state_t *state, connection_t *conn, short revents)
+{
+    int err;
+
+    if(revents & POLLERR)
+    {
+        close_client(state, conn);
+        return;
+    }
+
+    if(revents & (POLLIN | POLLHUP))
+    {
+        err = 0;
+        if(connection_read(conn, &err) < 0)
+        {
+            log_error("store::connection_read: %s\n", strerror(err));
+            close_client(state, conn);
+            return;
+        }
+
+        while(connection_has_input(conn))
+        {
+            int handled = handle_message(state, conn);
+
+            if(handled < 0)
+            {
+                log_error("store::handle_message: Malformed message from worker [FD:%d].\n", conn->fd);
+                close_client(state, conn);
+                return;
+            }
+
+            if(handled == 0)
+            {
+                break;    // Wait for the rest of the message
+            }
+        }
+    }
+
+    // The worker only closes its end when it exits, nobody is waiting for the replies anymore
+    if(conn->state == CONNECTION_STATE_CLOSING)
+    {
+        close_client(state, conn);
+        return;
+    }
+
+    err = 0;
+    if(flush_client(state, conn, &err) < 0)
+    {
+        log_error("store::flush_client: %s\n", strerror(err));
+        close_client(state, conn);
+    }
+}
+
+/*
+ * Handles the first message of the input buffer once all of it has arrived.
+ *
+ * Returns 1 if a message has been handled, 0 if more input is needed or -1 if the message is malformed.
+ */
+static int handle_message(store_state_t *state, connection_t *conn)
+{
+    store_message_t message;
+    char           *start     = conn->inbuf + conn->inbuf_handled;
+    size_t          available = conn->inbuf_len - conn->inbuf_handled;
+    char           *key;
+    char            next;
+
+    if(available < sizeof(store_message_t))
+    {
+        return 0;
+    }
+
+    memcpy(&message, start, sizeof(store_message_t));
+    if((message.op != STORE_OP_INSERT && message.op != STORE_OP_FETCH) || message.key_len == 0 || message.key_len > SIZE_MAX - sizeof(store_message_t) || message.value_len > SIZE_MAX - sizeof(store_message_t) - message.key_len)
+    {
+        return -1;
+    }
+
+    if(available - sizeof(store_message_t) < message.key_len + message.value_len)
+    {
+        return 0;
+    }
+
+    key = start + sizeof(store_message_t);
+    if(message.key_len > STORE_MAX_KEY_SIZE)
+    {    // Too long to be a record, the worker gets an answer instead of losing its connection
+        answer_status(conn, &message, ENAMETOOLONG);
+    }
+    else if(message.op == STORE_OP_FETCH)
+    {
+        // Terminate the key in place for the database, the next message starts right after it
+        next                 = key[message.key_len];
+        key[message.key_len] = '\0';
+        answer_fetch(state, conn, &message, key);
+        key[message.key_len] = next;
+    }
+    else if(batch_add(state, conn, &message, key, (const uint8_t *)key + message.key_len) < 0)
+    {
+        log_error("store::batch_add: Failed to queue record [FD:%d].\n", conn->fd);
+    }
+
+    connection_skip_input(conn, sizeof(store_message_t) + message.key_len + message.value_len);
+
+    // A full batch is committed straight away
+    if(state->nrecords == STORE_BATCH_MAX_RECORDS || state->data_len >= STORE_BATCH_MAX_SIZE)
+    {
+        commit_batch(state);
+    }
+
+    return 1;
+}
+
+/*
+ * Answers a lookup. The value is copied from the database straight into the reply.
+ */
+static void answer_fetch(store_state_t *state, connection_t *conn, const store_message_t *message, char *key)
+{
+    store_message_t reply;
+    struct iovec    iov[2];    // Header and value
+    const uint8_t  *value;
+    size_t          value_len = 0;
+    int             err;
+
+    err   = 0;
+    value = db_fetch(&state->db, key, &value_len, &err);
+
+    memset(&reply, 0, sizeof(store_message_t));
+    reply.op        = STORE_OP_FETCH;
+    reply.status    = value ? 0 : err;
+    reply.token     = message->token;
+    reply.value_len = value ? value_len : 0;
+
+    iov[0].iov_base = &reply;
+    iov[0].iov_len  = sizeof(store_message_t);
+    iov[1].iov_base = (void *)(uintptr_t)value;
+    iov[1].iov_len  = (size_t)reply.value_len;
+
+    if(connection_writev(conn, iov, arrlen(iov), &err) < 0)
+    {
+        log_error("store::connection_writev: %s\n", strerror(err));
+    }
+}
+
+/*
+ * Answers a message that won't be handled with `status` alone, inserts included.
+ */
+static void answer_status(connection_t *conn, const store_message_t *message, int status)
+{
+    store_message_t reply;
+    int             err;
+
+    memset(&reply, 0, sizeof(store_message_t));
+    reply.op     = message->op;
+    reply.status = status;
+    reply.token  = message->token;
+
+    err = 0;
+    if(connection_write(conn, &reply, sizeof(store_message_t), &err) < 0)
+    {
+        log_error("store::connection_write: %s\n", strerror(err));
+    }
+}
+
+/*
+ * Copies an insert into the open batch, opening one if there is none.
+ */
+static int batch_add(store_state_t *state, connection_t *conn, const store_message_t *message, const char *key, const uint8_t *value)
+{
+    store_record_t *record;
+    size_t          size = (size_t)message->key_len + 1 + (size_t)message->value_len;
+
+    if(state->data_size - state->data_len < size)
+    {
+        uint8_t *data;
+        size_t   data_size = state->data_size == 0 ? STORE_BUFFER_SIZE : state->data_size;
+
+        while(data_size - state->data_len < size)
+        {
+            data_size *= 2;
+        }
+
+        data = (uint8_t *)realloc(state->data, data_size);
+        if(data == NULL)
+        {
+            return -1;
+        }
+
+        state->data      = data;
+        state->data_size = data_size;
+    }
+
+    if(state->nrecords == 0)
+    {
+        state->opened_ms = monotonic_ms();
+    }
+
+    record               = &state->records[state->nrecords++];
+    record->conn         = conn;
+    record->token        = message->token;
+    record->key_offset   = state->data_len;
+    record->value_offset = state->data_len + (size_t)message->key_len + 1;
+    record->value_len    = (size_t)message->value_len;
+
+    memcpy(state->data + record->key_offset, key, (size_t)message->key_len);
+    state->data[record->value_offset - 1] = '\0';
+    memcpy(state->data + record->value_offset, value, record->value_len);
+    state->data_len += size;
+
+    return 0;
+}
+
+/*
+ * Stores every record of the batch, flushes the engine, syncing it if asked to, and acknowledges every insert. Workers
+ * drop their cached records before any of them can read the new values back.
+ */
+static void commit_batch(store_state_t *state)
+{
+    int status = 0;
+    int err;
+
+    for(size_t idx = 0; idx < state->nrecords; idx++)
+    {
+        const store_record_t *record = &state->records[idx];
+
+        err = 0;
+        if(db_insert(&state->db, (const char *)state->data + record->key_offset, state->data + record->value_offset, record->value_len, &err) < 0)
+        {
+            log_error("store::db_insert: Failed to insert record at route (%s)\n", (const char *)state->data + record->key_offset);
+            status = err ? err : EIO;
+        }
+    }
+
+    // Buffered records are written out before they are acknowledged, the engine only syncs them if asked to
+    err = 0;
+    if(db_flush(&state->db, state->config->durability == STORE_DURABILITY_SYNC, &err) < 0)
+    {
+        log_error("store::db_flush: %s\n", strerror(err));
+        status = err;
+    }
+
+    db_cache_invalidate(state->db_cache);
+    state->snapshot_dirty = true;
+
+    log_debug("Committed %zu records (%zu bytes).\n", state->nrecords, state->data_len);
+
+    for(size_t idx = 0; idx < state->nrecords; idx++)
+    {
+        const store_record_t *record = &state->records[idx];
+        store_message_t       reply;
+
+        if(record->conn == NULL)
+        {
+            continue;
+        }
+
+        memset(&reply, 0, sizeof(store_message_t));
+        reply.op     = STORE_OP_INSERT;
+        reply.status = status;
+        reply.token  = record->token;
+
+        err = 0;
+        if(connection_write(record->conn, &reply, sizeof(store_message_t), &err) < 0)
+        {
+            log_error("store::connection_write: %s\n", strerror(err));
+        }
+    }
+
+    // Every worker of the batch gets its acknowledgements with a single write. A worker that can't be written to is
+    // closed once its socket reports the error, the batch may be committed while one of its messages is handled.
+    for(size_t idx = 0; idx < state->nrecords; idx++)
+    {
+        err = 0;
+        if(state->records[idx].conn && flush_client(state, state->records[idx].conn, &err) < 0)
+        {
+            log_error("store::flush_client: %s\n", strerror(err));
+        }
+    }
+
+    state->nrecords = 0;
+    state->data_len = 0;
+}
+
+// Milliseconds until the next snapshot may be published
+static int snapshot_timeout(const store_state_t *state)
+{
+    uint64_t age_ms;
+
+    if(state->snapshot_ms == 0)
+    {
+        return 0;
+    }
+
+    age_ms = monotonic_ms() - state->snapshot_ms;
+    return age_ms >= state->config->snapshot_interval_ms ? 0 : (int)(state->config->snapshot_interval_ms - age_ms);
+}
+
+/*
+ * Rewrites the snapshot with everything committed so far. It is taken at the current commit generation, so workers
+ * only trust it until the next commit. A failed snapshot is retried after another interval, workers ask the store in
+ * the meantime.
+ */
+static void publish_snapshot(store_state_t *state)
+{
+    int err = 0;
+
+    state->snapshot_ms = monotonic_ms();
+    if(db_snapshot_publish(state->snapshot, &state->db, db_cache_generation(state->db_cache), &err) < 0)
+    {
+        log_error("store::db_snapshot_publish: %s\n", strerror(err));
+        return;
+    }
+
+    state->snapshot_dirty = false;
+}
+
+/*
+ * Writes what the socket takes and keeps polling for writability until the rest is out.
+ */
+static int flush_client(store_state_t *state, connection_t *conn, int *err)
+{
+    ssize_t remaining;
+    short   events;
+
+    remaining = connection_flush(conn, err);
+    if(remaining < 0)
+    {
+        return -1;
+    }
+
+    events = remaining > 0 ? POLLIN | POLLHUP | POLLOUT : POLLIN | POLLHUP;
+    if(events != conn->events && poller_modify(&state->poller, conn->fd, events, conn, err) < 0)
+    {
+        return -2;
+    }
+    conn->events = events;
+
+    return 0;
+}
+
+static void close_client(store_state_t *state, connection_t *conn)
+{
+    // The worker's inserts are still committed, there is just nobody left to acknowledge them to
+    for(size_t idx = 0; idx < state->nrecords; idx++)
+    {
+        if(state->records[idx].conn == conn)
+        {
+            state->records[idx].conn = NULL;
+        }
+    }
+
+    poller_remove(&state->poller, conn->fd, NULL);
+    connection_close(&state->connections, conn, NULL);
+}
+
+/*
+ * Writes a whole message. A store that takes nothing for STORE_TIMEOUT_MS fails it with ETIMEDOUT. Should part of the
+ * message have gone out by then, the socket is shut down, as the store would read whatever comes next as its rest. The
+ * worker then sees it hang up and connects again.
+ */
+static int send_all(int fd, struct iovec *iov, size_t iovcnt, int *err)
+{
+    bool partial = false;
+
+    while(iovcnt > 0)
+    {
+        ssize_t nwritten;
+
+        errno    = 0;
+        nwritten = writev(fd, iov, (int)iovcnt);
+        if(nwritten < 0)
+        {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            if(!would_block(errno))
+            {
+                seterr(errno);
+                return -1;
+            }
+
+            // The store always reads, so this only waits for it to catch up
+            if(poll(&pfd, 1, STORE_TIMEOUT_MS) == 0)
+            {
+                if(partial)
+                {
+                    shutdown(fd, SHUT_RDWR);
+                }
+
+                seterr(ETIMEDOUT);
+                return -2;
+            }
+            continue;
+        }
+
+        partial = true;
+
+        while(iovcnt > 0 && (size_t)nwritten >= iov->iov_len)
+        {
+            nwritten -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t *)iov->iov_base + nwritten;
+            iov->iov_len -= (size_t)nwritten;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Reads everything the store has sent into the client's buffer, dropping the replies that have been handled first.
+ * When `wait` is set, it waits for up to STORE_TIMEOUT_MS for something to arrive.
+ *
+ * The socket is always drained, an edge-triggered worker would not hear about the rest again.
+ */
+static int read_reply(store_client_t *client, bool wait, int *err)
+{
+    bool received = false;
+
+    if(client->inbuf_handled > 0)
+    {
+        memmove(client->inbuf, client->inbuf + client->inbuf_handled, client->inbuf_len - client->inbuf_handled);
+        client->inbuf_len -= client->inbuf_handled;
+        client->inbuf_handled = 0;
+    }
+
+    while(true)
+    {
+        ssize_t nread;
+
+        if(client->inbuf_size - client->inbuf_len < STORE_BUFFER_SIZE)
+        {
+            uint8_t *inbuf;
+            size_t   size = client->inbuf_size == 0 ? STORE_BUFFER_SIZE : client->inbuf_size * 2;
+
+            errno = 0;
+            inbuf = (uint8_t *)realloc(client->inbuf, size);
+            if(inbuf == NULL)
+            {
+                seterr(errno);
+                return -1;
+            }
+
+            client->inbuf      = inbuf;
+            client->inbuf_size = size;
+        }
+
+        errno = 0;
+        nread = read(client->fd, client->inbuf + client->inbuf_len, STORE_BUFFER_SIZE);
+        if(nread < 0)
+        {
+            struct pollfd pfd = {client->fd, POLLIN, 0};
+
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            if(!would_block(errno))
+            {
+                seterr(errno);
+                return -2;
+            }
+
+            if(!wait || received)
+            {
+                return 0;
+            }
+
+            if(poll(&pfd, 1, STORE_TIMEOUT_MS) == 0)
+            {
+                seterr(ETIMEDOUT);
+                return -4;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            }
+            continue;
+        }
+
+        if(nread == 0)
+        {
+            seterr(ECONNRESET);
+            return -3;
+        }
+
+        client->inbuf_len += (size_t)nread;
+        received = true;
+    }
+}
+
+/*
+ * Takes the next complete reply from the client's buffer.
+ */
+static int next_reply(store_client_t *client, store_message_t *reply, const uint8_t **value)
+{
+    size_t available = client->inbuf_len - client->inbuf_handled;
+
+    if(available < sizeof(store_message_t))
+    {
+        return 0;
+    }
+
+    memcpy(reply, client->inbuf + client->inbuf_handled, sizeof(store_message_t));
+    if(available - sizeof(store_message_t) < reply->value_len)
+    {
+        return 0;
+    }
+
+    *value = client->inbuf + client->inbuf_handled + sizeof(store_message_t);
+    client->inbuf_handled += sizeof(store_message_t) + (size_t)reply->value_len;
+
+    return 1;
+}
+
+static int push_ack(store_client_t *client, const store_message_t *reply)
+{
+    if(client->nacks == client->acks_size)
+    {
+        store_ack_t *acks;
+        size_t       size = client->acks_size == 0 ? STORE_MAX_EVENTS : client->acks_size * 2;
+
+        acks = (store_ack_t *)realloc(client->acks, size * sizeof(store_ack_t));
+        if(acks == NULL)
+        {
+            return -1;
+        }
+
+        client->acks      = acks;
+        client->acks_size = size;
+    }
+
+    client->acks[client->nacks].token  = reply->token;
+    client->acks[client->nacks].status = reply->status;
+    client->nacks++;
+    return 0;
+}
@@ -7,17 +7,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 int setup_signals(void (*signal_handler_fn)(int sig))
 {
     struct sigaction sa;
 
-    sa.sa_handler = signal_handler_fn;    // Set handler function for SIGINT
+    sa.sa_handler = signal_handler_fn;    // Set handler function for SIGINT and SIGHUP
     sigemptyset(&sa.sa_mask);             // Don't block any additional signals
     sa.sa_flags = 0;
 
-    // Register signal handler
-    return sigaction(SIGINT, &sa, NULL);
+    // Register signal handler, SIGHUP asks for the HTTP library to be reloaded
+    if(sigaction(SIGINT, &sa, NULL) < 0)
+    {
+        return -1;
+    }
+
+    return sigaction(SIGHUP, &sa, NULL);
 }
 
 bool is_ipv6(const char *address)
@@ -186,3 +192,40 @@ cleanup_copy:
 exit:
     return retval;
 }
+
+/* Milliseconds on a clock that never jumps, for timeouts and intervals. */
+uint64_t monotonic_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * MS_PER_SECOND) + ((uint64_t)now.tv_nsec / NS_PER_MS);
+}
+
+// FNV-1a
+uint32_t hash_bytes(const void *data, size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t       hash  = FNV_OFFSET_BASIS;
+
+    for(size_t idx = 0; idx < len; idx++)
+    {
+        hash = (hash ^ bytes[idx]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/* Whether a non-blocking call failed only because it has to wait. Linux defines EAGAIN and EWOULDBLOCK as the same. */
+bool would_block(int err)
+{
+#if EAGAIN != EWOULDBLOCK
+    if(err == EWOULDBLOCK)
+    {
+        return true;
+    }
+#endif
+
+    return err == EAGAIN;
+}
@@ -1,8 +1,10 @@
 #include "worker.h"
+#include "connection.h"
 #include "handlers.h"
 #include "io.h"
 #include "logger.h"
 #include "networking.h"
+#include "poller.h"
 #include "utils.h"
 #include <errno.h>
 #include <fcntl.h>
@@ -13,12 +15,32 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-static bool volatile is_running = true;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+#define WORKER_MAX_EVENTS 64
+#define WORKER_STORE_RETRY_MS 1000    // Least time between two attempts to connect to the store
+
+typedef struct
+{
+    int                    sockfd;      // Domain socket to the server, polled with NULL user data
+    int                    listenfd;    // Own listener when sharding accepts, polled with a pointer to itself
+    bool                   accepting;
+    cache_t               *cache;    // Snapshot inherited from the server, replaced whenever it sends a new one
+    const worker_config_t *config;
+    poller_t               poller;
+    connection_pool_t      connections;
+    store_client_t         store;             // Connection to the store process, polled with a pointer to itself
+    uint64_t               store_retry_ms;    // Monotonic time before which the store isn't connected to again
+    arena_t                arena;             // Shared by every request, requests are answered one at a time
+    handler_context_t      handler;
+} worker_state_t;
+
+static bool volatile is_running       = true;     // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+static bool volatile reload_requested = false;    // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
 
 /*
  * Spawns a worker and setups up a domain socket to communicate with the worker.
  *
- * When the worker spawns, it will try to connect with the domain socket as soon as possible.
+ * When the worker spawns, it will try to connect with the domain socket as soon as possible. The connection is
+ * accepted here and kept for the lifetime of the worker, every client fd is then handed to the worker through it.
  *
  * A race condition occurs where the domain socket can't be established before the workers tries to connect,
  * causing a connection error.
@@ -26,6 +48,7 @@ static bool volatile is_running = true;    // NOLINT(cppcoreguidelines-avoid-non
 int spawn_worker(worker_t *worker, int *err)
 {
     char *socket_path;
+    int   dmnfd;
 
     int pipefd[2];
 
@@ -76,23 +99,48 @@ int spawn_worker(worker_t *worker, int *err)
 
     // Setup domain server to establish communication with worker
     seterr(0);
-    worker->fd = dmn_server(socket_path, err);
-    if(worker->fd < 0)
+    dmnfd = dmn_server(socket_path, err);
+    if(dmnfd < 0)
     {
+        free(socket_path);
         return -4;
     }
 
-    free(socket_path);    // Not used anymore
-
-    // Notify the worker has spawned
-    log_debug("\n%sServer | Worker:%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
-    log_debug("Worker[PID:%d/FD:%d] spawned.\n", worker->pid, worker->fd);
-
     // Signal the child that it can now stop blocking and continue execution
     close(pipefd[0]);
     write(pipefd[1], "1", 1);
     close(pipefd[1]);
 
+    // Wait for the worker to connect, this connection is kept for the lifetime of the worker
+    errno      = 0;
+    worker->fd = accept(dmnfd, NULL, NULL);
+    if(worker->fd < 0)
+    {
+        seterr(errno);
+    }
+
+    // The socket file is not needed once the worker has connected
+    close(dmnfd);
+    unlink(socket_path);
+    free(socket_path);
+
+    if(worker->fd < 0)
+    {
+        return -5;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+    // Notifications from the worker are drained until EAGAIN
+    errno = 0;
+    if(fcntl(worker->fd, F_SETFL, fcntl(worker->fd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        seterr(errno);
+        return -6;    // NOLINT(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+
+    // Notify the worker has spawned
+    log_debug("\n%sServer | Worker:%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+    log_debug("Worker[PID:%d/FD:%d] spawned.\n", worker->pid, worker->fd);
+
     return worker->pid;
 }
 
@@ -112,18 +160,7 @@ int signal_worker(const worker_t *worker, int signal, int *err)
     {
         int status;
         kill(worker->pid, signal);
-        if(waitpid(worker->pid, &status, WNOHANG) != 0 && WIFEXITED(status))    // Clean up potential zombified process
-        {
-            if(worker->fd > -1)
-            {
-                close(worker->fd);
-            }
-
-            if(worker->client.fd > -1)
-            {
-                close(worker->client.fd);
-            }
-        }
+        waitpid(worker->pid, &status, WNOHANG);    // Clean up potential zombified process
     }
 
     return 0;
@@ -141,24 +178,22 @@ int reset_worker(worker_t *worker, int *err)
         return -1;
     }
 
-    worker->pid            = 0;
-    worker->fd             = -1;
-    worker->client.fd      = -1;
-    worker->client.address = 0;
-    worker->client.port    = 0;
+    worker->pid          = 0;
+    worker->fd           = -1;
+    worker->nconnections = 0;
 
     return 0;
 }
 
 /*
- * Assign the client to the worker
+ * Count the client against the worker's connection limit
  */
 int assign_client_to_worker(worker_t *worker, const client_t *client, int *err)
 {
-    if(worker->client.fd > -1)
+    if(worker->nconnections >= MAX_WORKER_CONNECTIONS)
     {
         *err = EBUSY;
-        return -1;    // Worker already has a client, this action overwrite the existing client, leaving it in limbo
+        return -1;    // The worker would have to turn the connection away
     }
 
     if(!client)
@@ -167,7 +202,7 @@ int assign_client_to_worker(worker_t *worker, const client_t *client, int *err)
         return -2;
     }
 
-    memcpy(&worker->client, client, sizeof(client_t));
+    worker->nconnections++;
 
     return 0;
 }
@@ -178,24 +213,420 @@ static void signal_handler_fn(int signal)
     {
         is_running = false;
     }
+    else if(signal == SIGHUP)
+    {
+        reload_requested = true;
+    }
+}
+
+/*
+ * Let the server know that a connection has been closed, so it can be counted against this worker's load again.
+ */
+static void notify_server(const worker_state_t *state)
+{
+    // Listening workers are not load balanced by the server
+    if(state->config->reuseport)
+    {
+        return;
+    }
+
+    errno = 0;
+    if(write(state->sockfd, "1", 1) < 0)
+    {
+        log_error("worker::write: %s\n", strerror(errno));
+    }
+}
+
+static void close_connection(worker_state_t *state, connection_t *conn)
+{
+    log_info("[PID:%d/FD:%d] disconnect\n", getpid(), conn->fd);
+
+    poller_remove(&state->poller, conn->fd, NULL);
+    connection_close(&state->connections, conn, NULL);
+    notify_server(state);
+
+    // A slot is free again, pick up the clients that queued on the listener while the worker was full
+    if(state->listenfd > -1 && !state->accepting)
+    {
+        state->accepting = true;
+        poller_modify(&state->poller, state->listenfd, POLLIN, &state->listenfd, NULL);
+    }
+}
+
+/*
+ * Starts polling a client fd. The fd is closed if the worker can't take it.
+ */
+static int add_connection(worker_state_t *state, int connfd)
+{
+    int           err;
+    connection_t *conn;
+
+    err  = 0;
+    conn = connection_open(&state->connections, connfd, &err);
+    if(conn == NULL)
+    {
+        log_error("worker::connection_open: %s\n", strerror(err));
+        close(connfd);
+        return -1;
+    }
+
+    err = 0;
+    if(poller_add(&state->poller, conn->fd, POLLIN | POLLHUP, conn, &err) < 0)
+    {
+        log_error("worker::poller_add: %s\n", strerror(err));
+        connection_close(&state->connections, conn, NULL);
+        return -2;
+    }
+    conn->events = POLLIN | POLLHUP;
+
+    return 0;
+}
+
+/*
+ * Receives every fd the server has handed over: clients are polled, cache snapshots replace the current one.
+ *
+ * Returns -1 once the server has closed the domain socket.
+ */
+static int receive_connections(worker_state_t *state)
+{
+    while(true)
+    {
+        int  err;
+        int  connfd;
+        char tag;
+
+        err    = 0;
+        tag    = WORKER_MESSAGE_CLIENT;
+        connfd = recv_fd(state->sockfd, &tag, &err);
+        if(connfd < 0)
+        {
+            if(err == EINTR)
+            {
+                continue;
+            }
+
+            if(would_block(err))
+            {
+                return 0;
+            }
+
+            if(err != ECONNRESET)
+            {
+                log_error("worker::recv_fd: %s\n", strerror(err));
+            }
+
+            return -1;    // The server has closed the domain socket
+        }
+
+        if(tag == WORKER_MESSAGE_CACHE)
+        {
+            err = 0;
+            if(cache_attach(state->cache, connfd, &err) < 0)
+            {
+                log_error("worker::cache_attach: %s\n", strerror(err));
+            }
+            continue;
+        }
+
+        if(add_connection(state, connfd) < 0)
+        {
+            notify_server(state);
+        }
+    }
+}
+
+/*
+ * Accepts clients from the worker's own listener until the backlog is drained or the worker is full.
+ */
+static void accept_connections(worker_state_t *state)
+{
+    while(true)
+    {
+        int      err;
+        client_t client;
+
+        // Leave the remaining clients in the backlog until a connection closes
+        if(state->connections.nconnections == state->connections.max_connections)
+        {
+            state->accepting = false;
+            poller_modify(&state->poller, state->listenfd, 0, &state->listenfd, NULL);
+            return;
+        }
+
+        err = 0;
+        if(tcp_accept(state->listenfd, &client, &err) < 0)
+        {
+            if(err != EINTR && !would_block(err))
+            {
+                log_error("worker::tcp_accept: %s\n", strerror(err));
+            }
+
+            return;
+        }
+
+        log_info("[PID:%d/FD:%d] \"%s:%d\" connect\n", getpid(), client.fd, client.address, client.port);
+
+        add_connection(state, client.fd);
+    }
+}
+
+/*
+ * Advances the connection's state machine.
+ *
+ * READING: read what is available, answer every complete request and try to write the responses straight away.
+ * WRITING: the socket was full, keep flushing on POLLOUT and go back to reading once the responses are out.
+ * CLOSING: the client has shut down or the connection is not kept alive, flush the last responses and close.
+ *
+ * Requests stop being answered while the output queue is full. Whenever the socket takes everything that was queued,
+ * the requests held back behind it are answered before waiting for the next event, the client may not send anything
+ * else to wake the worker up.
+ *
+ * Every read is capped so that one busy client can't starve the others. A level-triggered poller reports the rest on
+ * the next poll, an edge-triggered one never will, so in that mode the rest is read once the responses are out.
+ *
+ * A connection that has sent an insert is held: nothing is written or read until the store has committed the record,
+ * the client must not see its response before then. The store's acknowledgement picks the connection up again.
+ */
+static void handle_connection_event(worker_state_t *state, connection_t *conn, short revents)
+{
+    int     err;
+    ssize_t remaining;
+    short   events;
+    bool    readable = conn->state == CONNECTION_STATE_READING && (revents & (POLLIN | POLLHUP));
+
+    if(revents & POLLERR)
+    {
+        close_connection(state, conn);
+        return;
+    }
+
+    connection_touch(&state->connections, conn);
+
+    while(true)
+    {
+        ssize_t answered = 0;
+
+        if(readable)
+        {
+            err = 0;
+            if(connection_read(conn, &err) < 0)
+            {
+                log_error("worker::connection_read: %s\n", strerror(err));
+                close_connection(state, conn);
+                return;
+            }
+            readable = false;
+        }
+
+        if(conn->state != CONNECTION_STATE_WRITING && conn->uncommitted == 0 && connection_has_input(conn))
+        {
+            answered = handle_client_data(conn, &state->handler);
+        }
+
+        if(conn->uncommitted > 0)
+        {
+            if(conn->events != 0)
+            {
+                poller_modify(&state->poller, conn->fd, 0, conn, NULL);
+                conn->events = 0;
+            }
+            return;
+        }
+
+        err       = 0;
+        remaining = connection_flush(conn, &err);
+        if(remaining < 0)
+        {
+            log_error("worker::connection_flush: %s\n", strerror(err));
+            close_connection(state, conn);
+            return;
+        }
+
+        // The responses are out, pick up the requests that were held back behind them
+        if(remaining == 0 && conn->state == CONNECTION_STATE_WRITING)
+        {
+            conn->state = CONNECTION_STATE_READING;
+            continue;
+        }
+
+        if(remaining == 0 && conn->state == CONNECTION_STATE_READING && conn->input_more && state->poller.edge_triggered)
+        {
+            readable = true;
+            continue;
+        }
+
+        if(remaining > 0 || answered == 0 || !connection_has_input(conn))
+        {
+            break;
+        }
+    }
+
+    if(remaining == 0 && conn->state == CONNECTION_STATE_CLOSING)
+    {
+        close_connection(state, conn);
+        return;
+    }
+
+    if(remaining > 0 && conn->state == CONNECTION_STATE_READING)
+    {
+        conn->state = CONNECTION_STATE_WRITING;
+    }
+
+    // Only switch the poller interest when the connection changes between reading and writing
+    events = remaining > 0 ? POLLOUT : POLLIN | POLLHUP;
+    if(events != conn->events)
+    {
+        poller_modify(&state->poller, conn->fd, events, conn, NULL);
+        conn->events = events;
+    }
 }
 
-_Noreturn void worker_entrypoint(DBM *db, const char *public_dir)
+/*
+ * Answers the requests of every connection whose inserts have all been acknowledged. A connection with an insert the
+ * store failed to commit gets an error in place of its held response.
+ */
+static void release_committed(worker_state_t *state)
+{
+    while(state->store.nacks > 0)
+    {
+        const store_ack_t *ack  = &state->store.acks[--state->store.nacks];
+        connection_t      *conn = connection_find(&state->connections, ack->token);
+
+        // The client may have timed out in the meantime
+        if(conn == NULL || conn->uncommitted == 0)
+        {
+            continue;
+        }
+
+        if(ack->status != 0)
+        {
+            log_error("worker::release_committed: %s [FD:%d]\n", strerror(ack->status), conn->fd);
+            conn->commit_failed = true;
+        }
+
+        if(--conn->uncommitted > 0)
+        {
+            continue;
+        }
+
+        if(conn->commit_failed)
+        {
+            handle_commit_failure(conn);
+        }
+        handle_connection_event(state, conn, 0);
+    }
+}
+
+/*
+ * Connects to the store and polls its socket. Without the store, records can neither be inserted nor read back,
+ * everything else is still served until a later attempt succeeds.
+ */
+static void connect_store(worker_state_t *state)
+{
+    int err;
+
+    state->store_retry_ms = monotonic_ms() + WORKER_STORE_RETRY_MS;
+
+    err = 0;
+    if(store_connect(&state->store, state->config->store_path, &err) < 0)
+    {
+        log_error("worker::store_connect: %s\n", strerror(err));
+        state->store.fd = -1;
+        return;
+    }
+
+    err = 0;
+    if(poller_add(&state->poller, state->store.fd, POLLIN | POLLHUP, &state->store, &err) < 0)
+    {
+        log_error("worker::poller_add: %s\n", strerror(err));
+        store_disconnect(&state->store);
+    }
+}
+
+/*
+ * Drops the connection to the store. Held connections are closed, their inserts will never be acknowledged. The event
+ * loop connects again once the retry interval has passed.
+ */
+static void disconnect_store(worker_state_t *state)
+{
+    poller_remove(&state->poller, state->store.fd, NULL);
+    store_disconnect(&state->store);
+
+    for(size_t idx = 0; idx < state->connections.max_connections; idx++)
+    {
+        connection_t *conn = &state->connections.connections[idx];
+
+        if(conn->state != CONNECTION_STATE_FREE && conn->uncommitted > 0)
+        {
+            close_connection(state, conn);
+        }
+    }
+}
+
+/*
+ * Closes every connection that has been inactive for longer than the idle timeout.
+ *
+ * Returns how long the poller can wait before the next connection times out, -1 if there are no connections.
+ */
+static int close_idle_connections(worker_state_t *state)
+{
+    const uint64_t timeout_ms = (uint64_t)state->config->idle_timeout * MS_PER_SECOND;
+    const uint64_t now_ms     = monotonic_ms();
+    connection_t  *conn;
+
+    // The idle list is ordered by last activity, so only the front of it can have expired
+    while((conn = connection_pool_oldest(&state->connections)) != NULL && now_ms - conn->last_active_ms >= timeout_ms)
+    {
+        log_debug("[PID:%d/FD:%d] idle timeout\n", getpid(), conn->fd);
+        close_connection(state, conn);
+    }
+
+    if(conn == NULL)
+    {
+        return -1;
+    }
+
+    return (int)(conn->last_active_ms + timeout_ms - now_ms);
+}
+
+/*
+ * Long-lived worker loop.
+ *
+ * The worker connects to its domain socket once and then receives a stream of client fds over it. Every client is
+ * kept in the worker's own poller until it disconnects, at which point a single byte is written back to notify the
+ * server that the worker has capacity for another client.
+ *
+ * When sharding accepts with SO_REUSEPORT, the worker accepts clients on its own listener instead and the domain
+ * socket is only used to detect that the server has gone away.
+ */
+_Noreturn void worker_entrypoint(db_cache_t *db_cache, db_snapshot_t *snapshot, cache_t *cache, const worker_config_t *config)
 {
     int retval;
     int err;
 
-    pid_t         pid;
-    const char   *socket_path;
-    struct pollfd pollfds[1];
+    pid_t pid;
+    char *socket_path;
 
-    int sockfd = -1;
-    int connfd = -1;
+    worker_state_t state;
 
     setup_signals(signal_handler_fn);
+    signal(SIGPIPE, SIG_IGN);    // A client closing mid-response should fail the write, not kill every other client of the worker
+
+    state.sockfd    = -1;
+    state.listenfd  = -1;
+    state.accepting = false;
+    state.cache     = cache;
+    state.config    = config;
 
-    // Close sockfd from parent
-    close(3);
+    memset(&state.store, 0, sizeof(store_client_t));
+    state.store.fd = -1;
+
+    state.handler.store    = &state.store;
+    state.handler.db_cache = db_cache;
+    state.handler.snapshot = snapshot;
+    state.handler.cache    = cache;
+    state.handler.arena    = &state.arena;
+    state.handler.config   = config;
 
     // Set socket path
     pid = getpid();
@@ -209,9 +640,9 @@ _Noreturn void worker_entrypoint(DBM *db, const char *public_dir)
     }
 
     // Open domain socket
-    err    = 0;
-    sockfd = dmn_client(socket_path, &err);
-    if(sockfd < 0)
+    err          = 0;
+    state.sockfd = dmn_client(socket_path, &err);
+    if(state.sockfd < 0)
     {
         if(err == EACCES)
         {
@@ -222,78 +653,164 @@ _Noreturn void worker_entrypoint(DBM *db, const char *public_dir)
             log_error("worker::dmn_client: %s\n", strerror(err));
         }
 
+        free(socket_path);
         retval = EXIT_FAILURE;
         goto exit;
     }
+    free(socket_path);
+
+    // Client fds are drained until EAGAIN
+    errno = 0;
+    if(fcntl(state.sockfd, F_SETFL, fcntl(state.sockfd, F_GETFL) | O_NONBLOCK) < 0)
+    {
+        log_error("worker::fcntl: %s\n", strerror(errno));
+        retval = EXIT_FAILURE;
+        goto close_socket;
+    }
+
+    err = 0;
+    if(arena_init(&state.arena, ARENA_BLOCK_SIZE, &err) < 0)
+    {
+        log_error("worker::arena_init: %s\n", strerror(err));
+        retval = EXIT_FAILURE;
+        goto close_socket;
+    }
+
+    err = 0;
+    if(connection_pool_init(&state.connections, MAX_WORKER_CONNECTIONS, &err) < 0)
+    {
+        log_error("worker::connection_pool_init: %s\n", strerror(err));
+        retval = EXIT_FAILURE;
+        goto destroy_arena;
+    }
 
-    // Get the client fd from the server
-    err    = 0;
-    connfd = recv_fd(sockfd, &err);
-    if(connfd < 0)
+    // +2 for the domain socket, which is polled with NULL user data, and the store's socket
+    err = 0;
+    if(poller_init(&state.poller, MAX_WORKER_CONNECTIONS + 2, config->edge_triggered, &err) < 0 || poller_add(&state.poller, state.sockfd, POLLIN | POLLHUP, NULL, &err) < 0)
     {
-        if(err == EINTR)
+        log_error("worker::poller_init: %s\n", strerror(err));
+        retval = EXIT_FAILURE;
+        goto destroy_pool;
+    }
+
+    connect_store(&state);
+
+    // Share the server's address with the other workers, the kernel balances the connections between them
+    if(config->reuseport)
+    {
+        state.listenfd = tcp_server(config->address, config->port, true);
+        if(state.listenfd < 0)
         {
-            retval = EXIT_SUCCESS;
+            retval = EXIT_FAILURE;
+            goto destroy_poller;
         }
-        else
+
+        err = 0;
+        if(poller_add(&state.poller, state.listenfd, POLLIN, &state.listenfd, &err) < 0)
         {
-            log_error("worker::recv_fd: %s\n", strerror(err));
+            log_error("worker::poller_add: %s\n", strerror(err));
             retval = EXIT_FAILURE;
+            goto destroy_poller;
         }
-
-        close(sockfd);
-        goto exit;
+        state.accepting = true;
     }
 
-    // Setup client pollfd
-    pollfds[0].fd     = connfd;
-    pollfds[0].events = POLLIN | POLLHUP | POLLERR;
-
-    // Process data!
+    retval = EXIT_SUCCESS;
     while(is_running)
     {
-        int poll_result;
+        poller_event_t events[WORKER_MAX_EVENTS];
+        int            nevents;
+        int            timeout;
 
-        errno       = 0;
-        poll_result = poll(pollfds, ((nfds_t)(sizeof(pollfds) / sizeof(pollfds[0]))), -1);
-        if(poll_result < 0)
+        // The server forwards SIGHUP when the HTTP library has changed, no request is in flight between events
+        if(reload_requested)
         {
-            log_error("worker::poll: %s\n", strerror(errno));
-            continue;
+            reload_requested = false;
+            if(reload_library(config->libhttp_path) < 0)
+            {
+                log_error("worker::reload_library: Failed to reload \"%s\", keeping the loaded library.\n", config->libhttp_path);
+            }
         }
 
-        // On CLIENT data in...
-        if(pollfds[0].revents & (POLLIN))
+        // The store may have gone away, or not have been reachable at all so far
+        if(state.store.fd < 0 && monotonic_ms() >= state.store_retry_ms)
         {
-            if(handle_client_data(pollfds[0].fd, db, public_dir) == 0)
-            {
-                // Trigger POLLHUP because the client has closed the connection.
-                pollfds[0].revents |= POLLHUP;
-            }
+            connect_store(&state);
         }
 
-        // On CLIENT error...
-        if(pollfds[0].revents & (POLLERR))
+        timeout = close_idle_connections(&state);
+
+        err     = 0;
+        nevents = poller_wait(&state.poller, events, WORKER_MAX_EVENTS, timeout, &err);
+        if(nevents < 0)
         {
-            retval = EXIT_FAILURE;    // NOLINT
-            goto cleanup;
+            if(err != EINTR)
+            {
+                log_error("worker::poller_wait: %s\n", strerror(err));
+            }
+            continue;
         }
 
-        // On CLIENT shutdown...
-        if(pollfds[0].revents & (POLLHUP))
+        for(int idx = 0; idx < nevents; idx++)
         {
-            retval = EXIT_SUCCESS;    // NOLINT
-            goto cleanup;
+            connection_t *conn;
+
+            if(events[idx].data == NULL)
+            {    // The server has handed over new clients, or has closed the domain socket
+                if(receive_connections(&state) < 0)
+                {
+                    is_running = false;
+                }
+                continue;
+            }
+
+            if(events[idx].data == &state.listenfd)
+            {    // Clients are waiting on the worker's own listener
+                accept_connections(&state);
+                continue;
+            }
+
+            if(events[idx].data == &state.store)
+            {    // Inserts have been committed, or the store has gone away
+                err = 0;
+                if(state.store.fd > -1 && store_receive(&state.store, &err) < 0)
+                {
+                    log_error("worker::store_receive: %s\n", strerror(err));
+                    disconnect_store(&state);
+                }
+                continue;
+            }
+
+            // Anything else is a client
+            conn = (connection_t *)events[idx].data;
+            if(conn->state == CONNECTION_STATE_FREE)
+            {
+                continue;    // The connection has been closed while handling an earlier event
+            }
+
+            handle_connection_event(&state, conn, events[idx].revents);
         }
-    }
 
-    retval = EXIT_FAILURE;
+        // Acknowledgements also arrive while waiting for a lookup, not only on the store's events
+        release_committed(&state);
+    }
 
-cleanup:
-    if(connfd >= 0)
+destroy_poller:
+    if(state.listenfd > -1)
     {
-        close(connfd);
+        close(state.listenfd);
     }
+    poller_destroy(&state.poller, NULL);
+
+destroy_pool:
+    connection_pool_destroy(&state.connections, NULL);
+
+destroy_arena:
+    arena_destroy(&state.arena);
+
+close_socket:
+    store_disconnect(&state.store);
+    close(state.sockfd);
 
 exit:
     exit(retval);